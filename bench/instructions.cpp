@@ -0,0 +1,140 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "chip8.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "engine.h"
+
+// Long enough that the closing jump is only a small part of every measurement.
+#define BENCH_BLOCK_INSTRUCTIONS 256
+
+/**
+ * Builds a program which sets up the registers, repeats the body and jumps back to the start of
+ * the body. The setup points I at the sprite of the font for 0, bodies which store registers
+ * point it at free memory above the program themselves.
+ *
+ * @param [in] body The opcodes which are repeated.
+ * @return The bytes of the program.
+ */
+static std::vector<uint8_t> repeat (std::initializer_list<uint16_t> body) {
+  const std::vector<uint16_t> setup = {
+      0x6012, // V0 = 0x12
+      0x6134, // V1 = 0x34
+      0x6205, // V2 = 0x05
+      0xA000, // I = 0x000
+  };
+
+  std::vector<uint8_t> program;
+  auto push = [&] (uint16_t opcode) {
+    program.push_back (opcode >> 8);
+    program.push_back (opcode & 0xFF);
+  };
+
+  for (auto opcode : setup) {
+    push (opcode);
+  }
+
+  auto loop = (uint16_t)(MEMORY_PROGRAM_START + program.size ());
+  for (auto index = 0u; index < BENCH_BLOCK_INSTRUCTIONS; index += body.size ()) {
+    for (auto opcode : body) {
+      push (opcode);
+    }
+  }
+
+  push (0x1000 | loop);
+  return program;
+}
+
+/**
+ * Runs the program one cycle after another and reports the executed instructions per second.
+ */
+static void run_cycles (benchmark::State &state, const std::vector<uint8_t> &program) {
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (program);
+
+  for (auto _ : state) {
+    for (auto cycle = 0u; cycle < BENCH_BLOCK_INSTRUCTIONS; cycle++) {
+      chip.cycle ();
+    }
+  }
+
+  benchmark::DoNotOptimize (chip.display ());
+  state.SetItemsProcessed (state.iterations () * BENCH_BLOCK_INSTRUCTIONS);
+}
+
+static void BM_Alu (benchmark::State &state) {
+  run_cycles (state, repeat ({0x8014, 0x8015, 0x8102, 0x8013, 0x8016, 0x8107, 0x801E, 0x8011}));
+}
+BENCHMARK(BM_Alu);
+
+static void BM_AddWithCarry (benchmark::State &state) {
+  run_cycles (state, repeat ({0x8014}));
+}
+BENCHMARK(BM_AddWithCarry);
+
+static void BM_Draw (benchmark::State &state) {
+  // Draws the same sprite at the same place, so every second draw erases it with collisions.
+  run_cycles (state, repeat ({0xD015}));
+}
+BENCHMARK(BM_Draw);
+
+static void BM_DrawWrapping (benchmark::State &state) {
+  // Crosses the right and the bottom edge of the display.
+  run_cycles (state, repeat ({0x603E, 0x611E, 0xD01F}));
+}
+BENCHMARK(BM_DrawWrapping);
+
+static void BM_StoreRegisters (benchmark::State &state) {
+  run_cycles (state, repeat ({0xA800, 0xFF55}));
+}
+BENCHMARK(BM_StoreRegisters);
+
+static void BM_LoadRegisters (benchmark::State &state) {
+  run_cycles (state, repeat ({0xA800, 0xFF65}));
+}
+BENCHMARK(BM_LoadRegisters);
+
+static void BM_Dispatch (benchmark::State &state) {
+  // SYS is ignored, so only fetching the cached instruction and calling its handler is left.
+  run_cycles (state, repeat ({0x0123}));
+}
+BENCHMARK(BM_Dispatch);
+
+static void BM_ColdDecode (benchmark::State &state) {
+  // Loading the game drops the decoded instructions, so every cycle has to decode again.
+  auto program = repeat ({0x7001});
+  Chip8 chip;
+  chip.initialize ();
+
+  for (auto _ : state) {
+    chip.load_game (program);
+    for (auto cycle = 0u; cycle < BENCH_BLOCK_INSTRUCTIONS; cycle++) {
+      chip.cycle ();
+    }
+  }
+
+  state.SetItemsProcessed (state.iterations () * BENCH_BLOCK_INSTRUCTIONS);
+}
+BENCHMARK(BM_ColdDecode);
+
+static void BM_DecodeOperation (benchmark::State &state) {
+  uint16_t opcode = 0;
+  for (auto _ : state) {
+    auto instruction = Instruction::decode (opcode);
+    auto operation = decode_operation (opcode);
+    benchmark::DoNotOptimize (instruction);
+    benchmark::DoNotOptimize (operation);
+    opcode += 0x1235;
+  }
+
+  state.SetItemsProcessed (state.iterations ());
+}
+BENCHMARK(BM_DecodeOperation);
@@ -0,0 +1,142 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "batch.h"
+#include "chip8.h"
+#include "engine.h"
+#include "scheduler.h"
+
+#include "../test/programs.h"
+
+// The cycles of one iteration, roughly a second of emulated time at a high rate.
+#define BENCH_ROM_CYCLES 100000
+
+// The random programs of the tests which are measured like games, so there are macro benchmarks
+// even without any ROMs.
+#define BENCH_PROGRAMS             4
+#define BENCH_PROGRAM_INSTRUCTIONS 64
+
+static const std::pair<const char *, EngineType> ENGINES[] = {
+    {"interpreter", EngineType::Interpreter},
+    {"threaded", EngineType::Threaded},
+    {"jit", EngineType::Jit},
+};
+
+/**
+ * Runs a game headless for a fixed amount of cycles per iteration and reports the million
+ * instructions per second (MIPS). The timers tick at 600 instructions per emulated second, just
+ * like in the default windowed mode.
+ */
+static void run_game (benchmark::State &state, Chip8 &chip, EngineType type) {
+  auto engine = make_engine (type);
+  Scheduler scheduler (600);
+
+  for (auto _ : state) {
+    scheduler.run (chip, *engine, BENCH_ROM_CYCLES);
+    if (chip.fault ()) {
+      state.SkipWithError ("The game faulted");
+      break;
+    }
+  }
+
+  state.SetItemsProcessed (state.iterations () * BENCH_ROM_CYCLES);
+  state.counters["MIPS"] = benchmark::Counter ((double)state.iterations () * BENCH_ROM_CYCLES / 1e6,
+                                               benchmark::Counter::kIsRate);
+}
+
+/**
+ * Runs a ROM file, see run_game.
+ */
+static void run_rom (benchmark::State &state, const std::string &path, EngineType type) {
+  Chip8 chip;
+  chip.initialize ();
+  if (!chip.load_game (path)) {
+    state.SkipWithError ("Couldn't open the ROM");
+    return;
+  }
+
+  run_game (state, chip, type);
+}
+
+/**
+ * Runs one of the random programs of the tests, see run_game.
+ */
+static void run_program (benchmark::State &state, uint32_t seed, EngineType type) {
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (random_program (seed, BENCH_PROGRAM_INSTRUCTIONS));
+
+  run_game (state, chip, type);
+}
+
+/**
+ * Registers one benchmark per ROM and engine. The ROMs are taken from the directory in the
+ * environment variable CHIP8_BENCH_ROMS, or from the ROMs of the repository. Without any ROM a
+ * single benchmark fails with a hint, so the missing measurements don't go unnoticed.
+ */
+static void register_roms () {
+  const auto *variable = std::getenv ("CHIP8_BENCH_ROMS");
+  std::string directory = variable ? variable : CHIP8_BENCH_ROMS;
+
+  std::error_code error;
+  std::vector<std::string> paths;
+  if (std::filesystem::is_directory (directory, error)) {
+    paths = collect_roms ({directory});
+  }
+
+  if (paths.empty ()) {
+    std::cerr << "There are no ROMs in " << directory << ", set CHIP8_BENCH_ROMS to a directory "
+              << "with .ch8 files to measure real games." << std::endl;
+    benchmark::RegisterBenchmark ("BM_Rom/missing", [] (benchmark::State &state) {
+      state.SkipWithError ("No ROMs found, set CHIP8_BENCH_ROMS");
+    });
+    return;
+  }
+
+  for (const auto &path : paths) {
+    auto name = std::filesystem::path (path).stem ().string ();
+    for (const auto &[engine_name, type] : ENGINES) {
+      benchmark::RegisterBenchmark (("BM_Rom/" + std::string (engine_name) + "/" + name).c_str (),
+                                    [path, type] (benchmark::State &state) {
+                                      run_rom (state, path, type);
+                                    });
+    }
+  }
+}
+
+/**
+ * Registers one benchmark per random program and engine.
+ */
+static void register_programs () {
+  for (uint32_t seed = 0; seed < BENCH_PROGRAMS; seed++) {
+    for (const auto &[engine_name, type] : ENGINES) {
+      auto name = "BM_Program/" + std::string (engine_name) + "/random_" + std::to_string (seed);
+      benchmark::RegisterBenchmark (name.c_str (), [seed, type] (benchmark::State &state) {
+        run_program (state, seed, type);
+      });
+    }
+  }
+}
+
+int main (int argc, char **argv) {
+  register_roms ();
+  register_programs ();
+
+  benchmark::Initialize (&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments (argc, argv)) {
+    return EXIT_FAILURE;
+  }
+
+  benchmark::RunSpecifiedBenchmarks ();
+  benchmark::Shutdown ();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _AOT_H_
+#define _AOT_H_
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "engine.h"
+
+class AotEngine;
+
+/**
+ * @brief A ROM translated ahead of time by chip8_aot. Besides the native code it keeps the
+ * original bytes of the ROM and marks which of them are code, so the engine can tell whether the
+ * translation still matches the memory.
+ */
+struct AotProgram {
+  std::span<const uint8_t> rom;
+  std::span<const uint8_t> code;
+  // The profile the code was translated for (see Chip8::set_quirks).
+  QuirkProfile quirks;
+
+  /**
+   * Runs native code starting at the program counter until the cycles are used up or a location
+   * is reached that has no valid translation.
+   *
+   * @return The amount of executed cycles, which is 0 if the program counter has no translation.
+   */
+  uint64_t (*run) (AotEngine &engine, Chip8 &chip, uint64_t cycles);
+};
+
+/**
+ * @brief Runs a ROM that was translated into C++ ahead of time. Whenever the native code can't be
+ * used, because the program counter left the translated code, a computed jump went somewhere
+ * unknown or the game modified its own code, the interpreter takes over. A Chip-8 with another
+ * quirk profile than the translation is interpreted entirely.
+ */
+class AotEngine : public Engine {
+ public:
+  explicit AotEngine (const AotProgram &program);
+
+  void run (Chip8 &chip, uint64_t cycles) override;
+
+  /**
+   * Tells whether the code in the given page of the memory is still the one that was translated.
+   *
+   * @param [in] chip The Chip-8 which executes the translation.
+   * @param [in] page The index of the page (see CODE_PAGE_SIZE).
+   * @return True if the native code of this page may be executed.
+   */
+  bool unchanged (const Chip8 &chip, uint16_t page) {
+    return chip.page_versions_[page] == this->page_versions_[page] || this->revalidate (chip, page);
+  }
+
+  // The generated code works on the state of the Chip-8 through the following accessors.
+
+  static std::array<uint8_t, V_REGISTERS> &registers (Chip8 &chip) {
+    return chip.V_;
+  }
+
+  static uint16_t &index_register (Chip8 &chip) {
+    return chip.I_;
+  }
+
+  static uint16_t &program_counter (Chip8 &chip) {
+    return chip.program_counter_;
+  }
+
+  static void execute (Chip8 &chip, uint16_t opcode) {
+    chip.execute (Instruction::decode (opcode));
+  }
+
+ private:
+  /**
+   * Compares the code bytes of a page with the ROM after the page was written to. Writes into
+   * data next to the code don't invalidate the translation.
+   *
+   * @param [in] chip The Chip-8 which executes the translation.
+   * @param [in] page The index of the page (see CODE_PAGE_SIZE).
+   * @return True if all the code in this page is still the same as in the ROM.
+   */
+  bool revalidate (const Chip8 &chip, uint16_t page);
+
+  AotProgram program_;
+  // The machine whose pages were compared with the ROM.
+  const Chip8 *chip_;
+  uint64_t generation_;
+  std::array<uint32_t, RAM_SIZE / CODE_PAGE_SIZE> page_versions_;
+};
+
+#endif //_AOT_H_
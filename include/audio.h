@@ -0,0 +1,157 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _AUDIO_H_
+#define _AUDIO_H_
+
+#include <array>
+#include <cstdint>
+
+#include "chip8.h"
+#include "engine.h"
+#include "ring.h"
+
+#define AUDIO_SAMPLE_RATE    48000
+// 5.3 ms per callback at 48 kHz.
+#define AUDIO_BUFFER_SAMPLES 256
+// How far behind the emulation a tone is played. Together with the buffer of the device it stays
+// below 20 ms.
+#define AUDIO_LATENCY        (2 * AUDIO_BUFFER_SAMPLES)
+
+#define BEEPER_FREQUENCY      440
+#define BEEPER_AMPLITUDE      6000
+#define BEEPER_WAVETABLE_BITS 8
+#define BEEPER_RAMP_SAMPLES   48
+#define BEEPER_QUEUE_SIZE     256
+
+// The samples of emulated time a tone may arrive early, since the frames are executed at once and a
+// few of them are caught up after the host fell behind.
+#define BEEPER_MAX_LEAD (AUDIO_SAMPLE_RATE / 10)
+
+/**
+ * @brief Plays the tone of the sound timer. The emulation pushes every change of the tone, stamped
+ * with the emulated time in samples, into a lock-free ring, from which the audio callback of the
+ * host renders the samples at a fixed distance behind. The callback neither locks nor allocates,
+ * it only reads a waveform which is computed once. If the emulated time jumps, e.g. because frames
+ * were dropped, the distance is set up again at the next change of the tone.
+ */
+class Beeper {
+ public:
+  /**
+   * @param [in] sample_rate The samples per second of the output.
+   * @param [in] latency     The samples a change of the tone is played after it happened.
+   */
+  Beeper (uint32_t sample_rate, uint32_t latency);
+
+  /**
+   * Turns the tone on or off, only called by the emulation.
+   *
+   * @param [in] time The emulated time of the change in samples, which never goes backwards.
+   * @param [in] on   Whether the tone sounds from now on.
+   * @return False if the callback fell too far behind and the change was dropped.
+   */
+  bool set_tone (uint64_t time, bool on);
+
+  /**
+   * Writes the next samples of the output, only called by the audio callback.
+   *
+   * @param [out] samples The mono samples to fill.
+   * @param [in]  count   The amount of samples.
+   */
+  void render (int16_t *samples, size_t count);
+
+  /**
+   * @return The samples per second of the output.
+   */
+  uint32_t sample_rate () const;
+
+ private:
+  struct ToneChange {
+    uint64_t time;
+    bool on;
+  };
+
+  /**
+   * Continues the waveform, fading in or out over BEEPER_RAMP_SAMPLES to avoid clicks.
+   */
+  void synthesize (int16_t *samples, size_t count);
+
+  SpscRing<ToneChange, BEEPER_QUEUE_SIZE> changes_;
+  std::array<int16_t, 1 << BEEPER_WAVETABLE_BITS> waveform_;
+  uint32_t sample_rate_;
+  uint32_t latency_;
+
+  // Only used by the callback.
+  uint32_t phase_;
+  uint32_t phase_step_;
+  uint32_t gain_;
+  bool on_;
+  uint64_t position_;
+  int64_t offset_;
+  bool synchronized_;
+};
+
+/**
+ * @brief Tells the beeper when the sound timer starts and stops. It sits between the Scheduler and
+ * the real engine and counts the executed instructions, so every change is stamped with the
+ * emulated time. The timers tick between two runs, so those changes are exact. The engine runs
+ * in chunks of a millisecond of emulated time or IDLE_CHECK_INTERVAL instructions, whichever is
+ * longer, and the state before every chunk is kept. If a chunk changed the tone, which only an
+ * Fx18 can do, the chunk is replayed on a copy of the machine one instruction at a time, so the
+ * change is stamped with the cycle of the Fx18 as well.
+ */
+class ToneTracker : public Engine {
+ public:
+  /**
+   * @param [in] engine                  The engine which executes the instructions.
+   * @param [in] beeper                  The beeper which plays the tone.
+   * @param [in] instructions_per_second The rate the Scheduler uses.
+   */
+  ToneTracker (Engine &engine, Beeper &beeper, uint64_t instructions_per_second);
+
+  void run (Chip8 &chip, uint64_t cycles) override;
+
+  /**
+   * Turns the tone off while the emulation doesn't run, e.g. during rewinding. The next run turns
+   * it on again if the sound timer is still running.
+   */
+  void silence ();
+
+ private:
+  /**
+   * Finds the instruction of the last chunk after which the tone changed.
+   *
+   * @param [in] chip  The Chip-8 after the chunk.
+   * @param [in] chunk The amount of instructions of the chunk.
+   * @return The instructions of the chunk up to and including the change, or the whole chunk if
+   * the tone didn't change.
+   */
+  uint64_t find_change (const Chip8 &chip, uint64_t chunk);
+
+  /**
+   * Passes a change of the sound timer on to the beeper.
+   *
+   * @param [in] chip   The Chip-8 whose sound timer is checked.
+   * @param [in] cycles The executed instructions at the time of the change.
+   */
+  void update (const Chip8 &chip, uint64_t cycles);
+
+  /**
+   * @param [in] cycles An amount of executed instructions.
+   * @return The emulated time of the instructions in samples of the beeper.
+   */
+  uint64_t time (uint64_t cycles) const;
+
+  Engine &engine_;
+  Beeper &beeper_;
+  uint64_t instructions_per_second_;
+  uint64_t chunk_;
+  uint64_t cycles_;
+  bool on_;
+  // The state in front of the current chunk and the machine which replays it.
+  SaveState before_;
+  Chip8 replay_;
+};
+
+#endif //_AUDIO_H_
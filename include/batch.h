@@ -0,0 +1,87 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+#include "engine.h"
+#include "headless.h"
+
+/**
+ * @brief Why the run of a single ROM ended.
+ */
+enum class BatchExit {
+  Completed,
+  Faulted,
+  LoadFailed,
+};
+
+/**
+ * @brief Describes how every ROM of a batch is run.
+ */
+struct BatchOptions {
+  EngineType engine;
+  uint64_t instructions_per_second;
+  HeadlessLimits limits;
+  size_t threads;
+  QuirkProfile quirks;
+};
+
+/**
+ * @brief The outcome of running a single ROM.
+ */
+struct BatchResult {
+  std::string path;
+  BatchExit exit;
+  uint64_t cycles;
+  uint64_t frames;
+  uint64_t display_hash;
+  std::optional<Fault> fault;
+  // Why the ROM couldn't be loaded, if the exit is LoadFailed.
+  std::optional<RomError> load_error;
+};
+
+/**
+ * Turns the inputs into a list of ROMs. Files are taken as they are, directories are searched
+ * recursively for files with the extension .ch8, which are sorted to keep the order stable.
+ *
+ * @param [in] inputs Paths to ROMs or directories containing ROMs.
+ * @return The paths of all the ROMs.
+ */
+std::vector<std::string> collect_roms (const std::vector<std::string> &inputs);
+
+/**
+ * Runs every ROM headless in its own Chip-8 on a work-stealing pool (see WorkStealingPool). A ROM
+ * that can't be loaded or faults (see Fault) only ends its own run, the other ROMs are not
+ * affected. Every file is read only once, even if its path is given several times (see
+ * RomCache).
+ *
+ * @param [in] paths   The ROMs to run.
+ * @param [in] options The engine, rate, limits, amount of threads and quirks used for every run.
+ * @return One result per ROM, in the same order as the paths.
+ */
+std::vector<BatchResult> run_batch (const std::vector<std::string> &paths,
+                                    const BatchOptions &options);
+
+/**
+ * @param [in] exit The reason a run ended.
+ * @return A lowercase name for the reason, as it is written into reports.
+ */
+std::string to_string (BatchExit exit);
+
+/**
+ * Quotes a field of a CSV report as RFC 4180 describes it, so paths may contain commas and quotes.
+ *
+ * @param [in] field The text of the field.
+ * @return The field in double quotes, in which every double quote is doubled.
+ */
+std::string csv_quote (const std::string &field);
+
+#endif //_BATCH_H_
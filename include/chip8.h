@@ -5,12 +5,15 @@
 #ifndef _CHIP8_H_
 #define _CHIP8_H_
 
-#include <memory>
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
 #include <string>
-#include <set>
+#include <type_traits>
 
 #include <gtest/gtest_prod.h>
-#include <SDL2/SDL.h>
 
 #define RAM_SIZE      4096
 #define STACK_SIZE    16
@@ -18,16 +21,30 @@
 #define V_REGISTERS   16
 
 #define MEMORY_PROGRAM_START 0x200
+#define ROM_MAX_SIZE         (RAM_SIZE - MEMORY_PROGRAM_START)
+
+#define CODE_PAGE_SIZE 64
 
 #define SCREEN_HEIGHT 32
 #define SCREEN_WIDTH  64
 
-inline std::set<uint8_t> KEY_MAP = {
-    SDLK_1, SDLK_2, SDLK_3, SDLK_4,
-    SDLK_q, SDLK_w, SDLK_e, SDLK_r,
-    SDLK_a, SDLK_s, SDLK_d, SDLK_f,
-    SDLK_z, SDLK_x, SDLK_c, SDLK_v,
-};
+#define SAVE_STATE_MAGIC   0x54533843 // "C8ST"
+#define SAVE_STATE_VERSION 3
+
+// Counting executed instructions costs time on every cycle, so it is only compiled in on request
+// (cmake -DCHIP8_COUNTERS=ON).
+#ifndef CHIP8_COUNTERS
+#define CHIP8_COUNTERS 0
+#endif
+
+// The random numbers of Cxkk are reproducible, every machine starts with this seed.
+#define DEFAULT_RANDOM_SEED 1
+
+/**
+ * @brief One row of the display, where the most significant bit is the leftmost pixel.
+ */
+using DisplayRow = uint64_t;
+static_assert(sizeof (DisplayRow) * 8 == SCREEN_WIDTH);
 
 inline std::array<uint8_t, 80> FONTSET = {
     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
@@ -49,22 +66,308 @@ inline std::array<uint8_t, 80> FONTSET = {
 };
 
 /**
- * @brief Stores the data of a single instruction.
+ * @brief Stores the data of a single instruction. The fields are plain bytes instead of bitfields,
+ * so decoding is nothing more than a few shifts and masks.
  */
 struct Instruction {
   uint16_t opcode;
-  uint16_t nnn: 12;
-  uint8_t x: 4;
-  uint8_t y: 4;
+  uint16_t nnn;
+  uint8_t x;
+  uint8_t y;
   uint8_t kk;
-  uint8_t n: 4;
+  uint8_t n;
+
+  /**
+   * Splits the opcode into all the fields an instruction could use.
+   *
+   * @param [in] opcode The two bytes of the instruction as they are stored in memory.
+   * @return The instruction with the opcode and all its fields (x, y, nnn, n, kk).
+   */
+  static constexpr Instruction decode (uint16_t opcode) {
+    return {
+        opcode,
+        (uint16_t)(opcode & 0x0FFF),
+        (uint8_t)((opcode & 0x0F00) >> 8),
+        (uint8_t)((opcode & 0x00F0) >> 4),
+        (uint8_t)(opcode & 0x00FF),
+        (uint8_t)(opcode & 0x000F)
+    };
+  }
+};
+
+/**
+ * @brief Identifies the handler of an opcode. The names match the methods of the Chip8 class.
+ */
+enum class Operation : uint8_t {
+  Invalid,
+  _0nnn, _00E0, _00EE, _1nnn, _2nnn, _3xkk, _4xkk, _5xy0, _6xkk, _7xkk,
+  _8xy0, _8xy1, _8xy2, _8xy3, _8xy4, _8xy5, _8xy6, _8xy7, _8xyE, _9xy0,
+  Annn, Bnnn, Cxkk, Dxyn, Ex9E, ExA1,
+  Fx07, Fx0A, Fx15, Fx18, Fx1E, Fx29, Fx33, Fx55, Fx65,
+  Count
+};
+
+/**
+ * Finds out to which operation an opcode belongs. Every opcode that is not part of the
+ * instruction set maps to Operation::Invalid, instead of falling through to a neighbouring group.
+ *
+ * @param [in] opcode The two bytes of the instruction as they are stored in memory.
+ * @return The operation which has to be executed for this opcode.
+ */
+constexpr Operation decode_operation (uint16_t opcode) {
+  switch (opcode >> 12) {
+  case 0x0: {
+    switch (opcode) {
+    case 0x00E0: return Operation::_00E0;
+    case 0x00EE: return Operation::_00EE;
+    default: return Operation::_0nnn;
+    }
+  }
+  case 0x1: return Operation::_1nnn;
+  case 0x2: return Operation::_2nnn;
+  case 0x3: return Operation::_3xkk;
+  case 0x4: return Operation::_4xkk;
+  case 0x5: return (opcode & 0x000F) == 0x0 ? Operation::_5xy0 : Operation::Invalid;
+  case 0x6: return Operation::_6xkk;
+  case 0x7: return Operation::_7xkk;
+  case 0x8: {
+    switch (opcode & 0x000F) {
+    case 0x0: return Operation::_8xy0;
+    case 0x1: return Operation::_8xy1;
+    case 0x2: return Operation::_8xy2;
+    case 0x3: return Operation::_8xy3;
+    case 0x4: return Operation::_8xy4;
+    case 0x5: return Operation::_8xy5;
+    case 0x6: return Operation::_8xy6;
+    case 0x7: return Operation::_8xy7;
+    case 0xE: return Operation::_8xyE;
+    default: return Operation::Invalid;
+    }
+  }
+  case 0x9: return (opcode & 0x000F) == 0x0 ? Operation::_9xy0 : Operation::Invalid;
+  case 0xA: return Operation::Annn;
+  case 0xB: return Operation::Bnnn;
+  case 0xC: return Operation::Cxkk;
+  case 0xD: return Operation::Dxyn;
+  case 0xE: {
+    switch (opcode & 0x00FF) {
+    case 0x9E: return Operation::Ex9E;
+    case 0xA1: return Operation::ExA1;
+    default: return Operation::Invalid;
+    }
+  }
+  default: {
+    switch (opcode & 0x00FF) {
+    case 0x07: return Operation::Fx07;
+    case 0x0A: return Operation::Fx0A;
+    case 0x15: return Operation::Fx15;
+    case 0x18: return Operation::Fx18;
+    case 0x1E: return Operation::Fx1E;
+    case 0x29: return Operation::Fx29;
+    case 0x33: return Operation::Fx33;
+    case 0x55: return Operation::Fx55;
+    case 0x65: return Operation::Fx65;
+    default: return Operation::Invalid;
+    }
+  }
+  }
+}
+
+/**
+ * @brief Why the instruction of a Fault couldn't be executed.
+ */
+enum class FaultReason : uint8_t {
+  // The opcode is not part of the instruction set.
+  UnknownOpcode,
+  // A call (2nnn) was made with all STACK_SIZE entries of the stack in use.
+  StackOverflow,
+  // A return (00EE) was made with an empty stack.
+  StackUnderflow,
+  Count
 };
 
 /**
- * @brief The main class used for the entire Chip-8 emulation.
+ * @brief Describes why a Chip-8 stopped making progress: the instruction at the address couldn't
+ * be executed for the given reason.
+ */
+struct Fault {
+  uint16_t address;
+  uint16_t opcode;
+  FaultReason reason;
+
+  bool operator== (const Fault &other) const = default;
+};
+
+/**
+ * @param [in] reason Why an instruction couldn't be executed.
+ * @return A lowercase description of the reason, e.g. "stack overflow".
+ */
+std::string to_string (FaultReason reason);
+
+/**
+ * @brief Why a ROM file couldn't be loaded.
+ */
+enum class RomError {
+  OpenFailed,
+  ReadFailed,
+  Empty,
+  // The file doesn't fit into the memory above MEMORY_PROGRAM_START (see ROM_MAX_SIZE).
+  TooLarge,
+};
+
+/**
+ * @brief The variants of the Chip-8, which disagree on a few instructions. Every variant has a
+ * quirk policy (see DefaultQuirks), for which the affected handlers are instantiated.
+ */
+enum class QuirkProfile : uint8_t {
+  // Shifts Vx, moves I behind the last register, adds V0 to Bnnn and wraps sprites around the
+  // edges of the display, a mix which doesn't match a single original machine. The first versions
+  // of this emulator let a sprite leaving the right edge spill into the next row instead.
+  Default,
+  CosmacVip,
+  Chip48,
+  SuperChip,
+  Count
+};
+
+/**
+ * @brief How Fx55 and Fx65 leave register I after the registers have been stored or loaded.
+ */
+enum class IndexQuirk : uint8_t {
+  IncreaseByXPlusOne,
+  IncreaseByX,
+  Unchanged,
+};
+
+/**
+ * @brief A quirk policy, which is passed as template parameter to the handlers of the affected
+ * instructions. Every decision is made at compile time, so the handlers of one profile contain no
+ * code of the others.
+ */
+struct DefaultQuirks {
+  static constexpr QuirkProfile PROFILE = QuirkProfile::Default;
+  // 8xy6 and 8xyE shift Vy and store the result in Vx, instead of shifting Vx itself.
+  static constexpr bool SHIFT_READS_Y = false;
+  static constexpr IndexQuirk INDEX = IndexQuirk::IncreaseByXPlusOne;
+  // Bnnn jumps relative to Vx, where x is the highest digit of the address, instead of V0.
+  static constexpr bool JUMP_ADDS_X = false;
+  // Dxyn cuts sprites off at the edges of the display instead of wrapping them around.
+  static constexpr bool CLIP_SPRITES = false;
+};
+
+/**
+ * @brief The original interpreter of the COSMAC VIP.
+ */
+struct CosmacVipQuirks {
+  static constexpr QuirkProfile PROFILE = QuirkProfile::CosmacVip;
+  static constexpr bool SHIFT_READS_Y = true;
+  static constexpr IndexQuirk INDEX = IndexQuirk::IncreaseByXPlusOne;
+  static constexpr bool JUMP_ADDS_X = false;
+  static constexpr bool CLIP_SPRITES = true;
+};
+
+/**
+ * @brief The CHIP-48 of the HP-48 calculators, which most later interpreters are based on.
+ */
+struct Chip48Quirks {
+  static constexpr QuirkProfile PROFILE = QuirkProfile::Chip48;
+  static constexpr bool SHIFT_READS_Y = false;
+  static constexpr IndexQuirk INDEX = IndexQuirk::IncreaseByX;
+  static constexpr bool JUMP_ADDS_X = true;
+  static constexpr bool CLIP_SPRITES = true;
+};
+
+/**
+ * @brief The SUPER-CHIP 1.1, restricted to the instructions of the original Chip-8.
+ */
+struct SuperChipQuirks {
+  static constexpr QuirkProfile PROFILE = QuirkProfile::SuperChip;
+  static constexpr bool SHIFT_READS_Y = false;
+  static constexpr IndexQuirk INDEX = IndexQuirk::Unchanged;
+  static constexpr bool JUMP_ADDS_X = true;
+  static constexpr bool CLIP_SPRITES = true;
+};
+
+/**
+ * Calls the function with the policy of the given profile. Code which depends on a profile chosen
+ * at runtime is instantiated once per policy this way, and the profile is only looked at once.
+ *
+ * @param [in] profile  The variant of the Chip-8.
+ * @param [in] function A generic callable, which gets an instance of the policy (e.g.
+ *                      CosmacVipQuirks{}) and returns the same type for every policy.
+ * @return Whatever the function returned.
+ */
+template<typename Function>
+constexpr decltype (auto) with_quirks (QuirkProfile profile, Function &&function) {
+  switch (profile) {
+  case QuirkProfile::CosmacVip: return function (CosmacVipQuirks{});
+  case QuirkProfile::Chip48: return function (Chip48Quirks{});
+  case QuirkProfile::SuperChip: return function (SuperChipQuirks{});
+  default: return function (DefaultQuirks{});
+  }
+}
+
+/**
+ * Finds the profile with the given name, as used on the command line.
+ *
+ * @param [in] name The name of the profile: "default", "vip", "chip48" or "schip".
+ * @return The profile or nothing if there is no profile with this name.
+ */
+std::optional<QuirkProfile> parse_quirk_profile (const std::string &name);
+
+#if CHIP8_COUNTERS
+/**
+ * @brief Tells what the interpreter spent its cycles on: how often every operation and every
+ * address was executed and how much was drawn (see Chip8::counters).
+ */
+struct ExecutionCounters {
+  std::array<uint64_t, (size_t)Operation::Count> operations;
+  std::array<uint64_t, RAM_SIZE> addresses;
+  uint64_t pixels_drawn;
+  uint64_t collisions;
+};
+#endif
+
+/**
+ * @brief The complete state of a Chip-8 as a flat block of memory, which can be copied around or
+ * written to disk as it is (see Chip8::save_state_file). The version has to be increased whenever
+ * the layout changes.
+ */
+struct SaveState {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t program_counter;
+  uint16_t index_register;
+  uint16_t keypad;
+  uint8_t stack_pointer;
+  uint8_t delay_timer;
+  uint8_t sound_timer;
+  // 0 if the machine didn't fault, otherwise the FaultReason + 1.
+  uint8_t fault;
+  uint16_t fault_address;
+  uint16_t fault_opcode;
+  uint32_t random_state;
+  std::array<uint8_t, V_REGISTERS> V;
+  std::array<uint16_t, STACK_SIZE> stack;
+  std::array<DisplayRow, SCREEN_HEIGHT> display;
+  std::array<uint8_t, RAM_SIZE> memory;
+};
+static_assert(std::is_trivially_copyable_v<SaveState>);
+static_assert(std::has_unique_object_representations_v<SaveState>);
+
+/**
+ * @brief The main class used for the entire Chip-8 emulation. It only contains the state of the
+ * machine and knows nothing about windows, renderers or wall-clock time, thus it can be driven by
+ * any frontend (see Frontend) or run headless (see run_headless).
  */
 class Chip8 {
   friend class InstructionTest;
+  friend class AotEngine;
+  friend class ThreadedEngine;
+  friend class JitEngine;
+  friend class LockstepEngine;
+  friend class GuestProfiler;
+  friend class IdleSkipper;
  public:
   Chip8 ();
 
@@ -76,54 +379,269 @@ class Chip8 {
   void initialize ();
 
   /**
-   * Initializes the SDL window and renderer. The scaling factor is needed to compute the real
-   * size of the window.
+   * Restarts the random number generator used by Cxkk, so the same seed gives the same numbers.
+   * Initializing the machine goes back to DEFAULT_RANDOM_SEED.
+   *
+   * @param [in] seed The new seed.
+   */
+  void seed_random (uint32_t seed);
+
+  /**
+   * Selects the variant of the Chip-8 whose quirks the instructions follow, by switching to the
+   * dispatch table of its policy. Every decoded and translated instruction is dropped, so it is
+   * bound to the handlers of the new profile. The profile isn't part of the state and survives
+   * initialize and load_state.
    *
-   * @param scaling_factor The factor used by which the pixels are getting scaled.
+   * @param [in] profile The variant to emulate.
    */
-  void initialize_display (uint8_t scaling_factor);
+  void set_quirks (QuirkProfile profile);
+  FRIEND_TEST(InstructionTest, DispatchesToTheHandlersOfTheProfile);
 
   /**
-   * Loads a game from a file by copying the bytes into the RAM.
+   *
+   * @return The variant whose quirks the instructions follow, QuirkProfile::Default until
+   *         set_quirks is called.
+   */
+  QuirkProfile quirks () const;
+
+  /**
+   * Loads a game from a file by reading it at once (see read_rom) and copying the bytes into the
+   * RAM.
    *
    * @param [in] path The location of the file to load the instructions from.
+   * @return The reason if the file couldn't be loaded, the memory is left untouched then.
    */
-  void load_game (const std::string &path);
+  std::expected<void, RomError> load_game (const std::string &path);
 
   /**
-   * Draws the entire display array to the window. As 64x32 pixels is pretty small everything is
-   * getting scaled by the given factor.
+   * Loads a game which is already in memory by copying the bytes into the RAM. Everything that
+   * doesn't fit into the RAM is cut off.
    *
-   * @param [in] scaling_factor Scales up the pixels by this factor.
+   * @param [in] game The instructions and data of the game.
    */
-  void draw (uint8_t scaling_factor);
+  void load_game (std::span<const uint8_t> game);
 
   /**
    * It will perform a full cycle of the Chip-8. It will fetch, decode and execute an instruction.
+   * The decoding is only done the first time an address is executed, afterwards the instruction
+   * is taken from the decoded instruction cache. The timers are not touched (see tick_timers).
+   * While the machine is waiting for a key (see waiting_for_key) nothing happens at all.
    */
   void cycle ();
+  FRIEND_TEST(InstructionTest, ExecutesSelfModifiedCode);
+  FRIEND_TEST(InstructionTest, ExecutesFromOddAddress);
+
+  /**
+   * Lets the delay and the sound timer count down by one, if they aren't 0 already. This has to
+   * happen 60 times per second of emulated time, no matter how fast the instructions are executed
+   * (see Scheduler).
+   */
+  void tick_timers ();
+  FRIEND_TEST(InstructionTest, TimersStopAtZero);
+  FRIEND_TEST(SchedulerTest, TicksSixtyTimesPerEmulatedSecond);
+  FRIEND_TEST(SchedulerTest, AdvancesByHostTime);
+  FRIEND_TEST(IdleTest, FindsOnlyLoopsWhichCantEnd);
+
+  /**
+   * Captures the whole state of the machine. Nothing is allocated, so it is cheap enough to be
+   * done every frame.
+   *
+   * @param [out] state Receives the state.
+   */
+  void save_state (SaveState &state) const;
+
+  /**
+   * Restores a state captured by save_state. Only the pages of the memory which differ are copied
+   * and have their decoded instructions dropped, so going back and forth between similar states
+   * is cheap. The rows of the display which change are marked as dirty.
+   *
+   * @param [in] state The state to restore.
+   * @return False if the state has a different magic or version or is broken, the machine is left
+   *         untouched then.
+   */
+  bool load_state (const SaveState &state);
+  FRIEND_TEST(StateTest, RestoresTheSameMachine);
+  FRIEND_TEST(StateTest, DecodesRestoredCodeAgain);
+
+  /**
+   * Writes the current state into a file, which contains the SaveState as it is.
+   *
+   * @param [in] path The path of the file.
+   * @return False if the file couldn't be written.
+   */
+  bool save_state_file (const std::string &path) const;
+
+  /**
+   * Restores the state from a file written by save_state_file.
+   *
+   * @param [in] path The path of the file.
+   * @return False if the file couldn't be read or contains no valid state, the machine is left
+   *         untouched then.
+   */
+  bool load_state_file (const std::string &path);
+
+  /**
+   * Tells whether an unknown opcode has been executed. The program counter stays on that
+   * instruction, so the machine doesn't make any progress afterwards and the caller decides
+   * whether to report the fault or to stop.
+   *
+   * @return The first fault since the last initialization, if there was one.
+   */
+  const std::optional<Fault> &fault () const;
+  FRIEND_TEST(InstructionTest, RejectsUnknownOpcodes);
+
+  /**
+   * Every write into a page of the memory increases its version. Execution engines that keep
+   * translated code around use it to find out whether the code they translated is still valid.
+   *
+   * @param [in] address Any memory location inside the page, wrapped around the RAM size.
+   * @return The current version of the page.
+   */
+  uint32_t page_version (uint16_t address) const;
+
+  /**
+   * Compares the state of the machine (memory, registers, stack, timers, keypad, display and
+   * random number generator).
+   * Caches are not part of the state, thus two Chip-8s are equal after running the same code,
+   * no matter which execution engine has been used.
+   *
+   * @param [in] other The Chip-8 to compare with.
+   * @return Whether both machines are in the same state.
+   */
+  bool operator== (const Chip8 &other) const;
 
   /**
    * Using this method a key will be marked as pressed (true) if it wasn't already.
    *
-   * @param [in] keysym The key which was released.
+   * @param [in] key The index of the Chip-8 key in a range from 0x0 to 0xF.
    */
-  void press_key (uint8_t keysym);
+  void press_key (uint8_t key);
 
   /**
    * Using this method a key will be marked as released (false) if it was pressed already.
    *
-   * @param [in] keysym The key which was released.
+   * @param [in] key The index of the Chip-8 key in a range from 0x0 to 0xF.
+   */
+  void release_key (uint8_t key);
+
+  /**
+   * Tells whether an Fx0A found no pressed key. Every cycle is a no-op until a key is pressed or
+   * released, so engines stop early and a frontend can sleep until the next input event. It isn't
+   * part of the state, the instruction is simply executed again after restoring one.
+   *
+   * @return True if the machine can't make any progress before the keypad changes.
+   */
+  bool waiting_for_key () const;
+  FRIEND_TEST(InstructionTest, WaitsWithoutExecutingUntilAKeyChanges);
+
+  /**
+   * Tells whether the delay or the sound timer still counts down.
+   *
+   * @return True if one of the timers isn't 0.
+   */
+  bool timers_running () const;
+
+  /**
+   * Tells whether the beeper sounds, which it does as long as the sound timer isn't 0.
+   *
+   * @return True if the tone is on.
+   */
+  bool beeping () const;
+
+  /**
+   * Gives read access to the display, so a frontend can present it. Every entry is one row,
+   * starting at the top, and the most significant bit of a row is its leftmost pixel.
+   *
+   * @return The current content of the display.
+   */
+  const std::array<DisplayRow, SCREEN_HEIGHT> &display () const;
+
+  /**
+   * Tells which rows of the display changed since the last call and forgets about them, so a
+   * frontend only has to present a frame if something was drawn.
+   *
+   * @return A mask where bit y is set if row y changed, or 0 if the display is still the same.
+   */
+  uint32_t take_dirty_rows ();
+
+#if CHIP8_COUNTERS
+  /**
+   * Gives read access to the counters of the executed instructions. The operations and addresses
+   * are only counted by cycle(), so the instructions run by other engines are missing. The drawn
+   * pixels and collisions are counted by every engine, since all of them draw through Dxyn.
+   *
+   * @return The counters since the construction of the machine.
    */
-  void release_key (uint8_t keysym);
+  const ExecutionCounters &counters () const;
+#endif
 
  private:
   /**
-   * Executes the instruction based on its opcode.
+   * The signature every entry of the dispatch table has. It forwards the needed fields of the
+   * instruction to the matching method.
+   */
+  using Handler = void (*) (Chip8 &chip, const Instruction &instruction);
+
+  using HandlerTable = std::array<Handler, (size_t)Operation::Count>;
+
+  /**
+   * Holds one handler for every operation, in the same order as the Operation enum. There is one
+   * table per quirk policy, whose handlers are instantiated with that policy.
+   */
+  template<typename Quirks>
+  static const HandlerTable HANDLERS;
+
+  /**
+   * Executes the instruction based on its opcode. The handler is looked up in the table of the
+   * current profile, and the operation in a table which is computed at compile time for every
+   * possible opcode, thus no decoding switch is needed.
    *
    * @param [in] instruction The instruction with the opcode and all its fields (x, y, nnn, n, kk).
    */
   void execute (const Instruction &instruction);
+  FRIEND_TEST(InstructionTest, IgnoresSystemCall);
+
+  /**
+   * Reads the two bytes at the given memory location and decodes them.
+   *
+   * @param [in] address The memory location of the instruction, wrapped around the RAM size.
+   * @return The instruction with the opcode and all its fields (x, y, nnn, n, kk).
+   */
+  Instruction fetch (uint16_t address) const;
+
+  /**
+   * Writes a byte into the memory and drops the cached instruction that covers this location,
+   * so self-modifying code is decoded again. Every instruction writing into the memory has to
+   * use this method.
+   *
+   * @param [in] address The memory location to write to, wrapped around the RAM size.
+   * @param [in] value   The byte which is going to be stored.
+   */
+  void store (uint16_t address, uint8_t value);
+
+  /**
+   * Moves register I behind the registers stored or loaded by Fx55 and Fx65, as far as the quirk
+   * policy says.
+   *
+   * @param [in] x_register The index of the last stored or loaded register.
+   */
+  template<typename Quirks>
+  void increase_index (uint8_t x_register);
+
+  /**
+   * Drops every cached instruction and invalidates all translated code, which is needed after the
+   * memory was replaced as a whole.
+   */
+  void invalidate_code ();
+
+  /**
+   * Moves the program counter back onto the instruction which couldn't be executed, so the
+   * machine halts on it, and records the fault unless an earlier one is still pending.
+   *
+   * @param [in] opcode The opcode of the instruction.
+   * @param [in] reason Why the instruction couldn't be executed.
+   */
+  void raise_fault (uint16_t opcode, FaultReason reason);
 
   /**
    * Used to clear the screen entirely.
@@ -133,9 +651,11 @@ class Chip8 {
 
   /**
    * This instruction will set the program counter to the popped return address from the stack.
+   * Returning with an empty stack raises a FaultReason::StackUnderflow.
    */
   void _00EE ();
   FRIEND_TEST(InstructionTest, SuccessfullyReturnsSubroutine);
+  FRIEND_TEST(InstructionTest, ReturnFaultsOnEmptyStack);
 
   /**
    * The program counter will be set to the given memory location.
@@ -147,12 +667,13 @@ class Chip8 {
 
   /**
    * Calls the subroutine at the given address. But before doing that the current program counter
-   * will be pushed to the stack.
+   * will be pushed to the stack. Calling with a full stack raises a FaultReason::StackOverflow.
    *
    * @param [in] address The absolute memory location where the subroutine begins.
    */
   void _2nnn (uint16_t address);
   FRIEND_TEST(InstructionTest, SuccessfullyCalledSubroutine);
+  FRIEND_TEST(InstructionTest, CallFaultsOnFullStack);
 
   /**
    * Skips the next instruction if the contents of the provided register (Vx) is equal to the
@@ -269,11 +790,15 @@ class Chip8 {
   /**
    * Divides the contents of register x (Vx) by 2 using a shift right operation. The least
    * significant bit will tell whether you can divide the number evenly. Thus register f (Vf)
-   * will be set to this value.
+   * will be set to this value. The COSMAC VIP shifts register y (Vy) instead and stores the
+   * result in register x (see Quirks::SHIFT_READS_Y).
    *
-   * @param [in] x_register The index for the register in a range from 0x0 to 0xF.
+   * @tparam    Quirks     The quirk policy of the emulated variant.
+   * @param [in] x_register The index for the x register in a range from 0x0 to 0xF.
+   * @param [in] y_register The index for the y register in a range from 0x0 to 0xF.
    */
-  void _8xy6 (uint8_t x_register);
+  template<typename Quirks = DefaultQuirks>
+  void _8xy6 (uint8_t x_register, uint8_t y_register);
   FRIEND_TEST(InstructionTest, DivXBy2NoLSB);
   FRIEND_TEST(InstructionTest, DivXBy2WithLSB);
 
@@ -291,13 +816,18 @@ class Chip8 {
   /**
    * Multiplies the contents of register x (Vx) by 2 using a shift left operation. The most
    * significant bit will tell whether this operation will result in 0 (overflow). Thus register f
-   * (Vf) will be set to this value.
+   * (Vf) will be set to this value. The COSMAC VIP shifts register y (Vy) instead and stores the
+   * result in register x (see Quirks::SHIFT_READS_Y).
    *
-   * @param [in] x_register The index for the register in a range from 0x0 to 0xF.
+   * @tparam    Quirks     The quirk policy of the emulated variant.
+   * @param [in] x_register The index for the x register in a range from 0x0 to 0xF.
+   * @param [in] y_register The index for the y register in a range from 0x0 to 0xF.
    */
-  void _8xyE (uint8_t x_register);
+  template<typename Quirks = DefaultQuirks>
+  void _8xyE (uint8_t x_register, uint8_t y_register);
   FRIEND_TEST(InstructionTest, MulXBy2NoMSB);
   FRIEND_TEST(InstructionTest, MulXBy2WithMSB);
+  FRIEND_TEST(InstructionTest, ShiftsYIntoXWithVipQuirks);
 
   /**
    * Skips the next instruction if the value of register x (Vx) is not equal to the value of
@@ -319,12 +849,17 @@ class Chip8 {
   FRIEND_TEST(InstructionTest, LoadMemoryAddress);
 
   /**
-   * Jumps to the given address relative to the register 0 (V0).
+   * Jumps to the given address relative to the register 0 (V0). The CHIP-48 and the SUPER-CHIP
+   * read register x (Vx) instead, where x is the highest digit of the address (see
+   * Quirks::JUMP_ADDS_X).
    *
-   * @param [in] address The relative memory location which is added to register 0.
+   * @tparam    Quirks  The quirk policy of the emulated variant.
+   * @param [in] address The relative memory location which is added to the register.
    */
+  template<typename Quirks = DefaultQuirks>
   void Bnnn (uint16_t address);
   FRIEND_TEST(InstructionTest, JumpAddressRelativeToV0);
+  FRIEND_TEST(InstructionTest, JumpAddressRelativeToXWithChip48Quirks);
 
   /**
    * Generates a random number which is then logical ANDed with the given constant. The result
@@ -339,28 +874,36 @@ class Chip8 {
   /**
    * Display a n-byte sprite located at memory location I. The register x (Vx) will be used as x
    * position and register y (Vy) for the y position. If a collision occured register f (Vf) will
-   * be set.
+   * be set. The position wraps around the display. Depending on Quirks::CLIP_SPRITES the part of
+   * the sprite which crosses an edge is either cut off or wraps around as well.
    *
+   * @tparam    Quirks     The quirk policy of the emulated variant.
    * @param [in] x_register The value contained in this register (a value in range from 0x0 to 0xF)
    *                        is the x position on the screen.
    * @param [in] y_register The value contained in this register (a value in range from 0x0 to 0xF)
    *                        is the y position on the screen.
    * @param [in] bytes      Defines how many bytes will be read relative to register I.
    */
+  template<typename Quirks = DefaultQuirks>
   void Dxyn (uint8_t x_register, uint8_t y_register, uint8_t bytes);
   FRIEND_TEST(InstructionTest, DrawNSpritesAtXY);
+  FRIEND_TEST(InstructionTest, DrawWrapsAroundEdges);
+  FRIEND_TEST(InstructionTest, DrawClipsAtEdgesWithVipQuirks);
 
   /**
-   * Skips the next instruction if the key equals to the value of register x (Vx).
+   * Skips the next instruction if the key equals to the value of register x (Vx). Only the low
+   * nibble of Vx selects the key.
    *
    * @param [in] x_register The index for the register in a range from 0x0 to 0xF.
    */
   void Ex9E (uint8_t x_register);
   FRIEND_TEST(InstructionTest, SkipIfXKeyIsPressed_True);
   FRIEND_TEST(InstructionTest, SkipIfXKeyIsPressed_False);
+  FRIEND_TEST(InstructionTest, KeyChecksUseLowNibble);
 
   /**
-   * Skips the next instruction if the key doesn't equals to the value of register x (Vx).
+   * Skips the next instruction if the key doesn't equals to the value of register x (Vx). Only
+   * the low nibble of Vx selects the key.
    *
    * @param [in] x_register The index for the register in a range from 0x0 to 0xF.
    */
@@ -377,8 +920,9 @@ class Chip8 {
   FRIEND_TEST(InstructionTest, StoreDelayTimerIntoX);
 
   /**
-   * Waits until a key is pressed. This is achieved by going back a instruction if no key has
-   * been pressed. But if a key was pressed the keymap index will be stored in the register x (Vx).
+   * Waits until a key is pressed. If no key has been pressed the program counter goes back to this
+   * instruction and the machine enters the waiting state, which only a change of the keypad ends.
+   * But if a key was pressed the keymap index will be stored in the register x (Vx).
    *
    * @param [in] x_register The index for the register in a range from 0x0 to 0xF.
    */
@@ -431,33 +975,55 @@ class Chip8 {
   /**
    * Stores all registers from 0 to x (V0-Vx) at the first x memory locations relative to
    * register I.
-   * Afterwards register I will be increased by x + 1.
+   * Afterwards register I will be increased by x + 1, by x or not at all (see Quirks::INDEX).
    *
+   * @tparam    Quirks     The quirk policy of the emulated variant.
    * @param [in] x_register The index for the register in a range from 0x0 to 0xF.
    */
+  template<typename Quirks = DefaultQuirks>
   void Fx55 (uint8_t x_register);
   FRIEND_TEST(InstructionTest, StoreRegsToXToI);
+  FRIEND_TEST(InstructionTest, IncreasesIByXWithChip48Quirks);
 
   /**
    * Stores the first x bytes located relative to register I in memory into all registers from 0
    * to x (V0-Vx).
-   * Afterwards register I will be increased by x + 1.
+   * Afterwards register I will be increased by x + 1, by x or not at all (see Quirks::INDEX).
    *
+   * @tparam    Quirks     The quirk policy of the emulated variant.
    * @param [in] x_register The index for the register in a range from 0x0 to 0xF.
    */
+  template<typename Quirks = DefaultQuirks>
   void Fx65 (uint8_t x_register);
   FRIEND_TEST(InstructionTest, StoreIToXIntoRegs);
+  FRIEND_TEST(InstructionTest, KeepsIWithSuperChipQuirks);
 
  private:
-  SDL_Renderer *renderer_;
-  SDL_Window *window_;
+  /**
+   * @brief An already decoded instruction together with its handler. An entry without a handler
+   * hasn't been decoded yet or was invalidated by a write.
+   */
+  struct CachedInstruction {
+    Handler handler;
+    Instruction instruction;
+  };
 
-  std::array<bool, SCREEN_WIDTH * SCREEN_HEIGHT> display_;
-  bool draw_flag_;
+  std::array<DisplayRow, SCREEN_HEIGHT> display_;
+  uint32_t dirty_rows_;
+  static_assert(sizeof (uint32_t) * 8 == SCREEN_HEIGHT);
 
   std::array<uint8_t, KEYPAD_SIZE> keypad_;
+  bool waiting_for_key_;
 
   std::array<uint8_t, RAM_SIZE> memory_;
+  std::array<CachedInstruction, RAM_SIZE / 2> decoded_;
+  std::array<uint32_t, RAM_SIZE / CODE_PAGE_SIZE> page_versions_;
+  // No two machines of the process share a generation, and every initialization starts a new one.
+  // The engines compare it with the one of their cached code, since a new machine can be at the
+  // same address and have the same page versions as the previous one.
+  uint64_t generation_;
+  const HandlerTable *handlers_;
+  QuirkProfile quirks_;
   uint16_t program_counter_;
 
   std::array<uint16_t, STACK_SIZE> stack_;
@@ -465,7 +1031,16 @@ class Chip8 {
 
   std::array<uint8_t, V_REGISTERS> V_;
   uint8_t delay_timer_, sound_timer_;
-  uint16_t I_: 12;
+  // Not a bit-field, so generated code can access it directly. Every write keeps it inside the RAM.
+  uint16_t I_;
+
+  uint32_t random_state_;
+
+  std::optional<Fault> fault_;
+
+#if CHIP8_COUNTERS
+  ExecutionCounters counters_;
+#endif
 };
 
 #endif //_CHIP8_H_
@@ -0,0 +1,34 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _COUNTERS_H_
+#define _COUNTERS_H_
+
+#include <ostream>
+
+#include "chip8.h"
+
+// The amount of addresses listed in the report, starting with the most executed one.
+#define COUNTERS_HOT_ADDRESSES 16
+
+/**
+ * Gives the name of an operation as it is written in the instruction set, e.g. "8xy4".
+ *
+ * @param [in] operation The operation.
+ * @return The name, or "invalid" for unknown opcodes.
+ */
+const char *operation_name (Operation operation);
+
+#if CHIP8_COUNTERS
+/**
+ * Writes a readable report of the counters: every executed operation with its share of the
+ * cycles, the most executed addresses and how much was drawn.
+ *
+ * @param [in] output   The stream the report is written to.
+ * @param [in] counters The counters of a Chip-8 (see Chip8::counters).
+ */
+void write_counters (std::ostream &output, const ExecutionCounters &counters);
+#endif
+
+#endif //_COUNTERS_H_
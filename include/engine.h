@@ -0,0 +1,65 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "chip8.h"
+
+/**
+ * @brief All the available ways of executing the instructions of a Chip-8.
+ */
+enum class EngineType {
+  Interpreter,
+  Threaded,
+  Jit,
+};
+
+/**
+ * @brief An execution engine runs the instructions of a Chip-8. Every engine has to leave the
+ * Chip-8 in exactly the same state as the interpreter would after the same amount of cycles.
+ */
+class Engine {
+ public:
+  virtual ~Engine () = default;
+
+  /**
+   * Executes the given amount of cycles.
+   *
+   * @param [in] chip   The Chip-8 whose instructions will be executed.
+   * @param [in] cycles The amount of instructions to execute.
+   */
+  virtual void run (Chip8 &chip, uint64_t cycles) = 0;
+};
+
+/**
+ * @brief The reference engine, which simply performs one cycle after another.
+ */
+class InterpreterEngine : public Engine {
+ public:
+  void run (Chip8 &chip, uint64_t cycles) override;
+};
+
+/**
+ * Creates the engine of the given type.
+ *
+ * @param [in] type The kind of engine to create.
+ * @return The new engine.
+ */
+std::unique_ptr<Engine> make_engine (EngineType type);
+
+/**
+ * Finds the engine type with the given name, as used on the command line.
+ *
+ * @param [in] name The name of the engine, e.g. "interpreter", "threaded" or "jit".
+ * @return The engine type or nothing if there is no engine with this name.
+ */
+std::optional<EngineType> parse_engine_type (const std::string &name);
+
+#endif //_ENGINE_H_
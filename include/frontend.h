@@ -0,0 +1,102 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _FRONTEND_H_
+#define _FRONTEND_H_
+
+#include <expected>
+#include <optional>
+#include <string>
+
+#include <SDL2/SDL.h>
+
+#include "audio.h"
+#include "chip8.h"
+#include "keymap.h"
+
+static_assert(SDL_NUM_SCANCODES <= KEY_MAP_SCANCODES);
+
+/**
+ * The hex keypad (1 2 3 C / 4 5 6 D / 7 8 9 E / A 0 B F) on the keys 1-4, Q-R, A-F and Z-V of a
+ * QWERTY keyboard.
+ */
+inline constexpr KeyMap DEFAULT_KEY_MAP ({
+    SDL_SCANCODE_X, SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, // 0 1 2 3
+    SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_A, // 4 5 6 7
+    SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_Z, SDL_SCANCODE_C, // 8 9 A B
+    SDL_SCANCODE_4, SDL_SCANCODE_R, SDL_SCANCODE_F, SDL_SCANCODE_V, // C D E F
+});
+
+/**
+ * @brief The SDL frontend which owns the window and renderer. It presents the display of a Chip8
+ * and translates keyboard events into Chip-8 keys.
+ */
+class Frontend {
+ public:
+  Frontend ();
+
+  virtual ~Frontend ();
+
+  /**
+   * Initializes the SDL window and renderer. The scaling factor is needed to compute the real
+   * size of the window.
+   *
+   * @param [in] scaling_factor The factor used by which the pixels are getting scaled.
+   * @param [in] vsync          Lets presenting a frame wait for the refresh of the display.
+   */
+  void initialize (uint8_t scaling_factor, bool vsync);
+
+  /**
+   * Changes the title of the window, e.g. to show statistics.
+   *
+   * @param [in] title The new title.
+   */
+  void set_title (const std::string &title);
+
+  /**
+   * Draws the display of the Chip-8 to the window. The changed rows are converted into a
+   * streaming texture of 64x32 pixels, which the renderer scales up by the factor given on
+   * initialization in a single copy.
+   *
+   * @param [in] chip       The Chip-8 whose display will be drawn.
+   * @param [in] dirty_rows The rows that changed since the last frame (see take_dirty_rows).
+   */
+  void draw (const Chip8 &chip, uint32_t dirty_rows);
+
+  /**
+   * Starts playing the beeper through the default audio device. The device asks for
+   * AUDIO_BUFFER_SAMPLES at a time and the beeper fills them right in the callback.
+   *
+   * @param [in] beeper The beeper, which has to live until the frontend is destroyed.
+   * @return False if there is no audio device, the game runs without sound then.
+   */
+  bool open_audio (Beeper &beeper);
+
+  /**
+   * Replaces keys of the DEFAULT_KEY_MAP by a configuration file, which names the host keys like
+   * SDL does (see KeyMap::load).
+   *
+   * @param [in] path The path of the file.
+   * @return A description of the error, the keys are left untouched then.
+   */
+  std::expected<void, std::string> load_key_map (const std::string &path);
+
+  /**
+   * Translates a SDL key into the index of the matching Chip-8 key by its scancode.
+   *
+   * @param [in] keysym The SDL key which was pressed or released.
+   * @return The Chip-8 key index or nothing if the key isn't mapped.
+   */
+  std::optional<uint8_t> map_key (const SDL_Keysym &keysym) const;
+
+ private:
+  KeyMap key_map_;
+  SDL_Renderer *renderer_;
+  SDL_Texture *texture_;
+  SDL_Window *window_;
+  SDL_AudioDeviceID audio_;
+  uint8_t scaling_factor_;
+};
+
+#endif //_FRONTEND_H_
@@ -0,0 +1,56 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _HEADLESS_H_
+#define _HEADLESS_H_
+
+#include <cstdint>
+
+#include "chip8.h"
+#include "engine.h"
+#include "scheduler.h"
+
+/**
+ * @brief Defines when a headless run is going to stop. A limit of 0 means that it is not used,
+ * but at least one of them has to be set.
+ */
+struct HeadlessLimits {
+  uint64_t max_cycles;
+  uint64_t max_frames;
+};
+
+/**
+ * @brief Stores what has been done during a headless run.
+ */
+struct HeadlessStats {
+  uint64_t cycles;
+  uint64_t frames;
+  double seconds;
+};
+
+/**
+ * Runs the Chip-8 without any display and without waiting for the wall-clock. A frame consists of
+ * the instructions between two ticks of the 60 Hz timers, just like in the windowed mode, but the
+ * frames are executed back to back as fast as the host allows. The run also stops at the end of
+ * the frame in which the Chip-8 faulted (see Chip8::fault).
+ *
+ * @param [in] chip      The already initialized Chip-8 with a loaded game.
+ * @param [in] engine    The engine which executes the instructions.
+ * @param [in] scheduler Defines the rate of instructions per emulated second.
+ * @param [in] limits    Defines after how many cycles or frames the run will stop.
+ * @return The amount of executed cycles and frames and how long it took.
+ */
+HeadlessStats run_headless (Chip8 &chip, Engine &engine, Scheduler &scheduler,
+                            const HeadlessLimits &limits);
+
+/**
+ * Computes a FNV-1a hash of the display, so the outcome of two runs can be compared without
+ * looking at every pixel.
+ *
+ * @param [in] chip The Chip-8 whose display will be hashed.
+ * @return The hash of the current display content.
+ */
+uint64_t display_hash (const Chip8 &chip);
+
+#endif //_HEADLESS_H_
@@ -0,0 +1,67 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _IDLE_H_
+#define _IDLE_H_
+
+#include <cstdint>
+#include <optional>
+
+#include "engine.h"
+
+// How many instructions are executed before looking for an idle loop again.
+#define IDLE_CHECK_INTERVAL 256
+
+/**
+ * @brief A loop which leaves the machine in the same state after every iteration, as long as
+ * neither the keys nor the timers change.
+ */
+struct IdleLoop {
+  uint16_t start;
+  uint16_t length;
+};
+
+/**
+ * @brief Runs the instructions with another engine, but skips the loops in which a game only
+ * waits. Keys change and timers tick only between two runs (see Scheduler), so a loop that can't
+ * end by itself during a run can be skipped up to its end, which makes mostly idle games cheap.
+ * The machine ends up exactly like it would after executing every instruction, thus the skipped
+ * instructions still count and emulated time stays correct.
+ *
+ * The recognized loops are:
+ * - a jump to itself (1nnn), which many games use to halt,
+ * - waiting for a key (Fx0A) while no key is pressed,
+ * - waiting for the delay timer (Fx07, 3xkk or 4xkk, 1nnn back to the Fx07) while the skip isn't
+ *   taken.
+ */
+class IdleSkipper : public Engine {
+ public:
+  /**
+   * @param [in] engine The engine which executes everything that isn't skipped.
+   */
+  explicit IdleSkipper (Engine &engine);
+
+  void run (Chip8 &chip, uint64_t cycles) override;
+
+  /**
+   * Tells how many instructions were skipped so far.
+   *
+   * @return The amount of skipped instructions.
+   */
+  uint64_t skipped () const;
+
+  /**
+   * Looks for an idle loop around the program counter.
+   *
+   * @param [in] chip The Chip-8 to inspect.
+   * @return The loop the program counter is in, if it can't end before the keys or timers change.
+   */
+  static std::optional<IdleLoop> find_loop (const Chip8 &chip);
+
+ private:
+  Engine &engine_;
+  uint64_t skipped_;
+};
+
+#endif //_IDLE_H_
@@ -0,0 +1,110 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "engine.h"
+
+#define JIT_BLOCK_MAX_INSTRUCTIONS 32
+#define JIT_HOT_THRESHOLD          8
+#define JIT_CODE_BUFFER_SIZE       (1 << 20)
+
+/**
+ * @brief A dynamic recompiler which translates hot basic blocks into x86-64 machine code. Within a
+ * block the program counter is only known at compile time and register I is kept in a host
+ * register, while the V registers are accessed directly in the memory of the Chip-8. Instructions
+ * that draw, read keys or timers, call subroutines or write memory call back into the Chip8
+ * class. Invalid instructions are interpreted. On other platforms than x86-64 the whole engine
+ * falls back to the interpreter.
+ */
+class JitEngine : public Engine {
+ public:
+  JitEngine ();
+
+  ~JitEngine () override;
+
+  void run (Chip8 &chip, uint64_t cycles) override;
+
+  /**
+   * Tells whether the recompiler can generate code for the host.
+   *
+   * @return True if the host is a x86-64 machine with executable memory mappings.
+   */
+  static bool supported ();
+
+ private:
+  /**
+   * Generated code is called with the Chip-8 and the amount of cycles that may be executed at
+   * most. It returns the amount of instructions it actually executed.
+   */
+  using Code = uint32_t (*) (Chip8 *chip, uint32_t cycles);
+
+  /**
+   * @brief A basic block starting at one memory location. Until it got hot it has no code and is
+   * interpreted. The versions of the first and the last page tell whether the code is still valid.
+   * A block which doesn't end with a jump, call, return or skip falls through to the following
+   * instruction.
+   */
+  struct Block {
+    uint16_t first_page, last_page;
+    uint32_t first_page_version, last_page_version;
+    uint32_t executions;
+    uint32_t length;
+    bool falls_through;
+    Code code;
+  };
+
+  /**
+   * Finds the block for the current program counter and compiles it once it got hot.
+   *
+   * @param [in] chip The Chip-8 whose instructions will be executed.
+   * @return The block, which has no code if it has to be interpreted.
+   */
+  const Block &lookup (Chip8 &chip);
+
+  /**
+   * Translates the instructions starting at the given memory location into machine code.
+   *
+   * @param [in]     chip  The Chip-8 whose instructions will be translated.
+   * @param [in]     start The memory location of the first instruction.
+   * @param [in,out] block The block which receives the code, its length and its pages.
+   */
+  void compile (const Chip8 &chip, uint16_t start, Block &block);
+
+  /**
+   * Copies the machine code into the executable buffer.
+   *
+   * @param [in] code The machine code of a block.
+   * @return The executable code or nullptr if the buffer is full.
+   */
+  Code install (const std::vector<uint8_t> &code);
+
+  /**
+   * Drops all blocks and their code.
+   */
+  void flush ();
+
+  /**
+   * Executes a single instruction on behalf of the generated code.
+   *
+   * @param [in] chip   The Chip-8 executing the instruction.
+   * @param [in] opcode The two bytes of the instruction.
+   */
+  static void execute (Chip8 *chip, uint32_t opcode);
+
+  // The machine the blocks were translated for.
+  const Chip8 *chip_;
+  uint64_t generation_;
+  QuirkProfile quirks_;
+  std::array<std::unique_ptr<Block>, RAM_SIZE> blocks_;
+  uint8_t *buffer_;
+  size_t buffer_used_;
+};
+
+#endif //_JIT_H_
@@ -0,0 +1,116 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _KEYMAP_H_
+#define _KEYMAP_H_
+
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <istream>
+#include <optional>
+#include <string>
+
+#include "chip8.h"
+
+// The amount of scancodes SDL knows (SDL_NUM_SCANCODES), which is the size of the table.
+#define KEY_MAP_SCANCODES 512
+#define KEY_UNMAPPED      0xFF
+
+/**
+ * @brief Translates the scancodes of the host keyboard into Chip-8 keys by a table with one entry
+ * per scancode, so every event is a single lookup. Scancodes describe the position of a key rather
+ * than its label, thus the layout of the hex keypad stays the same on every keyboard layout.
+ * Several host keys can press the same Chip-8 key.
+ */
+class KeyMap {
+ public:
+  /**
+   * Finds the scancode of a host key by its name, e.g. "W" or "Keypad 5".
+   */
+  using Resolver = std::function<std::optional<uint16_t> (const std::string &name)>;
+
+  /**
+   * Creates a map without any key.
+   */
+  constexpr KeyMap () : keys_ () {
+    this->keys_.fill (KEY_UNMAPPED);
+  }
+
+  /**
+   * Creates a map with one host key per Chip-8 key.
+   *
+   * @param [in] scancodes The scancodes of the Chip-8 keys 0x0 to 0xF, in this order.
+   */
+  constexpr explicit KeyMap (const std::array<uint16_t, KEYPAD_SIZE> &scancodes) : KeyMap () {
+    for (uint8_t key = 0; key < KEYPAD_SIZE; key++) {
+      this->bind (scancodes[key], key);
+    }
+  }
+
+  /**
+   * Lets a host key press a Chip-8 key, replacing what the host key pressed before. Scancodes
+   * outside of the table are ignored.
+   *
+   * @param [in] scancode The scancode of the host key.
+   * @param [in] key      The index of the Chip-8 key in a range from 0x0 to 0xF.
+   */
+  constexpr void bind (uint16_t scancode, uint8_t key) {
+    if (scancode < KEY_MAP_SCANCODES) {
+      this->keys_[scancode] = key & 0xF;
+    }
+  }
+
+  /**
+   * Removes every host key which presses the given Chip-8 key.
+   *
+   * @param [in] key The index of the Chip-8 key in a range from 0x0 to 0xF.
+   */
+  constexpr void unbind (uint8_t key) {
+    for (auto &mapped : this->keys_) {
+      mapped = mapped == (key & 0xF) ? KEY_UNMAPPED : mapped;
+    }
+  }
+
+  /**
+   * Translates a host key into the Chip-8 key it presses.
+   *
+   * @param [in] scancode The scancode of the host key.
+   * @return The Chip-8 key index or nothing if the key isn't mapped.
+   */
+  constexpr std::optional<uint8_t> map (uint32_t scancode) const {
+    if (scancode >= KEY_MAP_SCANCODES || this->keys_[scancode] == KEY_UNMAPPED) {
+      return std::nullopt;
+    }
+
+    return this->keys_[scancode];
+  }
+
+  /**
+   * Changes the map by a configuration. Every line consists of a Chip-8 key as a hex digit and
+   * the name of a host key, e.g. "5 W", and lines starting with # are ignored. A Chip-8 key which
+   * appears in the configuration loses its previous host keys, all the other keys stay as they
+   * are.
+   *
+   * @param [in] input   The configuration.
+   * @param [in] resolve Finds the scancodes of the named host keys.
+   * @return A description of the first invalid line, the map is left untouched then.
+   */
+  std::expected<void, std::string> load (std::istream &input, const Resolver &resolve);
+
+  /**
+   * Changes the map by a configuration file (see load).
+   *
+   * @param [in] path    The path of the file.
+   * @param [in] resolve Finds the scancodes of the named host keys.
+   * @return A description of the error, the map is left untouched then.
+   */
+  std::expected<void, std::string> load_file (const std::string &path, const Resolver &resolve);
+
+ private:
+  std::array<uint8_t, KEY_MAP_SCANCODES> keys_;
+};
+
+#endif //_KEYMAP_H_
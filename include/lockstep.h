@@ -0,0 +1,196 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _LOCKSTEP_H_
+#define _LOCKSTEP_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "chip8.h"
+
+// The amount of lanes processed by one AVX2 instruction on byte registers.
+#define LOCKSTEP_LANE_BLOCK 32
+// A group has to contain at least this share (1/n) of the lanes still waiting in a step,
+// otherwise the remaining lanes are executed one after another.
+#define LOCKSTEP_MIN_GROUP_SHARE 16
+
+/**
+ * @brief Runs many instances of the same game in lockstep, e.g. to try out different inputs. The
+ * registers, timers and keypads of all instances ("lanes") are stored as structure-of-arrays,
+ * while the memory, stack and display of a lane live in its own Chip8.
+ *
+ * In every step each lane executes exactly one instruction. Lanes whose program counter points at
+ * the same instruction form a group, and if the instruction only works on registers, it is
+ * executed for the whole group at once using AVX2. Every other instruction, lanes which diverged
+ * too much and hosts without AVX2 fall back to the Chip8 class, one lane at a time.
+ */
+class LockstepEngine {
+ public:
+  /**
+   * @param [in] lanes The amount of instances to run.
+   */
+  explicit LockstepEngine (size_t lanes);
+
+  /**
+   * Initializes every lane and loads the same game into all of them.
+   *
+   * @param [in] game   The instructions and data of the game.
+   * @param [in] quirks The variant of the Chip-8 every lane emulates (see Chip8::set_quirks).
+   */
+  void load_game (std::span<const uint8_t> game, QuirkProfile quirks = QuirkProfile::Default);
+
+  /**
+   * Lets every lane execute the given amount of cycles. The timers are not touched (see
+   * tick_timers).
+   *
+   * @param [in] cycles The amount of instructions every lane executes.
+   */
+  void run (uint64_t cycles);
+
+  /**
+   * Lets the delay and the sound timer of every lane count down by one, if they aren't 0 already.
+   */
+  void tick_timers ();
+
+  /**
+   * Marks a key of a single lane as pressed.
+   *
+   * @param [in] lane The index of the lane.
+   * @param [in] key  The index of the Chip-8 key in a range from 0x0 to 0xF.
+   */
+  void press_key (size_t lane, uint8_t key);
+
+  /**
+   * Marks a key of a single lane as released.
+   *
+   * @param [in] lane The index of the lane.
+   * @param [in] key  The index of the Chip-8 key in a range from 0x0 to 0xF.
+   */
+  void release_key (size_t lane, uint8_t key);
+
+  /**
+   * Copies the whole state of a lane into a Chip8, e.g. to compare it with a scalar run.
+   *
+   * @param [in]  lane The index of the lane.
+   * @param [out] chip Receives the state of the lane.
+   */
+  void snapshot (size_t lane, Chip8 &chip) const;
+
+  /**
+   * @param [in] lane The index of the lane.
+   * @return The current content of the display of the lane.
+   */
+  const std::array<DisplayRow, SCREEN_HEIGHT> &display (size_t lane) const;
+
+  /**
+   * @param [in] lane The index of the lane.
+   * @return The first fault of the lane since the game was loaded, if there was one.
+   */
+  const std::optional<Fault> &fault (size_t lane) const;
+
+  /**
+   * @return The amount of instances.
+   */
+  size_t lanes () const;
+
+  /**
+   * @return True if groups of lanes are executed with AVX2, otherwise every lane is executed by
+   * its Chip8.
+   */
+  bool vectorized () const;
+
+ private:
+  /**
+   * Finds the lanes waiting in this step whose next instruction is the same as the one of the
+   * first waiting lane. Lanes which wrote into the page of the instruction are only added if
+   * their memory still contains the same opcode.
+   *
+   * @param [in] first       The first lane waiting in this step.
+   * @param [in] instruction The instruction of the first lane.
+   * @return The amount of lanes in the group.
+   */
+  size_t find_group (size_t first, const Instruction &instruction);
+
+  /**
+   * Executes an instruction for all the lanes in the group at once.
+   *
+   * @param [in] first       The first lane of the group.
+   * @param [in] instruction The instruction all lanes in the group execute.
+   * @return False if the instruction can't be executed for many lanes at once.
+   */
+  bool execute_group (size_t first, const Instruction &instruction);
+
+  /**
+   * Executes a single instruction of one lane by the Chip8 class.
+   *
+   * @param [in] lane        The index of the lane.
+   * @param [in] instruction The instruction at the program counter of the lane.
+   * @param [in] operation   The operation of the instruction.
+   * @param [in] registers   A mask of the V registers the instruction uses.
+   */
+  void step (size_t lane, const Instruction &instruction, Operation operation,
+             uint16_t registers);
+
+  /**
+   * Reads the instruction at the given address of a lane. As long as a lane didn't write into
+   * the page, the instruction is taken from the loaded game.
+   *
+   * @param [in] lane    The index of the lane.
+   * @param [in] address The memory location of the instruction.
+   * @return The instruction with the opcode and all its fields (x, y, nnn, n, kk).
+   */
+  Instruction fetch (size_t lane, uint16_t address) const;
+
+  /**
+   * Copies the registers and timers of a lane into a Chip8. The V registers which aren't in the
+   * mask are left as they are.
+   *
+   * @param [in]  lane      The index of the lane.
+   * @param [out] chip      The Chip8 receiving the registers.
+   * @param [in]  registers A mask where bit n stands for register Vn.
+   * @param [in]  keypad    Whether the keypad is copied as well.
+   */
+  void load_registers (size_t lane, Chip8 &chip, uint16_t registers, bool keypad) const;
+
+  /**
+   * Copies the registers and timers of the Chip8 of a lane back into the arrays.
+   *
+   * @param [in] lane      The index of the lane.
+   * @param [in] registers A mask where bit n stands for register Vn.
+   */
+  void store_registers (size_t lane, uint16_t registers);
+
+  size_t lanes_;
+  bool vectorized_;
+  // Whether 8xy6 and 8xyE of the loaded profile read Vy, which the vectorized code doesn't do.
+  bool shift_reads_y_;
+
+  std::unique_ptr<Chip8> game_;
+  std::vector<Chip8> chips_;
+
+  std::array<std::vector<uint8_t>, V_REGISTERS> V_;
+  std::vector<uint16_t> I_;
+  std::vector<uint16_t> program_counter_;
+  std::vector<uint8_t> delay_timer_, sound_timer_;
+  std::vector<uint16_t> keypad_;
+
+  // One bit per page of the memory a lane has written to.
+  std::vector<uint64_t> written_pages_;
+  uint64_t written_pages_of_any_lane_;
+  static_assert(RAM_SIZE / CODE_PAGE_SIZE == 64);
+
+  // 0xFF for the lanes in the current group, which are going to execute the same instruction.
+  std::vector<uint8_t> group_;
+  // 0xFF for the lanes of the group whose skip condition is true.
+  std::vector<uint8_t> skip_;
+  // 1 for the lanes which already executed their instruction in the current step.
+  std::vector<uint8_t> done_;
+};
+
+#endif //_LOCKSTEP_H_
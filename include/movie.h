@@ -0,0 +1,147 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _MOVIE_H_
+#define _MOVIE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+#include "engine.h"
+
+#define MOVIE_MAGIC   0x564D3843 // "C8MV"
+#define MOVIE_VERSION 1
+
+/**
+ * @brief A key which was pressed or released before the given instruction was executed.
+ */
+struct MovieEvent {
+  uint64_t cycle;
+  uint8_t key;
+  bool pressed;
+
+  bool operator== (const MovieEvent &other) const = default;
+};
+
+/**
+ * @brief Everything needed to play a game again exactly as it was played live: the seed of the
+ * random numbers, the quirk profile and every key event stamped with the amount of instructions
+ * executed before it. The hashes of the display are taken every hash_interval frames of emulated
+ * time, so a replay can tell where it started to differ.
+ */
+struct Movie {
+  uint32_t seed;
+  uint32_t hash_interval;
+  uint64_t instructions_per_second;
+  QuirkProfile quirks;
+  // The hash of the memory at the start, which detects replaying with another game.
+  uint64_t game_hash;
+  uint64_t cycles;
+  uint64_t final_hash;
+  std::vector<MovieEvent> events;
+  std::vector<uint64_t> hashes;
+
+  /**
+   * Writes the movie into a binary file.
+   *
+   * @param [in] path The path of the file.
+   * @return False if the file couldn't be written.
+   */
+  bool save (const std::string &path) const;
+
+  /**
+   * Reads a movie written by save.
+   *
+   * @param [in] path The path of the file.
+   * @return False if the file couldn't be read or is no valid movie, the movie is left untouched
+   *         then.
+   */
+  bool load (const std::string &path);
+
+  bool operator== (const Movie &other) const = default;
+};
+
+/**
+ * @brief Records a movie during live play. It is used as the engine of the Scheduler and forwards
+ * the instructions to the real engine, but stops at every hash to take it exactly at the end of a
+ * frame. The keys have to be pressed and released through the recorder, so it knows after which
+ * instruction they changed.
+ */
+class MovieRecorder : public Engine {
+ public:
+  /**
+   * Starts a recording and seeds the random numbers of the machine. The quirk profile of the
+   * machine is recorded as well.
+   *
+   * @param [in] chip                    The Chip-8, just initialized and with its game loaded.
+   * @param [in] engine                  The engine which executes the instructions.
+   * @param [in] instructions_per_second The rate the Scheduler uses.
+   * @param [in] seed                    The seed of the random numbers.
+   * @param [in] hash_interval           The amount of frames between two hashes, at least 1.
+   */
+  MovieRecorder (Chip8 &chip, Engine &engine, uint64_t instructions_per_second, uint32_t seed,
+                 uint32_t hash_interval);
+
+  void run (Chip8 &chip, uint64_t cycles) override;
+
+  /**
+   * Presses a key on the machine and records it.
+   */
+  void press_key (Chip8 &chip, uint8_t key);
+
+  /**
+   * Releases a key on the machine and records it.
+   */
+  void release_key (Chip8 &chip, uint8_t key);
+
+  /**
+   * Ends the movie at the current instruction.
+   *
+   * @param [in] chip The recorded Chip-8, whose display is hashed a last time.
+   * @return The finished movie.
+   */
+  const Movie &finish (const Chip8 &chip);
+
+ private:
+  Engine &engine_;
+  Movie movie_;
+  uint64_t cycles_;
+  uint64_t next_hash_cycle_;
+};
+
+/**
+ * @brief Tells how a replay went.
+ */
+struct ReplayResult {
+  bool game_matches;
+  uint64_t cycles;
+  uint64_t checked_hashes;
+  // The frame of the first hash which didn't match, if any did not.
+  std::optional<uint64_t> mismatch_frame;
+  bool final_matches;
+  double seconds;
+
+  /**
+   * @return Whether the replay ended up exactly like the recording.
+   */
+  bool matches () const;
+};
+
+/**
+ * Replays a movie as fast as the host allows, without a window. The key events are applied before
+ * exactly the same instructions as during the recording, so the display has to be bit-identical
+ * to the recording at every hash and at the end. The machine is switched to the quirk profile of
+ * the recording.
+ *
+ * @param [in] movie  The recorded movie.
+ * @param [in] chip   The Chip-8 which has just been initialized and got its game.
+ * @param [in] engine The engine which executes the instructions.
+ * @return What has been compared and whether it matched.
+ */
+ReplayResult replay_movie (const Movie &movie, Chip8 &chip, Engine &engine);
+
+#endif //_MOVIE_H_
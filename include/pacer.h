@@ -0,0 +1,68 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _PACER_H_
+#define _PACER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+#include <gtest/gtest_prod.h>
+
+#define PACER_MAX_CATCH_UP_FRAMES 4
+
+/**
+ * @brief Paces the frames of the windowed mode by sleeping until the next frame is due, instead
+ * of polling the clock. The deadlines are a fixed grid, so oversleeping doesn't add up over time.
+ * If the host falls behind, the missed frames are caught up, but only a few of them, everything
+ * beyond is dropped.
+ */
+class FramePacer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit FramePacer (uint64_t frames_per_second);
+
+  /**
+   * Sleeps until the next frame is due.
+   *
+   * @return The amount of frames which are due, which is more than 1 if the host fell behind.
+   */
+  uint32_t wait ();
+
+  /**
+   * Tells how long a single frame is.
+   *
+   * @return The duration of one frame.
+   */
+  Clock::duration period () const;
+
+  /**
+   * Measures how busy the host was since the last call, by comparing the processor time of the
+   * emulator with the time that passed on the wall-clock.
+   *
+   * @return The usage of one host core, where 1.0 means that it wasn't sleeping at all.
+   */
+  double cpu_usage ();
+
+ private:
+  /**
+   * Moves the deadline behind the given point in time and counts the frames it passed.
+   *
+   * @param [in] now The current time, which has to be at or after the deadline.
+   * @return The amount of due frames, which is between 1 and PACER_MAX_CATCH_UP_FRAMES.
+   */
+  uint32_t catch_up (Clock::time_point now);
+  FRIEND_TEST(FramePacerTest, StaysOnTheGrid);
+  FRIEND_TEST(FramePacerTest, CatchesUpWithinLimits);
+
+  Clock::duration period_;
+  Clock::time_point deadline_;
+
+  Clock::time_point usage_wall_time_;
+  std::clock_t usage_processor_time_;
+};
+
+#endif //_PACER_H_
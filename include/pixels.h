@@ -0,0 +1,31 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _PIXELS_H_
+#define _PIXELS_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "chip8.h"
+
+#define PIXEL_ON  0xFFFFFFFF
+#define PIXEL_OFF 0xFF000000
+
+/**
+ * Converts rows of the packed display into 32-bit ARGB pixels, as they are expected by a streaming
+ * texture with the ARGB8888 format. This is the only per-pixel work left for a frontend, the
+ * scaling is done by the renderer.
+ *
+ * @param [in]  display   The rows of the display (see Chip8::display).
+ * @param [in]  first_row The topmost row to convert.
+ * @param [in]  last_row  The bottommost row to convert.
+ * @param [out] pixels    The first pixel of the first row, followed by SCREEN_WIDTH pixels per row.
+ * @param [in]  pitch     The distance between the beginnings of two rows in bytes.
+ */
+void convert_display (const std::array<DisplayRow, SCREEN_HEIGHT> &display, uint32_t first_row,
+                      uint32_t last_row, uint32_t *pixels, size_t pitch);
+
+#endif //_PIXELS_H_
@@ -0,0 +1,60 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Runs independent jobs on a fixed amount of threads. Every thread owns a queue, which is
+ * filled round-robin at the start. A thread takes its jobs from the back of its own queue and,
+ * once it is empty, steals from the front of the other queues, so long jobs don't leave threads
+ * idle while others still have work.
+ */
+class WorkStealingPool {
+ public:
+  /**
+   * @param [in] threads The amount of threads, 0 uses one per hardware thread.
+   */
+  explicit WorkStealingPool (size_t threads);
+
+  /**
+   * Calls the job once for every index in [0, count) and returns after all of them finished. The
+   * jobs are called concurrently, thus they must not share any state without synchronization.
+   *
+   * @param [in] count The amount of jobs.
+   * @param [in] job   Called with the index of the job.
+   */
+  void run (size_t count, const std::function<void (size_t)> &job);
+
+  /**
+   * @return The amount of threads the jobs are distributed across.
+   */
+  size_t threads () const;
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<size_t> jobs;
+  };
+
+  /**
+   * Takes the next job of a worker, from its own queue first and otherwise from another one.
+   *
+   * @param [in]  worker The index of the worker looking for a job.
+   * @param [out] job    The index of the job that was taken.
+   * @return False if there is no job left in any queue.
+   */
+  bool take (size_t worker, size_t &job);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+};
+
+#endif //_POOL_H_
@@ -0,0 +1,80 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "engine.h"
+
+/**
+ * @brief An engine which attributes every executed cycle to the subroutine it was executed in,
+ * together with all the subroutines that called it. The instructions are interpreted one at a
+ * time and the calls (2nnn) and returns (00EE) are followed through the stack pointer, so the
+ * profile is exact, but the engine is slower than the interpreter.
+ *
+ * The result is a tree of call paths, which is written as folded stacks that flamegraph tools
+ * understand. The game itself is called "main" and every subroutine is named after its address.
+ */
+class GuestProfiler : public Engine {
+ public:
+  GuestProfiler ();
+
+  void run (Chip8 &chip, uint64_t cycles) override;
+
+  /**
+   * Writes one line per call path with the cycles spent in its last subroutine, excluding the
+   * subroutines it called, e.g. "main;0x2A4;0x31C 1200".
+   *
+   * @param [in] output The stream the folded stacks are written to.
+   */
+  void write_folded (std::ostream &output) const;
+
+  /**
+   * Tells how many cycles were spent in a subroutine, including the subroutines it called, summed
+   * over every path it was called from. Recursive calls don't count the same cycles twice.
+   *
+   * @param [in] address The address the subroutine starts at.
+   * @return The amount of cycles.
+   */
+  uint64_t inclusive_cycles (uint16_t address) const;
+
+  /**
+   * Tells how many cycles were profiled in total.
+   *
+   * @return The amount of cycles.
+   */
+  uint64_t total_cycles () const;
+
+ private:
+  /**
+   * @brief One call path. The root is the game itself, every other node is a subroutine called
+   * from its parent.
+   */
+  struct Node {
+    uint32_t parent;
+    uint16_t address;
+    uint64_t cycles;
+  };
+
+  /**
+   * Finds the node of a subroutine called from the given node, or creates it on the first call.
+   *
+   * @param [in] parent  The node of the caller.
+   * @param [in] address The address of the called subroutine.
+   * @return The index of the node.
+   */
+  uint32_t child (uint32_t parent, uint16_t address);
+
+  std::vector<Node> nodes_;
+  std::unordered_map<uint64_t, uint32_t> children_;
+  // The node of every active call, the first one is the root.
+  std::vector<uint32_t> calls_;
+};
+
+#endif //_PROFILER_H_
@@ -0,0 +1,51 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _RECOMPILER_H_
+#define _RECOMPILER_H_
+
+#include <cstdint>
+#include <set>
+#include <span>
+#include <string>
+
+#include "chip8.h"
+
+#define AOT_BLOCK_MAX_INSTRUCTIONS 16
+
+/**
+ * @brief The code found in a ROM by following every static jump, call and skip from the start of
+ * the program. Each leader starts a basic block, which is translated into a labeled piece of
+ * native code.
+ */
+struct CodeMap {
+  std::set<uint16_t> instructions;
+  std::set<uint16_t> leaders;
+};
+
+/**
+ * Finds all the instructions that can be reached from MEMORY_PROGRAM_START without executing a
+ * computed jump (Bnnn) or leaving the ROM. A return (00EE) continues after every call, which is
+ * why the instruction following a call is a leader.
+ *
+ * @param [in] rom The bytes of the game, as they are loaded into the memory.
+ * @return The reachable instructions and the start addresses of the basic blocks.
+ */
+CodeMap analyse_rom (std::span<const uint8_t> rom);
+
+/**
+ * Translates a ROM into a C++ translation unit which defines AOT_PROGRAM (see AotEngine). Every
+ * basic block becomes straight-line code working directly on the registers of the Chip-8 and
+ * static jumps become gotos, so there is no dispatch left except for returns. The code follows the
+ * quirks of the given profile, which the Chip-8 running it has to use as well.
+ *
+ * @param [in] rom    The bytes of the game, as they are loaded into the memory.
+ * @param [in] name   The name of the ROM, which is only used for the comment on top of the file.
+ * @param [in] quirks The variant of the Chip-8 the game is written for.
+ * @return The source code of the translation unit.
+ */
+std::string translate_rom (std::span<const uint8_t> rom, const std::string &name,
+                           QuirkProfile quirks = QuirkProfile::Default);
+
+#endif //_RECOMPILER_H_
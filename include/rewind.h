@@ -0,0 +1,123 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _REWIND_H_
+#define _REWIND_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest_prod.h>
+
+#include "chip8.h"
+
+// A run of unchanged bytes shorter than this is cheaper to store as part of the changed bytes.
+#define REWIND_MIN_GAP 4
+
+/**
+ * @brief Keeps the recent history of a Chip-8, so the game can be played backwards. A snapshot is
+ * recorded every frame, but only the newest one is kept as a whole. Every older one is stored as
+ * the difference (XOR) to its successor, where the unchanged bytes are run-length encoded. Most
+ * of the memory and display stay the same between two frames, so a frame usually takes only a few
+ * dozen bytes.
+ *
+ * The differences are kept in a ring buffer of a fixed size, which drops the oldest frames once it
+ * is full. Nothing is allocated after construction.
+ */
+class RewindBuffer {
+ public:
+  /**
+   * @param [in] budget The amount of bytes which may be used for the history.
+   */
+  explicit RewindBuffer (size_t budget);
+
+  /**
+   * Records the current state of the machine as the newest frame.
+   *
+   * @param [in] chip The Chip-8 to record.
+   */
+  void push (const Chip8 &chip);
+
+  /**
+   * Steps back to the frame before the newest one and forgets the newest one. The keys stay as
+   * they are pressed right now, thus releasing a key while rewinding isn't undone.
+   *
+   * @param [in,out] chip The Chip-8 which is restored.
+   * @return False if there is no older frame, the machine is left untouched then.
+   */
+  bool rewind (Chip8 &chip);
+
+  /**
+   * Forgets the whole history.
+   */
+  void clear ();
+
+  /**
+   * Tells how many times rewind can step back.
+   *
+   * @return The amount of stored differences.
+   */
+  size_t frames () const;
+
+  /**
+   * Tells how much of the budget is used by the stored differences.
+   *
+   * @return The amount of used bytes.
+   */
+  size_t used () const;
+
+ private:
+  /**
+   * Encodes the XOR of two states into the scratch buffer. It consists of blocks of a 16 bit
+   * amount of unchanged bytes which are skipped, a 16 bit amount of changed bytes and the XOR of
+   * those bytes. Unchanged bytes at the end are left out.
+   *
+   * @param [in] previous The older state.
+   * @param [in] next     The newer state.
+   * @return The amount of encoded bytes.
+   */
+  size_t encode (const SaveState &previous, const SaveState &next);
+
+  /**
+   * Applies a difference produced by encode to a state, which turns either of both states into
+   * the other one.
+   *
+   * @param [in]     delta The encoded difference.
+   * @param [in]     size  The amount of encoded bytes.
+   * @param [in,out] state The state which is changed.
+   */
+  static void decode (const uint8_t *delta, size_t size, SaveState &state);
+  FRIEND_TEST(RewindTest, EncodesOnlyChangedBytes);
+
+  /**
+   * Copies bytes into the ring buffer, wrapping around at its end.
+   */
+  void write_ring (size_t offset, const void *source, size_t size);
+
+  /**
+   * Copies bytes out of the ring buffer, wrapping around at its end.
+   */
+  void read_ring (size_t offset, void *target, size_t size) const;
+
+  /**
+   * Removes the oldest difference to make room for a new one.
+   */
+  void drop_oldest ();
+
+  // Every record is the size of the difference, the difference and the size again, so records can
+  // be walked from both ends.
+  std::vector<uint8_t> ring_;
+  size_t head_;
+  size_t tail_;
+  size_t used_;
+  size_t frames_;
+
+  bool has_newest_;
+  SaveState newest_;
+  SaveState next_;
+  std::vector<uint8_t> scratch_;
+};
+
+#endif //_REWIND_H_
@@ -0,0 +1,77 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+// Keeps the indices of both sides on their own cache line, so they don't slow each other down.
+#define RING_ALIGNMENT 64
+
+/**
+ * @brief A bounded queue between exactly one producing and one consuming thread, which never
+ * blocks and never allocates. Each side only writes its own index, the acquire and release
+ * ordering makes the entries visible together with the index.
+ *
+ * @tparam T        The type of the entries, which is copied in and out.
+ * @tparam Capacity The amount of slots, a power of two. One of them always stays free.
+ */
+template<typename T, size_t Capacity>
+class SpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0);
+
+ public:
+  SpscRing () : slots_ (), head_ (0), tail_ (0) {}
+
+  /**
+   * Appends an entry, only called by the producer.
+   *
+   * @param [in] value The entry to append.
+   * @return False if the ring is full, the entry is dropped then.
+   */
+  bool push (const T &value) {
+    auto head = this->head_.load (std::memory_order_relaxed);
+    auto next = (head + 1) & (Capacity - 1);
+    if (next == this->tail_.load (std::memory_order_acquire)) {
+      return false;
+    }
+
+    this->slots_[head] = value;
+    this->head_.store (next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Gives the oldest entry without removing it, only called by the consumer.
+   *
+   * @return The entry or nothing if the ring is empty.
+   */
+  std::optional<T> peek () const {
+    auto tail = this->tail_.load (std::memory_order_relaxed);
+    if (tail == this->head_.load (std::memory_order_acquire)) {
+      return std::nullopt;
+    }
+
+    return this->slots_[tail];
+  }
+
+  /**
+   * Removes the oldest entry, only called by the consumer after peek found one.
+   */
+  void pop () {
+    auto tail = this->tail_.load (std::memory_order_relaxed);
+    this->tail_.store ((tail + 1) & (Capacity - 1), std::memory_order_release);
+  }
+
+ private:
+  std::array<T, Capacity> slots_;
+  alignas(RING_ALIGNMENT) std::atomic<size_t> head_;
+  alignas(RING_ALIGNMENT) std::atomic<size_t> tail_;
+};
+
+#endif //_RING_H_
@@ -0,0 +1,76 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _ROM_H_
+#define _ROM_H_
+
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chip8.h"
+
+/**
+ * @brief The bytes of a ROM file, which are shared by everyone who loaded the same content.
+ */
+using RomImage = std::shared_ptr<const std::vector<uint8_t>>;
+
+/**
+ * Reads a whole ROM file with a single read, after checking that it fits into the memory above
+ * MEMORY_PROGRAM_START.
+ *
+ * @param [in] path The path of the file.
+ * @return The content of the file or the reason it can't be used as a ROM.
+ */
+std::expected<std::vector<uint8_t>, RomError> read_rom (const std::string &path);
+
+/**
+ * Computes a FNV-1a hash of the bytes of a ROM.
+ *
+ * @param [in] rom The content of the ROM.
+ * @return The hash, which is the same for equal content no matter where it was read from.
+ */
+uint64_t rom_hash (std::span<const uint8_t> rom);
+
+/**
+ * @param [in] error The reason a ROM couldn't be loaded.
+ * @return A lowercase description of the reason, as it is written into messages.
+ */
+std::string to_string (RomError error);
+
+/**
+ * @brief Keeps the ROMs which have been read, so loading the same path again doesn't touch the
+ * filesystem. The images are stored by the hash of their content, thus equal ROMs under different
+ * paths share one image. Files are assumed not to change while the cache is used and failures are
+ * not remembered. It can be used from several threads at once.
+ */
+class RomCache {
+ public:
+  RomCache ();
+
+  /**
+   * Gives the image of a ROM, which is only read if the path hasn't been loaded before.
+   *
+   * @param [in] path The path of the file.
+   * @return The shared image or the reason the file can't be used as a ROM.
+   */
+  std::expected<RomImage, RomError> load (const std::string &path);
+
+  /**
+   * @return The amount of distinct images in the cache.
+   */
+  size_t images () const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, RomImage> paths_;
+  std::unordered_map<uint64_t, RomImage> images_;
+};
+
+#endif //_ROM_H_
@@ -0,0 +1,77 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <chrono>
+#include <cstdint>
+
+#include "chip8.h"
+#include "engine.h"
+
+#define TIMER_FREQUENCY 60
+
+/**
+ * @brief Drives a Chip-8 in emulated time. The instructions are executed at a fixed rate per
+ * second and the timers count down 60 times per emulated second, so changing the rate changes how
+ * much work the CPU can do per frame, but not how fast the game runs.
+ */
+class Scheduler {
+ public:
+  explicit Scheduler (uint64_t instructions_per_second);
+
+  /**
+   * Executes the given amount of instructions. Whenever a 60th of a second of emulated time has
+   * passed, the timers tick. The ticks happen after the same instructions no matter how the
+   * cycles are split across calls.
+   *
+   * @param [in] chip   The Chip-8 whose instructions will be executed.
+   * @param [in] engine The engine which executes the instructions.
+   * @param [in] cycles The amount of instructions to execute.
+   */
+  void run (Chip8 &chip, Engine &engine, uint64_t cycles);
+
+  /**
+   * Lets the given amount of host time pass in the emulation, by executing as many instructions
+   * as fit into it. Fractions of an instruction are carried over to the next call.
+   *
+   * @param [in] chip    The Chip-8 whose instructions will be executed.
+   * @param [in] engine  The engine which executes the instructions.
+   * @param [in] elapsed The time which has passed since the last call.
+   * @return The amount of executed instructions.
+   */
+  uint64_t advance (Chip8 &chip, Engine &engine, std::chrono::nanoseconds elapsed);
+
+  /**
+   * Tells how many instructions are left until the timers tick the next time, which is the
+   * length of one 60 Hz frame in instructions.
+   *
+   * @return The amount of instructions, which is at least 1.
+   */
+  uint64_t cycles_until_tick () const;
+
+  /**
+   * Tells after how many executed instructions the given tick happens. Tick k happens after
+   * ceil(k * instructions_per_second / 60) instructions.
+   *
+   * @param [in] instructions_per_second The rate of instructions per emulated second.
+   * @param [in] tick                    The number of the tick, starting at 1.
+   * @return The amount of instructions before the tick.
+   */
+  static uint64_t tick_cycle (uint64_t instructions_per_second, uint64_t tick);
+
+ private:
+  /**
+   * The amount of executed instructions after which the next tick happens (see tick_cycle).
+   */
+  uint64_t next_tick () const;
+
+  uint64_t instructions_per_second_;
+  uint64_t cycles_;
+  uint64_t ticks_;
+  std::chrono::nanoseconds time_;
+};
+
+#endif //_SCHEDULER_H_
@@ -0,0 +1,84 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _THREADED_H_
+#define _THREADED_H_
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "engine.h"
+
+#define SUPERBLOCK_MAX_INSTRUCTIONS 32
+
+/**
+ * @brief An engine which translates straight-line runs of instructions into superblocks. Every
+ * superblock is a list of already decoded instructions, each bound to the label of its handler,
+ * which are executed one after another using computed goto. A superblock ends with the first
+ * instruction that changes the control flow (jumps, calls, returns and skips) or writes memory.
+ */
+class ThreadedEngine : public Engine {
+ public:
+  ThreadedEngine ();
+
+  void run (Chip8 &chip, uint64_t cycles) override;
+
+ private:
+  /**
+   * @brief A single instruction of a superblock, together with the label of its handler.
+   */
+  struct Entry {
+    const void *label;
+    Instruction instruction;
+  };
+
+  /**
+   * @brief The translated instructions starting at one memory location. The versions of the first
+   * and the last page tell whether the superblock is still valid. A superblock that was cut off
+   * because of its length falls through to the following instruction.
+   */
+  struct Superblock {
+    uint16_t first_page, last_page;
+    uint32_t first_page_version, last_page_version;
+    bool falls_through;
+    std::vector<Entry> entries;
+  };
+
+  /**
+   * Executes superblocks until the cycles are used up or the machine waits for a key. It is
+   * instantiated for every quirk policy, so the labels of a policy lead straight to its handlers.
+   *
+   * @param [in] chip   The Chip-8 whose instructions will be executed.
+   * @param [in] cycles The amount of instructions to execute.
+   */
+  template<typename Quirks>
+  void execute (Chip8 &chip, uint64_t cycles);
+
+  /**
+   * Finds the superblock for the current program counter. It will be translated if it doesn't
+   * exist yet or if its memory has been written since.
+   *
+   * @param [in] chip   The Chip-8 whose instructions will be executed.
+   * @param [in] labels The labels of all handlers, indexed by Operation.
+   * @return The valid superblock starting at the program counter.
+   */
+  const Superblock &lookup (const Chip8 &chip, const void *const *labels);
+
+  /**
+   * Tells whether a superblock has to end after the given operation.
+   *
+   * @param [in] operation The operation of the last translated instruction.
+   * @return True if the operation changes the control flow or writes memory.
+   */
+  static bool ends_superblock (Operation operation);
+
+  // The machine the superblocks were translated for (see Chip8::generation_).
+  const Chip8 *chip_;
+  uint64_t generation_;
+  QuirkProfile quirks_;
+  std::array<std::unique_ptr<Superblock>, RAM_SIZE> superblocks_;
+};
+
+#endif //_THREADED_H_
@@ -0,0 +1,56 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "aot.h"
+
+AotEngine::AotEngine (const AotProgram &program) : program_ (program), chip_ (), generation_ (),
+                                                   page_versions_ () {}
+
+void AotEngine::run (Chip8 &chip, uint64_t cycles) {
+  // A new machine can be at the same address and have the same page versions as the previous one
+  // (see Chip8::generation_).
+  if (this->chip_ != &chip || this->generation_ != chip.generation_) {
+    // A version that has already been passed never matches again, so the page stays interpreted
+    // until its code is the same as in the ROM.
+    for (uint16_t page = 0; page < this->page_versions_.size (); page++) {
+      if (!this->revalidate (chip, page)) {
+        this->page_versions_[page] = chip.page_versions_[page] - 1;
+      }
+    }
+
+    this->chip_ = &chip;
+    this->generation_ = chip.generation_;
+  }
+
+  if (chip.quirks_ != this->program_.quirks) {
+    for (; cycles > 0 && !chip.waiting_for_key_; cycles--) {
+      chip.cycle ();
+    }
+
+    return;
+  }
+
+  while (cycles > 0 && !chip.waiting_for_key_) {
+    auto executed = this->program_.run (*this, chip, cycles);
+    if (executed == 0) {
+      chip.cycle ();
+      executed = 1;
+    }
+
+    cycles -= executed;
+  }
+}
+
+bool AotEngine::revalidate (const Chip8 &chip, uint16_t page) {
+  for (auto address = page * CODE_PAGE_SIZE; address < (page + 1) * CODE_PAGE_SIZE; address++) {
+    auto offset = (size_t)address - MEMORY_PROGRAM_START;
+    if (address >= MEMORY_PROGRAM_START && offset < this->program_.rom.size ()
+        && this->program_.code[offset] && chip.memory_[address] != this->program_.rom[offset]) {
+      return false;
+    }
+  }
+
+  this->page_versions_[page] = chip.page_versions_[page];
+  return true;
+}
@@ -0,0 +1,60 @@
+#include <fstream>
+#include <iostream>
+
+#include "cxxopts.hpp"
+
+#include <recompiler.h>
+#include <rom.h>
+
+auto main (int argc, char **argv) noexcept -> int {
+  cxxopts::Options options ("chip8_aot", "Translates a Chip-8 ROM into a C++ translation unit, "
+                                         "which runs the game natively together with AotEngine.");
+
+  options.add_options ()
+      ("i,input", "The file containing the Chip-8 instructions.", cxxopts::value<std::string> ())
+      ("o,output", "The C++ file to generate.", cxxopts::value<std::string> ())
+      ("quirks", "The variant of the Chip-8 the game is written for (default, vip, chip48 or "
+                 "schip).",
+       cxxopts::value<std::string> ()->default_value ("default"));
+
+  options.custom_help ("[options]");
+  options.parse_positional ({"input"});
+  options.positional_help ("<input>");
+
+  cxxopts::ParseResult result;
+  try {
+    result = options.parse (argc, argv);
+  }
+  catch (...) {
+    std::cout << options.help () << std::endl;
+    exit (0);
+  }
+
+  if (result.count ("help") || !result.count ("input") || !result.count ("output")) {
+    std::cout << options.help () << std::endl;
+    exit (0);
+  }
+
+  auto quirks = parse_quirk_profile (result["quirks"].as<std::string> ());
+  if (!quirks) {
+    std::cerr << "Unknown quirks " << result["quirks"].as<std::string> () << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto input_path = result["input"].as<std::string> ();
+  auto rom = read_rom (input_path);
+  if (!rom) {
+    std::cerr << "The ROM " << input_path << " " << to_string (rom.error ()) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto output_path = result["output"].as<std::string> ();
+  std::ofstream output (output_path);
+  output << translate_rom (*rom, input_path, *quirks);
+  if (!output) {
+    std::cerr << "Couldn't write " << output_path << std::endl;
+    exit (1);
+  }
+
+  return EXIT_SUCCESS;
+}
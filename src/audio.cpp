@@ -0,0 +1,160 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "audio.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "idle.h"
+
+// A chunk lasts this fraction of an emulated second, which bounds how much is replayed to find an
+// Fx18, but never fewer than IDLE_CHECK_INTERVAL instructions, so an IdleSkipper behind the
+// tracker still sees whole loops and translated code runs in long pieces.
+#define TONE_RESOLUTION 1000
+
+Beeper::Beeper (uint32_t sample_rate, uint32_t latency)
+    : changes_ (), waveform_ (), sample_rate_ (std::max (sample_rate, 1u)), latency_ (latency),
+      phase_ (0), phase_step_ (0), gain_ (0), on_ (false), position_ (0), offset_ (0),
+      synchronized_ (false) {
+  // A square wave made of its odd harmonics below the Nyquist frequency, so it doesn't alias.
+  std::array<double, 1 << BEEPER_WAVETABLE_BITS> wave{};
+  for (auto harmonic = 1u; harmonic * BEEPER_FREQUENCY < this->sample_rate_ / 2; harmonic += 2) {
+    for (auto index = 0u; index < wave.size (); index++) {
+      auto angle = 2.0 * std::numbers::pi * harmonic * index / wave.size ();
+      wave[index] += std::sin (angle) / harmonic;
+    }
+  }
+
+  auto magnitude = [] (double value) { return std::abs (value); };
+  auto peak = magnitude (std::ranges::max (wave, {}, magnitude));
+  for (auto index = 0u; index < wave.size (); index++) {
+    this->waveform_[index] = (int16_t)std::lround (wave[index] / peak * BEEPER_AMPLITUDE);
+  }
+
+  this->phase_step_ = (uint32_t)(((uint64_t)BEEPER_FREQUENCY << 32) / this->sample_rate_);
+}
+
+bool Beeper::set_tone (uint64_t time, bool on) {
+  return this->changes_.push ({time, on});
+}
+
+void Beeper::render (int16_t *samples, size_t count) {
+  size_t done = 0;
+  while (done < count) {
+    auto now = (int64_t)(this->position_ + done);
+    auto change = this->changes_.peek ();
+
+    auto end = count;
+    if (change) {
+      // A change which is already due or much too early means the emulated time jumped.
+      auto target = (int64_t)change->time + this->offset_;
+      if (!this->synchronized_ || target < now || target > now + this->latency_ + BEEPER_MAX_LEAD) {
+        this->offset_ = now + this->latency_ - (int64_t)change->time;
+        this->synchronized_ = true;
+        target = now + this->latency_;
+      }
+
+      if (target < (int64_t)(this->position_ + count)) {
+        end = (size_t)(target - (int64_t)this->position_);
+      } else {
+        change.reset ();
+      }
+    }
+
+    this->synthesize (samples + done, end - done);
+    done = end;
+
+    if (change) {
+      this->on_ = change->on;
+      this->changes_.pop ();
+    }
+  }
+
+  this->position_ += count;
+}
+
+uint32_t Beeper::sample_rate () const {
+  return this->sample_rate_;
+}
+
+void Beeper::synthesize (int16_t *samples, size_t count) {
+  if (!this->on_ && this->gain_ == 0) {
+    std::fill_n (samples, count, 0);
+    return;
+  }
+
+  for (size_t index = 0; index < count; index++) {
+    if (this->on_ && this->gain_ < BEEPER_RAMP_SAMPLES) {
+      this->gain_++;
+    } else if (!this->on_ && this->gain_ > 0) {
+      this->gain_--;
+    }
+
+    auto value = this->waveform_[this->phase_ >> (32 - BEEPER_WAVETABLE_BITS)];
+    samples[index] = (int16_t)(value * (int32_t)this->gain_ / BEEPER_RAMP_SAMPLES);
+    this->phase_ += this->phase_step_;
+  }
+}
+
+ToneTracker::ToneTracker (Engine &engine, Beeper &beeper, uint64_t instructions_per_second)
+    : engine_ (engine), beeper_ (beeper),
+      instructions_per_second_ (std::max (instructions_per_second, (uint64_t)1)),
+      chunk_ (std::max (instructions_per_second / TONE_RESOLUTION, (uint64_t)IDLE_CHECK_INTERVAL)),
+      cycles_ (0), on_ (false), before_ (), replay_ () {}
+
+void ToneTracker::run (Chip8 &chip, uint64_t cycles) {
+  // The timers ticked right before this run.
+  this->update (chip, this->cycles_);
+
+  while (cycles > 0) {
+    auto chunk = std::min (cycles, this->chunk_);
+    chip.save_state (this->before_);
+    this->engine_.run (chip, chunk);
+
+    this->update (chip, this->cycles_ + this->find_change (chip, chunk));
+    this->cycles_ += chunk;
+    cycles -= chunk;
+  }
+}
+
+void ToneTracker::silence () {
+  if (this->on_ && this->beeper_.set_tone (this->time (this->cycles_), false)) {
+    this->on_ = false;
+  }
+}
+
+uint64_t ToneTracker::find_change (const Chip8 &chip, uint64_t chunk) {
+  // A change that was still pending before the chunk is stamped at its end, like no change at all.
+  if (chip.beeping () == this->on_ || (this->before_.sound_timer > 0) != this->on_) {
+    return chunk;
+  }
+
+  // The chunk is executed again instruction by instruction, until the Fx18 changed the tone.
+  this->replay_.set_quirks (chip.quirks ());
+  this->replay_.load_state (this->before_);
+  for (uint64_t cycle = 1; cycle < chunk; cycle++) {
+    this->replay_.cycle ();
+    if (this->replay_.beeping () != this->on_) {
+      return cycle;
+    }
+  }
+
+  return chunk;
+}
+
+void ToneTracker::update (const Chip8 &chip, uint64_t cycles) {
+  // A change which doesn't fit into the ring is tried again after the next chunk.
+  if (chip.beeping () != this->on_ && this->beeper_.set_tone (this->time (cycles), !this->on_)) {
+    this->on_ = !this->on_;
+  }
+}
+
+uint64_t ToneTracker::time (uint64_t cycles) const {
+  // Split up, so the product doesn't overflow.
+  auto rate = this->beeper_.sample_rate ();
+  auto ips = this->instructions_per_second_;
+  return cycles / ips * rate + cycles % ips * rate / ips;
+}
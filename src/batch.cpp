@@ -0,0 +1,95 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "batch.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#include "idle.h"
+#include "pool.h"
+#include "rom.h"
+#include "scheduler.h"
+
+std::vector<std::string> collect_roms (const std::vector<std::string> &inputs) {
+  std::vector<std::string> paths;
+  for (const auto &input : inputs) {
+    std::error_code error;
+    if (!std::filesystem::is_directory (input, error)) {
+      paths.push_back (input);
+      continue;
+    }
+
+    std::vector<std::string> found;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator (input, error)) {
+      if (entry.is_regular_file () && entry.path ().extension () == ".ch8") {
+        found.push_back (entry.path ().string ());
+      }
+    }
+
+    std::ranges::sort (found);
+    paths.insert (paths.end (), found.begin (), found.end ());
+  }
+
+  return paths;
+}
+
+std::vector<BatchResult> run_batch (const std::vector<std::string> &paths,
+                                    const BatchOptions &options) {
+  std::vector<BatchResult> results (paths.size ());
+  RomCache roms;
+
+  WorkStealingPool pool (options.threads);
+  pool.run (paths.size (), [&] (size_t index) {
+    auto &result = results[index];
+    result.path = paths[index];
+
+    auto rom = roms.load (paths[index]);
+    if (!rom) {
+      result.exit = BatchExit::LoadFailed;
+      result.load_error = rom.error ();
+      return;
+    }
+
+    Chip8 chip;
+    chip.initialize ();
+    chip.set_quirks (options.quirks);
+    chip.load_game (**rom);
+
+    // Skipping idle loops leaves the machine exactly as executing them would, only faster.
+    auto engine = make_engine (options.engine);
+    IdleSkipper skipper (*engine);
+    Scheduler scheduler (options.instructions_per_second);
+    auto stats = run_headless (chip, skipper, scheduler, options.limits);
+
+    result.exit = chip.fault () ? BatchExit::Faulted : BatchExit::Completed;
+    result.cycles = stats.cycles;
+    result.frames = stats.frames;
+    result.display_hash = display_hash (chip);
+    result.fault = chip.fault ();
+  });
+
+  return results;
+}
+
+std::string to_string (BatchExit exit) {
+  switch (exit) {
+  case BatchExit::Completed: return "completed";
+  case BatchExit::Faulted: return "faulted";
+  default: return "load-failed";
+  }
+}
+
+std::string csv_quote (const std::string &field) {
+  std::string quoted = "\"";
+  for (auto character : field) {
+    if (character == '"') {
+      quoted += '"';
+    }
+
+    quoted += character;
+  }
+
+  return quoted + "\"";
+}
@@ -0,0 +1,106 @@
+#include <fstream>
+#include <iostream>
+
+#include "cxxopts.hpp"
+
+#include <batch.h>
+#include <engine.h>
+#include <rom.h>
+
+auto main (int argc, char **argv) noexcept -> int {
+  cxxopts::Options options ("Chip-8", "Runs many Chip-8 games headless in parallel and reports "
+                                      "the outcome of every game.");
+
+  options.add_options ()
+      ("roms", "ROMs or directories which are searched for .ch8 files.",
+       cxxopts::value<std::vector<std::string>> ())
+      ("ips", "Defines how many instructions are executed per second of emulated time.",
+       cxxopts::value<uint64_t> ()->default_value ("600"))
+      ("e,engine", "Selects how the instructions are executed (interpreter, threaded or jit).",
+       cxxopts::value<std::string> ()->default_value ("interpreter"))
+      ("quirks", "Selects the variant of the Chip-8 the games are written for (default, vip, "
+                 "chip48 or schip).", cxxopts::value<std::string> ()->default_value ("default"))
+      ("run-cycles", "Stops every run after this many cycles.",
+       cxxopts::value<uint64_t> ()->default_value ("0"))
+      ("run-frames", "Stops every run after this many frames.",
+       cxxopts::value<uint64_t> ()->default_value ("0"))
+      ("j,jobs", "The amount of threads, 0 uses one per hardware thread.",
+       cxxopts::value<size_t> ()->default_value ("0"))
+      ("o,output", "Writes the report into this file instead of the standard output.",
+       cxxopts::value<std::string> ());
+
+  options.custom_help ("[options]");
+  options.parse_positional ({"roms"});
+  options.positional_help ("<roms>...");
+
+  cxxopts::ParseResult result;
+  try {
+    result = options.parse (argc, argv);
+  }
+  catch (...) {
+    std::cout << options.help () << std::endl;
+    exit (0);
+  }
+
+  auto instructions_per_second = result["ips"].as<uint64_t> ();
+  auto run_cycles = result["run-cycles"].as<uint64_t> ();
+  auto run_frames = result["run-frames"].as<uint64_t> ();
+  if (result.count ("help") || !result.count ("roms") || (run_cycles == 0 && run_frames == 0)
+      || instructions_per_second == 0) {
+    std::cout << options.help () << std::endl;
+    exit (0);
+  }
+
+  auto engine_type = parse_engine_type (result["engine"].as<std::string> ());
+  if (!engine_type) {
+    std::cerr << "Unknown engine " << result["engine"].as<std::string> () << std::endl;
+    exit (1);
+  }
+
+  auto quirks = parse_quirk_profile (result["quirks"].as<std::string> ());
+  if (!quirks) {
+    std::cerr << "Unknown quirks " << result["quirks"].as<std::string> () << std::endl;
+    exit (1);
+  }
+
+  std::ofstream output_file;
+  if (result.count ("output")) {
+    output_file.open (result["output"].as<std::string> ());
+    if (!output_file.good ()) {
+      std::cerr << "Couldn't write " << result["output"].as<std::string> () << std::endl;
+      exit (1);
+    }
+  }
+
+  std::ostream &output = result.count ("output") ? output_file : std::cout;
+
+  auto paths = collect_roms (result["roms"].as<std::vector<std::string>> ());
+  auto results = run_batch (paths, {*engine_type, instructions_per_second,
+                                    {run_cycles, run_frames}, result["jobs"].as<size_t> (),
+                                    *quirks});
+
+  // One line per ROM, the fault columns are empty unless the game faulted.
+  output << "rom,exit,cycles,frames,display,fault_reason,fault_address,fault_opcode" << std::endl;
+  size_t failures = 0;
+  for (const auto &rom : results) {
+    output << csv_quote (rom.path) << "," << to_string (rom.exit) << "," << std::dec
+           << rom.cycles << "," << rom.frames << "," << std::hex << rom.display_hash << ",";
+    if (rom.fault) {
+      output << to_string (rom.fault->reason) << "," << rom.fault->address << ","
+             << rom.fault->opcode;
+    } else {
+      output << ",,";
+    }
+
+    output << std::dec << std::endl;
+    failures += rom.exit != BatchExit::Completed;
+
+    if (rom.load_error) {
+      std::cerr << "The ROM " << rom.path << " " << to_string (*rom.load_error) << std::endl;
+    }
+  }
+
+  std::cerr << results.size () << " ROMs, " << failures << " failed" << std::endl;
+
+  return EXIT_SUCCESS;
+}
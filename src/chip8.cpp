@@ -4,27 +4,139 @@
 
 #include "chip8.h"
 
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <fstream>
 
-Chip8::Chip8 () :
-    renderer_ (), window_ (), display_ (), draw_flag_ (), keypad_ (), memory_ (),
-    program_counter_ (), stack_ (), stack_pointer_ (), V_ (), delay_timer_ (),
-    sound_timer_ (), I_ () {}
+#include "rom.h"
+
+/**
+ * Hands out the generations of the machines (see Chip8::generation_), which are unique within the
+ * process.
+ */
+static uint64_t next_generation () {
+  static std::atomic<uint64_t> generation = 0;
+  return ++generation;
+}
+
+/**
+ * Maps every possible opcode to its operation, so the decoding is done once at compile time.
+ */
+static constexpr auto OPERATION_TABLE = [] {
+  std::array<Operation, 0x10000> table{};
+  for (auto opcode = 0u; opcode < table.size (); opcode++) {
+    table[opcode] = decode_operation ((uint16_t)opcode);
+  }
+
+  return table;
+} ();
+
+template<typename Quirks>
+const Chip8::HandlerTable Chip8::HANDLERS = {
+    [] (Chip8 &chip, const Instruction &instruction) {
+      chip.raise_fault (instruction.opcode, FaultReason::UnknownOpcode);
+    },
+    // 0nnn (SYS addr) jumps to a machine code routine, which is ignored by modern interpreters.
+    [] (Chip8 &, const Instruction &) {},
+    [] (Chip8 &chip, const Instruction &) { chip._00E0 (); },
+    [] (Chip8 &chip, const Instruction &) { chip._00EE (); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._1nnn (instruction.nnn); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._2nnn (instruction.nnn); },
+    [] (Chip8 &chip, const Instruction &instruction) {
+      chip._3xkk (instruction.x, instruction.kk);
+    },
+    [] (Chip8 &chip, const Instruction &instruction) {
+      chip._4xkk (instruction.x, instruction.kk);
+    },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._5xy0 (instruction.x, instruction.y); },
+    [] (Chip8 &chip, const Instruction &instruction) {
+      chip._6xkk (instruction.x, instruction.kk);
+    },
+    [] (Chip8 &chip, const Instruction &instruction) {
+      chip._7xkk (instruction.x, instruction.kk);
+    },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._8xy0 (instruction.x, instruction.y); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._8xy1 (instruction.x, instruction.y); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._8xy2 (instruction.x, instruction.y); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._8xy3 (instruction.x, instruction.y); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._8xy4 (instruction.x, instruction.y); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._8xy5 (instruction.x, instruction.y); },
+    [] (Chip8 &chip, const Instruction &instruction) {
+      chip._8xy6<Quirks> (instruction.x, instruction.y);
+    },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._8xy7 (instruction.x, instruction.y); },
+    [] (Chip8 &chip, const Instruction &instruction) {
+      chip._8xyE<Quirks> (instruction.x, instruction.y);
+    },
+    [] (Chip8 &chip, const Instruction &instruction) { chip._9xy0 (instruction.x, instruction.y); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Annn (instruction.nnn); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Bnnn<Quirks> (instruction.nnn); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Cxkk (instruction.x, instruction.kk); },
+    [] (Chip8 &chip, const Instruction &instruction) {
+      chip.Dxyn<Quirks> (instruction.x, instruction.y, instruction.n);
+    },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Ex9E (instruction.x); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.ExA1 (instruction.x); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Fx07 (instruction.x); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Fx0A (instruction.x); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Fx15 (instruction.x); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Fx18 (instruction.x); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Fx1E (instruction.x); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Fx29 (instruction.x); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Fx33 (instruction.x); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Fx55<Quirks> (instruction.x); },
+    [] (Chip8 &chip, const Instruction &instruction) { chip.Fx65<Quirks> (instruction.x); },
+};
+
+std::optional<QuirkProfile> parse_quirk_profile (const std::string &name) {
+  if (name == "default") {
+    return QuirkProfile::Default;
+  } else if (name == "vip") {
+    return QuirkProfile::CosmacVip;
+  } else if (name == "chip48") {
+    return QuirkProfile::Chip48;
+  } else if (name == "schip") {
+    return QuirkProfile::SuperChip;
+  }
 
-Chip8::~Chip8 () {
-  SDL_DestroyRenderer (this->renderer_);
-  SDL_DestroyWindow (this->window_);
-  SDL_Quit ();
+  return std::nullopt;
 }
 
+std::string to_string (FaultReason reason) {
+  switch (reason) {
+  case FaultReason::StackOverflow: return "stack overflow";
+  case FaultReason::StackUnderflow: return "stack underflow";
+  default: return "unknown opcode";
+  }
+}
+
+Chip8::Chip8 () :
+    display_ (), dirty_rows_ (), keypad_ (), waiting_for_key_ (), memory_ (), decoded_ (),
+    page_versions_ (), generation_ (next_generation ()),
+    handlers_ (&HANDLERS<DefaultQuirks>), quirks_ (QuirkProfile::Default), program_counter_ (),
+    stack_ (), stack_pointer_ (), V_ (), delay_timer_ (), sound_timer_ (), I_ (), random_state_ (),
+    fault_ ()
+#if CHIP8_COUNTERS
+    , counters_ ()
+#endif
+{}
+
+Chip8::~Chip8 () = default;
+
 void Chip8::initialize () {
+  this->generation_ = next_generation ();
   this->program_counter_ = MEMORY_PROGRAM_START;
   this->stack_pointer_ = 0;
   this->I_ = 0;
+  this->random_state_ = DEFAULT_RANDOM_SEED;
+  this->fault_.reset ();
+  this->waiting_for_key_ = false;
 
-  this->display_.fill (false);
+  this->display_.fill (0);
+  this->dirty_rows_ = ~0u;
   this->memory_.fill (0);
+  this->invalidate_code ();
   this->stack_.fill (0);
   this->V_.fill (0);
 
@@ -36,173 +148,291 @@ void Chip8::initialize () {
   }
 }
 
-void Chip8::load_game (const std::string &path) {
-  std::ifstream game_file (path, std::ios::in | std::ios::binary);
-  if (!game_file.good ()) {
-    std::cerr << "Couldn't open the file " << path << std::endl;
-    exit (1);
-  }
+void Chip8::seed_random (uint32_t seed) {
+  this->random_state_ = seed;
+}
 
-  for (size_t index = MEMORY_PROGRAM_START; game_file.good (); index++) {
-    this->memory_[index] = game_file.get ();
-  }
+void Chip8::set_quirks (QuirkProfile profile) {
+  this->handlers_ = with_quirks (profile, [] (auto quirks) {
+    return &HANDLERS<decltype (quirks)>;
+  });
+  this->quirks_ = profile;
+
+  // The cached handlers and translated code belong to the previous profile.
+  this->invalidate_code ();
 }
 
-void Chip8::initialize_display (uint8_t scaling_factor) {
-  if (SDL_Init (SDL_INIT_EVERYTHING) < 0) {
-    std::cerr << "SDL couldn't be initialized! SDL_Error: " << SDL_GetError () << std::endl;
-    exit (1);
-  }
+QuirkProfile Chip8::quirks () const {
+  return this->quirks_;
+}
 
-  this->window_ = SDL_CreateWindow ("CHIP-8",
-                                    SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                                    SCREEN_WIDTH * scaling_factor, SCREEN_HEIGHT * scaling_factor,
-                                    SDL_WINDOW_SHOWN);
-  if (this->window_ == nullptr) {
-    std::cerr << "Window couldn't be created! SDL_Error: " << SDL_GetError () << std::endl;
-    exit (1);
+std::expected<void, RomError> Chip8::load_game (const std::string &path) {
+  auto game = read_rom (path);
+  if (!game) {
+    return std::unexpected (game.error ());
   }
 
-  this->renderer_ = SDL_CreateRenderer (this->window_, -1, SDL_RENDERER_ACCELERATED);
-  SDL_RenderSetLogicalSize (this->renderer_,
-                            SCREEN_WIDTH * scaling_factor, SCREEN_HEIGHT * scaling_factor);
+  this->load_game (*game);
+  return {};
 }
 
-void Chip8::draw (uint8_t scaling_factor) {
-  SDL_SetRenderDrawColor (this->renderer_, 0, 0, 0, 255);
-  SDL_RenderClear (this->renderer_);
-
-  SDL_SetRenderDrawColor (this->renderer_, 255, 255, 255, 255);
+void Chip8::load_game (std::span<const uint8_t> game) {
+  auto size = std::min (game.size (), (size_t)(RAM_SIZE - MEMORY_PROGRAM_START));
+  std::copy_n (game.begin (), size, this->memory_.begin () + MEMORY_PROGRAM_START);
 
-  SDL_Rect scaled_pixel;
-  for (auto index = 0u; index < SCREEN_WIDTH * SCREEN_HEIGHT; index++) {
-    if (!this->display_[index]) {
-      continue;
-    }
+  this->invalidate_code ();
+}
 
-    auto pixel_x = (int)(index % SCREEN_WIDTH);
-    auto pixel_y = (int)(index / SCREEN_WIDTH);
+void Chip8::cycle () {
+  if (this->waiting_for_key_) {
+    return;
+  }
 
-    scaled_pixel.x = pixel_x * scaling_factor;
-    scaled_pixel.y = pixel_y * scaling_factor;
-    scaled_pixel.w = scaling_factor;
-    scaled_pixel.h = scaling_factor;
+  auto address = this->program_counter_;
+  this->program_counter_ += 2;
 
-    SDL_RenderFillRect (this->renderer_, &scaled_pixel);
-  }
+  // The cache has one entry per aligned pair of bytes, so the rare jump to an odd address is
+  // decoded every time instead.
+  if (address & 1) {
+    auto instruction = this->fetch (address);
 
-  SDL_RenderPresent (this->renderer_);
-}
+#if CHIP8_COUNTERS
+    this->counters_.operations[(size_t)OPERATION_TABLE[instruction.opcode]]++;
+    this->counters_.addresses[address & (RAM_SIZE - 1)]++;
+#endif
 
-void Chip8::cycle () {
-  uint16_t opcode = memory_[this->program_counter_] << 8 | memory_[this->program_counter_ + 1];
+    this->execute (instruction);
+  } else {
+    auto &cached = this->decoded_[(address & (RAM_SIZE - 1)) >> 1];
+    if (cached.handler == nullptr) {
+      cached.instruction = this->fetch (address);
+      cached.handler = (*this->handlers_)[(size_t)OPERATION_TABLE[cached.instruction.opcode]];
+    }
 
-  Instruction instruction{
-      opcode,
-      (uint16_t)(opcode & 0x0FFF),
-      (uint8_t)((opcode & 0x0F00) >> 8),
-      (uint8_t)((opcode & 0x00F0) >> 4),
-      (uint8_t)(opcode & 0x00FF),
-      (uint8_t)(opcode & 0x00F)
-  };
+#if CHIP8_COUNTERS
+    this->counters_.operations[(size_t)OPERATION_TABLE[cached.instruction.opcode]]++;
+    this->counters_.addresses[address & (RAM_SIZE - 1)]++;
+#endif
 
-  this->program_counter_ += 2;
-  this->execute (instruction);
+    cached.handler (*this, cached.instruction);
+  }
+}
 
+void Chip8::tick_timers () {
   if (this->delay_timer_ > 0) {
     this->delay_timer_--;
   }
 
+  // The tone stops once this reaches 0 (see beeping).
   if (this->sound_timer_ > 0) {
-    // TODO: Make a sound
     this->sound_timer_--;
   }
 }
 
-void Chip8::press_key (uint8_t keysym) {
-  auto found = KEY_MAP.find (keysym);
-  if (found == KEY_MAP.end ()) {
-    return;
+void Chip8::press_key (uint8_t key) {
+  this->keypad_[key & 0xF] = true;
+  this->waiting_for_key_ = false;
+}
+
+void Chip8::release_key (uint8_t key) {
+  this->keypad_[key & 0xF] = false;
+  this->waiting_for_key_ = false;
+}
+
+bool Chip8::waiting_for_key () const {
+  return this->waiting_for_key_;
+}
+
+bool Chip8::timers_running () const {
+  return this->delay_timer_ > 0 || this->sound_timer_ > 0;
+}
+
+bool Chip8::beeping () const {
+  return this->sound_timer_ > 0;
+}
+
+const std::optional<Fault> &Chip8::fault () const {
+  return this->fault_;
+}
+
+const std::array<DisplayRow, SCREEN_HEIGHT> &Chip8::display () const {
+  return this->display_;
+}
+
+void Chip8::execute (const Instruction &instruction) {
+  auto operation = OPERATION_TABLE[instruction.opcode];
+  (*this->handlers_)[(size_t)operation] (*this, instruction);
+}
+
+Instruction Chip8::fetch (uint16_t address) const {
+  auto high = this->memory_[address & (RAM_SIZE - 1)];
+  auto low = this->memory_[(address + 1) & (RAM_SIZE - 1)];
+
+  return Instruction::decode ((uint16_t)(high << 8 | low));
+}
+
+void Chip8::store (uint16_t address, uint8_t value) {
+  address &= RAM_SIZE - 1;
+
+  this->memory_[address] = value;
+  this->decoded_[address >> 1].handler = nullptr;
+  this->page_versions_[address / CODE_PAGE_SIZE]++;
+}
+
+void Chip8::invalidate_code () {
+  this->decoded_.fill ({});
+
+  for (auto &version : this->page_versions_) {
+    version++;
   }
+}
 
-  auto index = (size_t)std::distance (KEY_MAP.begin (), found);
-  this->keypad_[index] = true;
+void Chip8::raise_fault (uint16_t opcode, FaultReason reason) {
+  this->program_counter_ -= 2;
+  if (!this->fault_) {
+    this->fault_ = Fault{this->program_counter_, opcode, reason};
+  }
 }
 
-void Chip8::release_key (uint8_t keysym) {
-  auto found = KEY_MAP.find (keysym);
-  if (found == KEY_MAP.end ()) {
-    return;
+void Chip8::save_state (SaveState &state) const {
+  state.magic = SAVE_STATE_MAGIC;
+  state.version = SAVE_STATE_VERSION;
+  state.program_counter = this->program_counter_;
+  state.index_register = this->I_;
+  state.stack_pointer = this->stack_pointer_;
+  state.delay_timer = this->delay_timer_;
+  state.sound_timer = this->sound_timer_;
+  state.fault = this->fault_ ? (uint8_t)this->fault_->reason + 1 : 0;
+  state.fault_address = this->fault_ ? this->fault_->address : 0;
+  state.fault_opcode = this->fault_ ? this->fault_->opcode : 0;
+  state.random_state = this->random_state_;
+
+  state.keypad = 0;
+  for (auto key = 0u; key < KEYPAD_SIZE; key++) {
+    state.keypad |= (this->keypad_[key] != 0) << key;
   }
 
-  auto index = (size_t)std::distance (KEY_MAP.begin (), found);
-  this->keypad_[index] = false;
+  state.V = this->V_;
+  state.stack = this->stack_;
+  state.display = this->display_;
+  state.memory = this->memory_;
 }
 
-void Chip8::execute (const Instruction &instruction) {
-  const auto &[opcode, nnn, x, y, kk, n] = instruction;
-  switch (opcode >> 12) {
-  case 0x0: {
-    switch (instruction.opcode) {
-    case 0x00E0: return this->_00E0 ();
-    case 0x00EE: return this->_00EE ();
-    }
+bool Chip8::load_state (const SaveState &state) {
+  if (state.magic != SAVE_STATE_MAGIC || state.version != SAVE_STATE_VERSION
+      || state.stack_pointer > STACK_SIZE || state.fault > (uint8_t)FaultReason::Count) {
+    return false;
   }
-  case 0x1: return this->_1nnn (nnn);
-  case 0x2: return this->_2nnn (nnn);
-  case 0x3: return this->_3xkk (x, kk);
-  case 0x4: return this->_4xkk (x, kk);
-  case 0x5: return this->_5xy0 (x, y);
-  case 0x6: return this->_6xkk (x, kk);
-  case 0x7: return this->_7xkk (x, kk);
-  case 0x8: {
-    switch (opcode & 0x000F) {
-    case 0x0: return this->_8xy0 (x, y);
-    case 0x1: return this->_8xy1 (x, y);
-    case 0x2: return this->_8xy2 (x, y);
-    case 0x3: return this->_8xy3 (x, y);
-    case 0x4: return this->_8xy4 (x, y);
-    case 0x5: return this->_8xy5 (x, y);
-    case 0x6: return this->_8xy6 (x);
-    case 0x7: return this->_8xy7 (x, y);
-    case 0xE: return this->_8xyE (x);
-    }
+
+  this->program_counter_ = state.program_counter;
+  this->I_ = state.index_register & (RAM_SIZE - 1);
+  this->stack_pointer_ = state.stack_pointer;
+  this->delay_timer_ = state.delay_timer;
+  this->sound_timer_ = state.sound_timer;
+  this->random_state_ = state.random_state;
+  this->waiting_for_key_ = false;
+  this->fault_.reset ();
+  if (state.fault) {
+    this->fault_ = Fault{state.fault_address, state.fault_opcode, (FaultReason)(state.fault - 1)};
   }
-  case 0x9: return this->_9xy0 (x, y);
-  case 0xA: return this->Annn (nnn);
-  case 0xB: return this->Bnnn (nnn);
-  case 0xC: return this->Cxkk (x, kk);
-  case 0xD: return this->Dxyn (x, y, n);
-  case 0xE: {
-    switch (opcode & 0x00FF) {
-    case 0x9E: return this->Ex9E (x);
-    case 0xA1: return this->ExA1 (x);
-    }
+
+  for (auto key = 0u; key < KEYPAD_SIZE; key++) {
+    this->keypad_[key] = (state.keypad >> key) & 1;
   }
-  case 0xF: {
-    switch (opcode & 0x00FF) {
-    case 0x07: return this->Fx07 (x);
-    case 0x0A: return this->Fx0A (x);
-    case 0x15: return this->Fx15 (x);
-    case 0x18: return this->Fx18 (x);
-    case 0x1E: return this->Fx1E (x);
-    case 0x29: return this->Fx29 (x);
-    case 0x33: return this->Fx33 (x);
-    case 0x55: return this->Fx55 (x);
-    case 0x65: return this->Fx65 (x);
+
+  this->V_ = state.V;
+  this->stack_ = state.stack;
+
+  for (auto y = 0u; y < SCREEN_HEIGHT; y++) {
+    this->dirty_rows_ |= (uint32_t)(this->display_[y] != state.display[y]) << y;
+  }
+
+  this->display_ = state.display;
+
+  // Invalidating the whole memory would be the most expensive part, so only changed pages are.
+  for (auto page = 0u; page < RAM_SIZE / CODE_PAGE_SIZE; page++) {
+    auto *current = this->memory_.data () + page * CODE_PAGE_SIZE;
+    const auto *restored = state.memory.data () + page * CODE_PAGE_SIZE;
+    if (std::equal (restored, restored + CODE_PAGE_SIZE, current)) {
+      continue;
     }
+
+    std::copy_n (restored, CODE_PAGE_SIZE, current);
+    std::fill_n (this->decoded_.begin () + page * CODE_PAGE_SIZE / 2, CODE_PAGE_SIZE / 2,
+                 CachedInstruction{});
+    this->page_versions_[page]++;
   }
+
+  return true;
+}
+
+bool Chip8::save_state_file (const std::string &path) const {
+  SaveState state;
+  this->save_state (state);
+
+  std::ofstream file (path, std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write (reinterpret_cast<const char *> (&state), sizeof (state));
+  return file.good ();
+}
+
+bool Chip8::load_state_file (const std::string &path) {
+  SaveState state;
+  std::ifstream file (path, std::ios::in | std::ios::binary);
+  file.read (reinterpret_cast<char *> (&state), sizeof (state));
+  if (file.gcount () != sizeof (state) || file.peek () != std::ifstream::traits_type::eof ()) {
+    return false;
   }
 
-  std::cerr << "This instruction is not implemented! " << std::hex << (int)opcode << std::endl;
-  exit (1);
+  return this->load_state (state);
+}
+
+#if CHIP8_COUNTERS
+const ExecutionCounters &Chip8::counters () const {
+  return this->counters_;
+}
+#endif
+
+uint32_t Chip8::take_dirty_rows () {
+  auto dirty_rows = this->dirty_rows_;
+  this->dirty_rows_ = 0;
+  return dirty_rows;
+}
+
+uint32_t Chip8::page_version (uint16_t address) const {
+  return this->page_versions_[(address & (RAM_SIZE - 1)) / CODE_PAGE_SIZE];
+}
+
+bool Chip8::operator== (const Chip8 &other) const {
+  return this->display_ == other.display_
+         && this->keypad_ == other.keypad_
+         && this->memory_ == other.memory_
+         && this->program_counter_ == other.program_counter_
+         && this->stack_ == other.stack_
+         && this->stack_pointer_ == other.stack_pointer_
+         && this->V_ == other.V_
+         && this->delay_timer_ == other.delay_timer_
+         && this->sound_timer_ == other.sound_timer_
+         && this->I_ == other.I_
+         && this->random_state_ == other.random_state_
+         && this->fault_ == other.fault_;
 }
 
 void Chip8::_00E0 () {
-  this->display_.fill (false);
+  for (auto y = 0u; y < SCREEN_HEIGHT; y++) {
+    if (this->display_[y] != 0) {
+      this->dirty_rows_ |= 1u << y;
+    }
+  }
+
+  this->display_.fill (0);
 }
 
 void Chip8::_00EE () {
+  if (this->stack_pointer_ == 0) {
+    this->raise_fault (0x00EE, FaultReason::StackUnderflow);
+    return;
+  }
+
   auto return_address = this->stack_[--this->stack_pointer_];
   this->program_counter_ = return_address;
 }
@@ -212,6 +442,11 @@ void Chip8::_1nnn (uint16_t address) {
 }
 
 void Chip8::_2nnn (uint16_t address) {
+  if (this->stack_pointer_ == STACK_SIZE) {
+    this->raise_fault (0x2000 | address, FaultReason::StackOverflow);
+    return;
+  }
+
   auto return_address = this->program_counter_;
   this->stack_[this->stack_pointer_++] = return_address;
 
@@ -288,13 +523,19 @@ void Chip8::_8xy5 (uint8_t x_register, uint8_t y_register) {
   this->V_[x_register] -= y_value;
 }
 
-void Chip8::_8xy6 (uint8_t x_register) {
-  auto x_value = this->V_[x_register];
+template<typename Quirks>
+void Chip8::_8xy6 (uint8_t x_register, uint8_t y_register) {
+  auto value = this->V_[Quirks::SHIFT_READS_Y ? y_register : x_register];
 
-  uint8_t lsb_x = x_value & 0b1;
-  this->V_[0xF] = lsb_x;
+  uint8_t lsb = value & 0b1;
+  this->V_[0xF] = lsb;
 
-  this->V_[x_register] >>= 1;
+  // Shifting Vx in place reads it after the flag was written, which matters if x is 0xF.
+  if constexpr (Quirks::SHIFT_READS_Y) {
+    this->V_[x_register] = value >> 1;
+  } else {
+    this->V_[x_register] >>= 1;
+  }
 }
 
 void Chip8::_8xy7 (uint8_t x_register, uint8_t y_register) {
@@ -307,13 +548,18 @@ void Chip8::_8xy7 (uint8_t x_register, uint8_t y_register) {
   this->V_[x_register] = y_value - x_value;
 }
 
-void Chip8::_8xyE (uint8_t x_register) {
-  auto x_value = this->V_[x_register];
+template<typename Quirks>
+void Chip8::_8xyE (uint8_t x_register, uint8_t y_register) {
+  auto value = this->V_[Quirks::SHIFT_READS_Y ? y_register : x_register];
 
-  uint8_t msb_x = x_value >> 7;
-  this->V_[0xF] = msb_x;
+  uint8_t msb = value >> 7;
+  this->V_[0xF] = msb;
 
-  this->V_[x_register] <<= 1;
+  if constexpr (Quirks::SHIFT_READS_Y) {
+    this->V_[x_register] = value << 1;
+  } else {
+    this->V_[x_register] <<= 1;
+  }
 }
 
 void Chip8::_9xy0 (uint8_t x_register, uint8_t y_register) {
@@ -325,57 +571,74 @@ void Chip8::_9xy0 (uint8_t x_register, uint8_t y_register) {
 }
 
 void Chip8::Annn (uint16_t address) {
-  this->I_ = address;
+  this->I_ = address & (RAM_SIZE - 1);
 }
 
+template<typename Quirks>
 void Chip8::Bnnn (uint16_t address) {
-  auto V0_value = this->V_[0x0];
+  auto offset = this->V_[Quirks::JUMP_ADDS_X ? address >> 8 : 0x0];
 
-  this->program_counter_ = V0_value + address;
+  this->program_counter_ = offset + address;
 }
 
 void Chip8::Cxkk (uint8_t x_register, uint8_t constant) {
-  uint8_t random_number = std::rand () % 256;
+  // A linear congruential generator, whose upper bits are random enough for a single byte.
+  this->random_state_ = this->random_state_ * 1664525 + 1013904223;
+  uint8_t random_number = this->random_state_ >> 24;
   this->V_[x_register] = random_number & constant;
 }
 
+template<typename Quirks>
 void Chip8::Dxyn (uint8_t x_register, uint8_t y_register, uint8_t bytes) {
   this->V_[0xF] = 0;
 
-  auto x_value = this->V_[x_register];
-  auto y_value = this->V_[y_register];
+  auto x_value = this->V_[x_register] % SCREEN_WIDTH;
+  auto y_value = this->V_[y_register] % SCREEN_HEIGHT;
 
+  // Every byte of the sprite is moved to the left end of a row and shifted into place. Clipping
+  // drops the pixels leaving on the right, otherwise they are rotated back in on the left.
   for (auto sprite_index = 0u; sprite_index < bytes; sprite_index++) {
-    auto sprite = this->memory_[this->I_ + sprite_index];
-    for (auto bit_index = 0u; bit_index < 8; bit_index++) {
-      auto selected_bit = sprite & (0x80 >> bit_index);
-      if (selected_bit == 0) {
-        continue;
+    auto y = y_value + sprite_index;
+    if constexpr (Quirks::CLIP_SPRITES) {
+      if (y >= SCREEN_HEIGHT) {
+        break;
       }
+    } else {
+      y %= SCREEN_HEIGHT;
+    }
 
-      auto index = ((x_value + bit_index) + ((y_value + sprite_index) * SCREEN_WIDTH))
-                   % (SCREEN_WIDTH * SCREEN_HEIGHT);
-      if (this->display_[index]) {
-        this->V_[0xF] = 1;
-      }
+    auto sprite = this->memory_[(this->I_ + sprite_index) & (RAM_SIZE - 1)];
+    auto row = (DisplayRow)sprite << (SCREEN_WIDTH - 8);
+    auto pixels = Quirks::CLIP_SPRITES ? row >> x_value : std::rotr (row, x_value);
 
-      this->display_[index] ^= 1;
+    if (this->display_[y] & pixels) {
+      this->V_[0xF] = 1;
     }
+
+#if CHIP8_COUNTERS
+    this->counters_.pixels_drawn += std::popcount (pixels);
+#endif
+
+    // An empty byte of the sprite doesn't change the row.
+    this->display_[y] ^= pixels;
+    this->dirty_rows_ |= (uint32_t)(pixels != 0) << y;
   }
 
-  this->draw_flag_ = true;
+#if CHIP8_COUNTERS
+  this->counters_.collisions += this->V_[0xF];
+#endif
 }
 
 void Chip8::Ex9E (uint8_t x_register) {
   auto x_value = this->V_[x_register];
-  if (this->keypad_[x_value]) {
+  if (this->keypad_[x_value & 0xF]) {
     this->program_counter_ += 2;
   }
 }
 
 void Chip8::ExA1 (uint8_t x_register) {
   auto x_value = this->V_[x_register];
-  if (!this->keypad_[x_value]) {
+  if (!this->keypad_[x_value & 0xF]) {
     this->program_counter_ += 2;
   }
 }
@@ -396,6 +659,7 @@ void Chip8::Fx0A (uint8_t x_register) {
 
   if (found_key == -1) {
     this->program_counter_ -= 2;
+    this->waiting_for_key_ = true;
   } else {
     this->V_[x_register] = found_key;
   }
@@ -413,7 +677,7 @@ void Chip8::Fx18 (uint8_t x_register) {
 
 void Chip8::Fx1E (uint8_t x_register) {
   auto x_value = this->V_[x_register];
-  this->I_ += x_value;
+  this->I_ = (this->I_ + x_value) & (RAM_SIZE - 1);
 }
 
 void Chip8::Fx29 (uint8_t x_register) {
@@ -424,23 +688,52 @@ void Chip8::Fx29 (uint8_t x_register) {
 void Chip8::Fx33 (uint8_t x_register) {
   auto x_value = this->V_[x_register];
 
-  this->memory_[this->I_ + 0] = x_value / 100;
-  this->memory_[this->I_ + 1] = (x_value / 10) % 10;
-  this->memory_[this->I_ + 2] = x_value % 10;
+  this->store (this->I_ + 0, x_value / 100);
+  this->store (this->I_ + 1, (x_value / 10) % 10);
+  this->store (this->I_ + 2, x_value % 10);
 }
 
+template<typename Quirks>
 void Chip8::Fx55 (uint8_t x_register) {
   for (auto index = 0u; index <= x_register; index++) {
-    this->memory_[this->I_ + index] = this->V_[index];
+    this->store (this->I_ + index, this->V_[index]);
   }
 
-  this->I_ += x_register + 1;
+  this->increase_index<Quirks> (x_register);
 }
 
+template<typename Quirks>
 void Chip8::Fx65 (uint8_t x_register) {
   for (auto index = 0u; index <= x_register; index++) {
-    this->V_[index] = this->memory_[this->I_ + index];
+    this->V_[index] = this->memory_[(this->I_ + index) & (RAM_SIZE - 1)];
   }
 
-  this->I_ += x_register + 1;
+  this->increase_index<Quirks> (x_register);
+}
+
+template<typename Quirks>
+void Chip8::increase_index (uint8_t x_register) {
+  if constexpr (Quirks::INDEX == IndexQuirk::IncreaseByXPlusOne) {
+    this->I_ = (this->I_ + x_register + 1) & (RAM_SIZE - 1);
+  } else if constexpr (Quirks::INDEX == IndexQuirk::IncreaseByX) {
+    this->I_ = (this->I_ + x_register) & (RAM_SIZE - 1);
+  }
 }
+
+// Every policy gets its own dispatch table. The handlers are instantiated explicitly as well, so
+// the engines and tests can call them directly.
+#define INSTANTIATE_QUIRKS(Quirks)                                                              \
+  template const Chip8::HandlerTable Chip8::HANDLERS<Quirks>;                                   \
+  template void Chip8::_8xy6<Quirks> (uint8_t x_register, uint8_t y_register);                  \
+  template void Chip8::_8xyE<Quirks> (uint8_t x_register, uint8_t y_register);                  \
+  template void Chip8::Bnnn<Quirks> (uint16_t address);                                         \
+  template void Chip8::Dxyn<Quirks> (uint8_t x_register, uint8_t y_register, uint8_t bytes);    \
+  template void Chip8::Fx55<Quirks> (uint8_t x_register);                                       \
+  template void Chip8::Fx65<Quirks> (uint8_t x_register);
+
+INSTANTIATE_QUIRKS(DefaultQuirks)
+INSTANTIATE_QUIRKS(CosmacVipQuirks)
+INSTANTIATE_QUIRKS(Chip48Quirks)
+INSTANTIATE_QUIRKS(SuperChipQuirks)
+
+#undef INSTANTIATE_QUIRKS
@@ -0,0 +1,75 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "counters.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <vector>
+
+static constexpr const char *OPERATION_NAMES[] = {
+    "invalid",
+    "0nnn", "00E0", "00EE", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk", "7xkk",
+    "8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5", "8xy6", "8xy7", "8xyE", "9xy0",
+    "Annn", "Bnnn", "Cxkk", "Dxyn", "Ex9E", "ExA1",
+    "Fx07", "Fx0A", "Fx15", "Fx18", "Fx1E", "Fx29", "Fx33", "Fx55", "Fx65",
+};
+static_assert(std::size (OPERATION_NAMES) == (size_t)Operation::Count);
+
+const char *operation_name (Operation operation) {
+  return OPERATION_NAMES[(size_t)operation];
+}
+
+#if CHIP8_COUNTERS
+void write_counters (std::ostream &output, const ExecutionCounters &counters) {
+  auto flags = output.flags ();
+  auto total = std::accumulate (counters.operations.begin (), counters.operations.end (),
+                                (uint64_t)0);
+  auto share = [total] (uint64_t count) {
+    return total > 0 ? 100.0 * (double)count / (double)total : 0.0;
+  };
+
+  std::vector<size_t> operations (counters.operations.size ());
+  std::iota (operations.begin (), operations.end (), 0);
+  std::ranges::stable_sort (operations, [&] (size_t first, size_t second) {
+    return counters.operations[first] > counters.operations[second];
+  });
+
+  output << "cycles: " << total << std::endl << std::endl << "operations:" << std::endl;
+  for (auto operation : operations) {
+    auto count = counters.operations[operation];
+    if (count == 0) {
+      break;
+    }
+
+    output << "  " << std::setw (7) << std::left << operation_name ((Operation)operation)
+           << std::right << std::setw (14) << count << std::fixed << std::setprecision (2)
+           << std::setw (8) << share (count) << "%" << std::endl;
+  }
+
+  std::vector<uint16_t> addresses (counters.addresses.size ());
+  std::iota (addresses.begin (), addresses.end (), 0);
+  std::ranges::stable_sort (addresses, [&] (uint16_t first, uint16_t second) {
+    return counters.addresses[first] > counters.addresses[second];
+  });
+
+  output << std::endl << "hot addresses:" << std::endl;
+  for (auto index = 0u; index < COUNTERS_HOT_ADDRESSES; index++) {
+    auto count = counters.addresses[addresses[index]];
+    if (count == 0) {
+      break;
+    }
+
+    output << "  " << std::hex << std::setfill ('0') << std::setw (3) << addresses[index]
+           << std::dec << std::setfill (' ') << std::setw (18) << count << std::setw (8)
+           << share (count) << "%" << std::endl;
+  }
+
+  output << std::endl
+         << "pixels drawn: " << counters.pixels_drawn << std::endl
+         << "collisions:   " << counters.collisions << std::endl;
+  output.flags (flags);
+}
+#endif
@@ -0,0 +1,37 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "engine.h"
+
+#include "jit.h"
+#include "threaded.h"
+
+void InterpreterEngine::run (Chip8 &chip, uint64_t cycles) {
+  // The remaining cycles of a machine waiting for a key would do nothing.
+  for (auto index = 0ull; index < cycles && !chip.waiting_for_key (); index++) {
+    chip.cycle ();
+  }
+}
+
+std::unique_ptr<Engine> make_engine (EngineType type) {
+  switch (type) {
+  case EngineType::Interpreter: return std::make_unique<InterpreterEngine> ();
+  case EngineType::Threaded: return std::make_unique<ThreadedEngine> ();
+  case EngineType::Jit: return std::make_unique<JitEngine> ();
+  }
+
+  return nullptr;
+}
+
+std::optional<EngineType> parse_engine_type (const std::string &name) {
+  if (name == "interpreter") {
+    return EngineType::Interpreter;
+  } else if (name == "threaded") {
+    return EngineType::Threaded;
+  } else if (name == "jit") {
+    return EngineType::Jit;
+  }
+
+  return std::nullopt;
+}
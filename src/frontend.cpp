@@ -0,0 +1,121 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "frontend.h"
+
+#include <bit>
+#include <iostream>
+
+#include "pixels.h"
+
+Frontend::Frontend ()
+    : key_map_ (DEFAULT_KEY_MAP), renderer_ (), texture_ (), window_ (), audio_ (),
+      scaling_factor_ () {}
+
+Frontend::~Frontend () {
+  if (this->audio_ != 0) {
+    SDL_CloseAudioDevice (this->audio_);
+  }
+
+  SDL_DestroyTexture (this->texture_);
+  SDL_DestroyRenderer (this->renderer_);
+  SDL_DestroyWindow (this->window_);
+  SDL_Quit ();
+}
+
+void Frontend::initialize (uint8_t scaling_factor, bool vsync) {
+  this->scaling_factor_ = scaling_factor;
+
+  if (SDL_Init (SDL_INIT_EVERYTHING) < 0) {
+    std::cerr << "SDL couldn't be initialized! SDL_Error: " << SDL_GetError () << std::endl;
+    exit (1);
+  }
+
+  this->window_ = SDL_CreateWindow ("CHIP-8",
+                                    SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                    SCREEN_WIDTH * scaling_factor, SCREEN_HEIGHT * scaling_factor,
+                                    SDL_WINDOW_SHOWN);
+  if (this->window_ == nullptr) {
+    std::cerr << "Window couldn't be created! SDL_Error: " << SDL_GetError () << std::endl;
+    exit (1);
+  }
+
+  auto flags = SDL_RENDERER_ACCELERATED | (vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+  this->renderer_ = SDL_CreateRenderer (this->window_, -1, flags);
+  SDL_RenderSetLogicalSize (this->renderer_,
+                            SCREEN_WIDTH * scaling_factor, SCREEN_HEIGHT * scaling_factor);
+  SDL_SetRenderDrawColor (this->renderer_, 0, 0, 0, 255);
+
+  // Nearest neighbour scaling keeps the pixels sharp.
+  SDL_SetHint (SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+  this->texture_ = SDL_CreateTexture (this->renderer_, SDL_PIXELFORMAT_ARGB8888,
+                                      SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+  if (this->texture_ == nullptr) {
+    std::cerr << "Texture couldn't be created! SDL_Error: " << SDL_GetError () << std::endl;
+    exit (1);
+  }
+}
+
+void Frontend::draw (const Chip8 &chip, uint32_t dirty_rows) {
+  // A locked texture doesn't keep its old content, so every row between the first and the last
+  // changed one is written.
+  if (dirty_rows != 0) {
+    auto first_row = std::countr_zero (dirty_rows);
+    auto last_row = SCREEN_HEIGHT - 1 - std::countl_zero (dirty_rows);
+    SDL_Rect rows = {0, first_row, SCREEN_WIDTH, last_row - first_row + 1};
+
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture (this->texture_, &rows, &pixels, &pitch) == 0) {
+      convert_display (chip.display (), first_row, last_row, (uint32_t *)pixels, pitch);
+      SDL_UnlockTexture (this->texture_);
+    }
+  }
+
+  SDL_RenderClear (this->renderer_);
+  SDL_RenderCopy (this->renderer_, this->texture_, nullptr, nullptr);
+  SDL_RenderPresent (this->renderer_);
+}
+
+void Frontend::set_title (const std::string &title) {
+  SDL_SetWindowTitle (this->window_, title.c_str ());
+}
+
+bool Frontend::open_audio (Beeper &beeper) {
+  SDL_AudioSpec wanted{};
+  wanted.freq = (int)beeper.sample_rate ();
+  wanted.format = AUDIO_S16SYS;
+  wanted.channels = 1;
+  wanted.samples = AUDIO_BUFFER_SAMPLES;
+  wanted.userdata = &beeper;
+  wanted.callback = [] (void *userdata, Uint8 *stream, int length) {
+    static_cast<Beeper *> (userdata)->render ((int16_t *)stream, length / sizeof (int16_t));
+  };
+
+  // No changes are allowed, so SDL converts if the device works differently.
+  SDL_AudioSpec obtained;
+  this->audio_ = SDL_OpenAudioDevice (nullptr, 0, &wanted, &obtained, 0);
+  if (this->audio_ == 0) {
+    std::cerr << "Audio couldn't be opened! SDL_Error: " << SDL_GetError () << std::endl;
+    return false;
+  }
+
+  SDL_PauseAudioDevice (this->audio_, 0);
+  return true;
+}
+
+std::expected<void, std::string> Frontend::load_key_map (const std::string &path) {
+  return this->key_map_.load_file (path, [] (const std::string &name) -> std::optional<uint16_t> {
+    auto scancode = SDL_GetScancodeFromName (name.c_str ());
+    if (scancode == SDL_SCANCODE_UNKNOWN) {
+      return std::nullopt;
+    }
+
+    return (uint16_t)scancode;
+  });
+}
+
+std::optional<uint8_t> Frontend::map_key (const SDL_Keysym &keysym) const {
+  return this->key_map_.map (keysym.scancode);
+}
@@ -0,0 +1,56 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "headless.h"
+
+#include <algorithm>
+#include <chrono>
+
+HeadlessStats run_headless (Chip8 &chip, Engine &engine, Scheduler &scheduler,
+                            const HeadlessLimits &limits) {
+  HeadlessStats stats{};
+
+  auto start = std::chrono::steady_clock::now ();
+
+  auto running = true;
+  while (running) {
+    auto cycles = scheduler.cycles_until_tick ();
+    if (limits.max_cycles != 0) {
+      cycles = std::min (cycles, limits.max_cycles - stats.cycles);
+    }
+
+    scheduler.run (chip, engine, cycles);
+    stats.cycles += cycles;
+    stats.frames++;
+
+    if (limits.max_cycles != 0 && stats.cycles >= limits.max_cycles) {
+      running = false;
+    }
+
+    if (limits.max_frames != 0 && stats.frames >= limits.max_frames) {
+      running = false;
+    }
+
+    if (chip.fault ()) {
+      running = false;
+    }
+  }
+
+  auto end = std::chrono::steady_clock::now ();
+  stats.seconds = std::chrono::duration<double> (end - start).count ();
+
+  return stats;
+}
+
+uint64_t display_hash (const Chip8 &chip) {
+  uint64_t hash = 0xCBF29CE484222325;
+  for (auto row : chip.display ()) {
+    for (auto byte = 0; byte < 8; byte++) {
+      hash ^= (uint8_t)(row >> (byte * 8));
+      hash *= 0x100000001B3;
+    }
+  }
+
+  return hash;
+}
@@ -0,0 +1,102 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "idle.h"
+
+#include <algorithm>
+
+IdleSkipper::IdleSkipper (Engine &engine) : engine_ (engine), skipped_ (0) {}
+
+void IdleSkipper::run (Chip8 &chip, uint64_t cycles) {
+  while (cycles > 0) {
+    auto loop = find_loop (chip);
+    if (!loop) {
+      auto chunk = std::min (cycles, (uint64_t)IDLE_CHECK_INTERVAL);
+      this->engine_.run (chip, chunk);
+      cycles -= chunk;
+      continue;
+    }
+
+    // In the middle of the loop the rest of the iteration is executed, so it starts over.
+    auto program_counter = chip.program_counter_;
+    if (program_counter != loop->start) {
+      auto rest = (uint64_t)(loop->start + 2 * loop->length - program_counter) / 2;
+      rest = std::min (cycles, rest);
+      this->engine_.run (chip, rest);
+      cycles -= rest;
+      continue;
+    }
+
+    // Every complete iteration only repeats the result of the first one.
+    auto iterations = cycles / loop->length;
+    if (iterations > 0) {
+      auto opcode = chip.fetch (loop->start).opcode;
+      if ((opcode & 0xF0FF) == 0xF007) {
+        chip.V_[(opcode >> 8) & 0xF] = chip.delay_timer_;
+      } else if ((opcode & 0xF0FF) == 0xF00A && !chip.fault_) {
+        // A released key or a restored state clears the flag with the program counter still on
+        // the Fx0A, which would have set it again, so the frontend can sleep until the next key.
+        chip.waiting_for_key_ = true;
+      }
+
+      this->skipped_ += iterations * loop->length;
+      cycles -= iterations * loop->length;
+    }
+
+    // Less than one iteration is left, which is executed as usual.
+    this->engine_.run (chip, cycles);
+    cycles = 0;
+  }
+}
+
+uint64_t IdleSkipper::skipped () const {
+  return this->skipped_;
+}
+
+std::optional<IdleLoop> IdleSkipper::find_loop (const Chip8 &chip) {
+  auto program_counter = chip.program_counter_;
+  auto opcode = chip.fetch (program_counter).opcode;
+
+  // An unknown opcode halts the machine on itself.
+  if (chip.fault_ && chip.fault_->address == program_counter) {
+    return IdleLoop{program_counter, 1};
+  }
+
+  if (opcode == (0x1000 | program_counter)) {
+    return IdleLoop{program_counter, 1};
+  }
+
+  if ((opcode & 0xF0FF) == 0xF00A) {
+    auto pressed = std::ranges::any_of (chip.keypad_, [] (uint8_t key) { return key != 0; });
+    if (!pressed) {
+      return IdleLoop{program_counter, 1};
+    }
+
+    return std::nullopt;
+  }
+
+  // The program counter can be at any of the three instructions of a timer loop.
+  for (uint16_t offset = 0; offset <= 4 && offset <= program_counter; offset += 2) {
+    auto start = (uint16_t)(program_counter - offset);
+    auto read = chip.fetch (start).opcode;
+    auto skip = chip.fetch (start + 2).opcode;
+    auto jump = chip.fetch (start + 4).opcode;
+
+    auto x = (read >> 8) & 0xF;
+    if ((read & 0xF0FF) != 0xF007 || jump != (0x1000 | start) || ((skip >> 8) & 0xF) != x) {
+      continue;
+    }
+
+    // The skip compares the value Fx07 reads, so the loop only ends once the timer changes.
+    auto constant = skip & 0xFF;
+    auto taken = (skip & 0xF000) == 0x3000 ? chip.delay_timer_ == constant
+               : (skip & 0xF000) == 0x4000 ? chip.delay_timer_ != constant
+                                           : true;
+    if (!taken) {
+      return IdleLoop{start, 3};
+    }
+  }
+
+  return std::nullopt;
+}
@@ -0,0 +1,456 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "jit.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define JIT_SUPPORTED 1
+#include <sys/mman.h>
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+namespace {
+
+/**
+ * @brief Collects x86-64 machine code. Only the handful of instructions needed by the recompiler
+ * are supported. By convention rbx points to the Chip-8, r12d holds the amount of cycles that may
+ * still be executed and r13d holds register I.
+ */
+class Assembler {
+ public:
+  std::vector<uint8_t> code;
+
+  void bytes (std::initializer_list<uint8_t> values) {
+    for (auto value : values) {
+      this->code.push_back (value);
+    }
+  }
+
+  void imm16 (uint16_t value) {
+    this->bytes ({(uint8_t)value, (uint8_t)(value >> 8)});
+  }
+
+  void imm32 (uint32_t value) {
+    this->imm16 (value);
+    this->imm16 (value >> 16);
+  }
+
+  void imm64 (uint64_t value) {
+    this->imm32 (value);
+    this->imm32 (value >> 32);
+  }
+
+  /**
+   * Emits the opcode followed by a ModRM byte addressing [rbx + offset] and the displacement.
+   */
+  void rbx_relative (std::initializer_list<uint8_t> opcode, uint8_t modrm, int32_t offset) {
+    this->bytes (opcode);
+    this->bytes ({modrm});
+    this->imm32 (offset);
+  }
+
+  /**
+   * Emits a jump or call with a 32-bit displacement which is patched later.
+   *
+   * @return The position of the displacement.
+   */
+  size_t rel32 (std::initializer_list<uint8_t> opcode) {
+    this->bytes (opcode);
+    auto position = this->code.size ();
+    this->imm32 (0);
+    return position;
+  }
+
+  /**
+   * Lets the displacement at the given position point to the current end of the code.
+   */
+  void patch (size_t position) {
+    auto displacement = (uint32_t)(this->code.size () - (position + 4));
+    std::memcpy (&this->code[position], &displacement, sizeof (displacement));
+  }
+};
+
+}
+
+JitEngine::JitEngine () : chip_ (), generation_ (), quirks_ (), blocks_ (), buffer_ (),
+                          buffer_used_ () {
+#if JIT_SUPPORTED
+  auto *buffer = mmap (nullptr, JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffer != MAP_FAILED) {
+    this->buffer_ = (uint8_t *)buffer;
+  }
+#endif
+}
+
+JitEngine::~JitEngine () {
+#if JIT_SUPPORTED
+  if (this->buffer_ != nullptr) {
+    munmap (this->buffer_, JIT_CODE_BUFFER_SIZE);
+  }
+#endif
+}
+
+bool JitEngine::supported () {
+  return JIT_SUPPORTED;
+}
+
+void JitEngine::run (Chip8 &chip, uint64_t cycles) {
+  if (this->buffer_ == nullptr) {
+    for (; cycles > 0 && !chip.waiting_for_key_; cycles--) {
+      chip.cycle ();
+    }
+
+    return;
+  }
+
+  // The translated shifts depend on the profile the chip had at the time, and a new machine can
+  // have the same page versions as the previous one (see Chip8::generation_).
+  if (this->chip_ != &chip || this->generation_ != chip.generation_
+      || this->quirks_ != chip.quirks_) {
+    for (auto &block : this->blocks_) {
+      block.reset ();
+    }
+
+    this->flush ();
+    this->chip_ = &chip;
+    this->generation_ = chip.generation_;
+    this->quirks_ = chip.quirks_;
+  }
+
+  while (cycles > 0 && !chip.waiting_for_key_) {
+    const auto &block = this->lookup (chip);
+    if (block.code == nullptr) {
+      chip.cycle ();
+      cycles--;
+      continue;
+    }
+
+    auto start = chip.program_counter_;
+    auto executed = block.code (&chip, (uint32_t)std::min (cycles, (uint64_t)UINT32_MAX));
+
+    // The instruction ending a block already set the program counter.
+    if (executed < block.length || block.falls_through) {
+      chip.program_counter_ = start + 2 * executed;
+    }
+    cycles -= executed;
+  }
+}
+
+const JitEngine::Block &JitEngine::lookup (Chip8 &chip) {
+  // The interpreter takes care of instructions wrapping around the end of the memory.
+  static const Block INTERPRETED{};
+
+  auto start = chip.program_counter_;
+  if (start > RAM_SIZE - 2) {
+    return INTERPRETED;
+  }
+
+  auto &block = this->blocks_[start];
+  if (block == nullptr) {
+    block = std::make_unique<Block> ();
+    block->first_page = block->last_page = start / CODE_PAGE_SIZE;
+    block->first_page_version = block->last_page_version = chip.page_versions_[block->first_page];
+  }
+
+  if (chip.page_versions_[block->first_page] != block->first_page_version
+      || chip.page_versions_[block->last_page] != block->last_page_version) {
+    block->first_page = block->last_page = start / CODE_PAGE_SIZE;
+    block->first_page_version = block->last_page_version = chip.page_versions_[block->first_page];
+    block->executions = 0;
+    block->code = nullptr;
+  }
+
+  // Cold blocks are interpreted. A block that couldn't be compiled stays above the threshold, so
+  // the recompiler doesn't try again until its memory changes.
+  if (block->code == nullptr && block->executions <= JIT_HOT_THRESHOLD) {
+    if (++block->executions > JIT_HOT_THRESHOLD) {
+      this->compile (chip, start, *block);
+    }
+  }
+
+  return *block;
+}
+
+void JitEngine::compile (const Chip8 &chip, uint16_t start, Block &block) {
+  const auto *base = (const uint8_t *)&chip;
+  auto V = [&] (uint8_t index) { return (int32_t)((const uint8_t *)&chip.V_[index] - base); };
+  auto program_counter = (int32_t)((const uint8_t *)&chip.program_counter_ - base);
+  auto index_register = (int32_t)((const uint8_t *)&chip.I_ - base);
+
+  auto shift_reads_y = with_quirks (chip.quirks_, [] (auto quirks) {
+    return decltype (quirks)::SHIFT_READS_Y;
+  });
+
+  Assembler as;
+
+  // push rbx; push r12; push r13; mov rbx, rdi; mov r12d, esi; movzx r13d, word [rbx + I]
+  as.bytes ({0x53, 0x41, 0x54, 0x41, 0x55, 0x48, 0x89, 0xFB, 0x41, 0x89, 0xF4});
+  as.rbx_relative ({0x44, 0x0F, 0xB7}, 0xAB, index_register);
+
+  auto set_program_counter = [&] (uint16_t address) {
+    // mov word [rbx + PC], address
+    as.rbx_relative ({0x66, 0xC7}, 0x83, program_counter);
+    as.imm16 (address);
+  };
+
+  auto call_execute = [&] (uint16_t opcode) {
+    // mov [rbx + I], r13w; mov rdi, rbx; mov esi, opcode; mov rax, execute; call rax
+    as.rbx_relative ({0x66, 0x44, 0x89}, 0xAB, index_register);
+    as.bytes ({0x48, 0x89, 0xDF, 0xBE});
+    as.imm32 (opcode);
+    as.bytes ({0x48, 0xB8});
+    as.imm64 ((uint64_t)&JitEngine::execute);
+    as.bytes ({0xFF, 0xD0});
+    // movzx r13d, word [rbx + I]
+    as.rbx_relative ({0x44, 0x0F, 0xB7}, 0xAB, index_register);
+  };
+
+  auto skip_if = [&] (uint8_t cmov, uint16_t address) {
+    // mov eax, address + 2; mov ecx, address + 4; cmovcc eax, ecx; mov [rbx + PC], ax
+    as.bytes ({0xB8});
+    as.imm32 (address + 2);
+    as.bytes ({0xB9});
+    as.imm32 (address + 4);
+    as.bytes ({0x0F, cmov, 0xC1});
+    as.rbx_relative ({0x66, 0x89}, 0x83, program_counter);
+  };
+
+  std::vector<std::pair<size_t, uint32_t>> exits;
+
+  block.length = 0;
+  block.falls_through = true;
+
+  uint16_t address = start;
+  while (block.length < JIT_BLOCK_MAX_INSTRUCTIONS && address + 2 <= RAM_SIZE) {
+    auto instruction = chip.fetch (address);
+    auto operation = decode_operation (instruction.opcode);
+    const auto &[opcode, nnn, x, y, kk, n] = instruction;
+
+    // Invalid instructions are left to the interpreter, which reports them.
+    if (operation == Operation::Invalid) {
+      break;
+    }
+
+    // sub r12d, 1; jb exit
+    as.bytes ({0x41, 0x83, 0xEC, 0x01});
+    exits.emplace_back (as.rel32 ({0x0F, 0x82}), block.length);
+
+    auto ends_block = false;
+    switch (operation) {
+    case Operation::_0nnn: break;
+    case Operation::_1nnn: {
+      set_program_counter (nnn);
+      ends_block = true;
+      break;
+    }
+    case Operation::_00EE:
+    case Operation::_2nnn:
+    case Operation::Bnnn:
+    case Operation::Ex9E:
+    case Operation::ExA1:
+    case Operation::Fx0A:
+    case Operation::Fx33:
+    case Operation::Fx55: {
+      // These need the program counter or may change the code of this block.
+      set_program_counter (address + 2);
+      call_execute (opcode);
+      ends_block = true;
+      break;
+    }
+    case Operation::_3xkk:
+    case Operation::_4xkk: {
+      // cmp byte [rbx + Vx], kk
+      as.rbx_relative ({0x80}, 0xBB, V (x));
+      as.bytes ({kk});
+      skip_if (operation == Operation::_3xkk ? 0x44 : 0x45, address);
+      ends_block = true;
+      break;
+    }
+    case Operation::_5xy0:
+    case Operation::_9xy0: {
+      // mov al, [rbx + Vx]; cmp al, [rbx + Vy]
+      as.rbx_relative ({0x8A}, 0x83, V (x));
+      as.rbx_relative ({0x3A}, 0x83, V (y));
+      skip_if (operation == Operation::_5xy0 ? 0x44 : 0x45, address);
+      ends_block = true;
+      break;
+    }
+    case Operation::_6xkk: {
+      // mov byte [rbx + Vx], kk
+      as.rbx_relative ({0xC6}, 0x83, V (x));
+      as.bytes ({kk});
+      break;
+    }
+    case Operation::_7xkk: {
+      // add byte [rbx + Vx], kk
+      as.rbx_relative ({0x80}, 0x83, V (x));
+      as.bytes ({kk});
+      break;
+    }
+    case Operation::_8xy0:
+    case Operation::_8xy1:
+    case Operation::_8xy2:
+    case Operation::_8xy3: {
+      // mov al, [rbx + Vy]; mov/or/and/xor [rbx + Vx], al
+      static constexpr uint8_t OPCODES[] = {0x88, 0x08, 0x20, 0x30};
+      as.rbx_relative ({0x8A}, 0x83, V (y));
+      as.rbx_relative ({OPCODES[n]}, 0x83, V (x));
+      break;
+    }
+    case Operation::_8xy4:
+    case Operation::_8xy5: {
+      // The flag is written before the result, which is computed from the register x afterwards.
+      // mov dl, [rbx + Vy]; mov al, [rbx + Vx]; add/cmp al, dl; setc/setnc cl
+      as.rbx_relative ({0x8A}, 0x93, V (y));
+      as.rbx_relative ({0x8A}, 0x83, V (x));
+      if (operation == Operation::_8xy4) {
+        as.bytes ({0x00, 0xD0, 0x0F, 0x92, 0xC1});
+      } else {
+        as.bytes ({0x38, 0xD0, 0x0F, 0x93, 0xC1});
+      }
+      // mov [rbx + VF], cl; add/sub [rbx + Vx], dl
+      as.rbx_relative ({0x88}, 0x8B, V (0xF));
+      as.rbx_relative ({(uint8_t)(operation == Operation::_8xy4 ? 0x00 : 0x28)}, 0x93, V (x));
+      break;
+    }
+    case Operation::_8xy6:
+    case Operation::_8xyE: {
+      // mov al, [rbx + Vx or Vy]; mov cl, al; and cl, 1 or shr cl, 7; mov [rbx + VF], cl
+      as.rbx_relative ({0x8A}, 0x83, V (shift_reads_y ? y : x));
+      as.bytes ({0x88, 0xC1});
+      if (operation == Operation::_8xy6) {
+        as.bytes ({0x80, 0xE1, 0x01});
+      } else {
+        as.bytes ({0xC0, 0xE9, 0x07});
+      }
+      as.rbx_relative ({0x88}, 0x8B, V (0xF));
+      if (shift_reads_y) {
+        // shr/shl al, 1; mov [rbx + Vx], al
+        as.bytes ({0xD0, (uint8_t)(operation == Operation::_8xy6 ? 0xE8 : 0xE0)});
+        as.rbx_relative ({0x88}, 0x83, V (x));
+      } else {
+        // shr/shl byte [rbx + Vx], 1
+        as.rbx_relative ({0xD0}, operation == Operation::_8xy6 ? 0xAB : 0xA3, V (x));
+      }
+      break;
+    }
+    case Operation::_8xy7: {
+      // mov al, [rbx + Vy]; sub al, [rbx + Vx]; setnc cl; mov [rbx + VF], cl; mov [rbx + Vx], al
+      as.rbx_relative ({0x8A}, 0x83, V (y));
+      as.rbx_relative ({0x2A}, 0x83, V (x));
+      as.bytes ({0x0F, 0x93, 0xC1});
+      as.rbx_relative ({0x88}, 0x8B, V (0xF));
+      as.rbx_relative ({0x88}, 0x83, V (x));
+      break;
+    }
+    case Operation::Annn: {
+      // mov r13d, nnn
+      as.bytes ({0x41, 0xBD});
+      as.imm32 (nnn);
+      break;
+    }
+    case Operation::Fx1E: {
+      // movzx eax, byte [rbx + Vx]; add r13d, eax; and r13d, RAM_SIZE - 1
+      as.rbx_relative ({0x0F, 0xB6}, 0x83, V (x));
+      as.bytes ({0x41, 0x01, 0xC5, 0x41, 0x81, 0xE5});
+      as.imm32 (RAM_SIZE - 1);
+      break;
+    }
+    case Operation::Fx29: {
+      // movzx eax, byte [rbx + Vx]; lea r13d, [rax + rax * 4]
+      as.rbx_relative ({0x0F, 0xB6}, 0x83, V (x));
+      as.bytes ({0x44, 0x8D, 0x2C, 0x80});
+      break;
+    }
+    default: {
+      call_execute (opcode);
+      break;
+    }
+    }
+
+    block.length++;
+    address += 2;
+
+    if (ends_block) {
+      block.falls_through = false;
+      break;
+    }
+  }
+
+  block.first_page = start / CODE_PAGE_SIZE;
+  block.last_page = (address - 1) / CODE_PAGE_SIZE;
+  block.first_page_version = chip.page_versions_[block.first_page];
+  block.last_page_version = chip.page_versions_[block.last_page];
+
+  if (block.length == 0) {
+    block.code = nullptr;
+    return;
+  }
+
+  // mov eax, length
+  as.bytes ({0xB8});
+  as.imm32 (block.length);
+
+  // mov [rbx + I], r13w; pop r13; pop r12; pop rbx; ret
+  auto epilogue = as.code.size ();
+  as.rbx_relative ({0x66, 0x44, 0x89}, 0xAB, index_register);
+  as.bytes ({0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});
+
+  // Every exit returns the amount of instructions executed before running out of cycles.
+  for (const auto &[position, executed] : exits) {
+    as.patch (position);
+    // mov eax, executed; jmp epilogue
+    as.bytes ({0xB8});
+    as.imm32 (executed);
+    as.bytes ({0xE9});
+    as.imm32 ((uint32_t)(epilogue - (as.code.size () + 4)));
+  }
+
+  block.code = this->install (as.code);
+  if (block.code == nullptr) {
+    this->flush ();
+    block.code = this->install (as.code);
+  }
+}
+
+JitEngine::Code JitEngine::install (const std::vector<uint8_t> &code) {
+#if JIT_SUPPORTED
+  // Blocks are aligned to 16 bytes, which is what the host expects of branch targets.
+  auto offset = (this->buffer_used_ + 15) & ~(size_t)15;
+  if (offset + code.size () > JIT_CODE_BUFFER_SIZE) {
+    return nullptr;
+  }
+
+  // The buffer is never writable and executable at the same time.
+  mprotect (this->buffer_, JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE);
+  std::memcpy (this->buffer_ + offset, code.data (), code.size ());
+  mprotect (this->buffer_, JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_EXEC);
+
+  this->buffer_used_ = offset + code.size ();
+  return reinterpret_cast<Code> (this->buffer_ + offset);
+#else
+  (void)code;
+  return nullptr;
+#endif
+}
+
+void JitEngine::flush () {
+  for (auto &block : this->blocks_) {
+    if (block != nullptr) {
+      block->code = nullptr;
+      block->executions = 0;
+    }
+  }
+
+  this->buffer_used_ = 0;
+}
+
+void JitEngine::execute (Chip8 *chip, uint32_t opcode) {
+  chip->execute (Instruction::decode ((uint16_t)opcode));
+}
@@ -0,0 +1,62 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "keymap.h"
+
+#include <charconv>
+#include <fstream>
+
+std::expected<void, std::string> KeyMap::load (std::istream &input, const Resolver &resolve) {
+  auto changed = *this;
+  std::array<bool, KEYPAD_SIZE> replaced{};
+
+  std::string line;
+  for (auto number = 1; std::getline (input, line); number++) {
+    auto start = line.find_first_not_of (" \t\r");
+    if (start == std::string::npos || line[start] == '#') {
+      continue;
+    }
+
+    auto end = line.find_first_of (" \t", start);
+    auto name_start = end == std::string::npos ? end : line.find_first_not_of (" \t", end);
+    auto name_end = line.find_last_not_of (" \t\r");
+    if (name_start == std::string::npos || name_start > name_end) {
+      return std::unexpected ("line " + std::to_string (number) + ": expected a Chip-8 key and "
+                              "the name of a host key");
+    }
+
+    unsigned key;
+    auto digits = std::from_chars (line.data () + start, line.data () + end, key, 16);
+    if (digits.ec != std::errc () || digits.ptr != line.data () + end || key >= KEYPAD_SIZE) {
+      return std::unexpected ("line " + std::to_string (number) + ": "
+                              + line.substr (start, end - start) + " is no Chip-8 key");
+    }
+
+    auto name = line.substr (name_start, name_end - name_start + 1);
+    auto scancode = resolve (name);
+    if (!scancode || *scancode >= KEY_MAP_SCANCODES) {
+      return std::unexpected ("line " + std::to_string (number) + ": unknown key " + name);
+    }
+
+    if (!replaced[key]) {
+      changed.unbind ((uint8_t)key);
+      replaced[key] = true;
+    }
+
+    changed.bind (*scancode, (uint8_t)key);
+  }
+
+  *this = changed;
+  return {};
+}
+
+std::expected<void, std::string> KeyMap::load_file (const std::string &path,
+                                                    const Resolver &resolve) {
+  std::ifstream file (path);
+  if (!file.is_open ()) {
+    return std::unexpected ("couldn't open " + path);
+  }
+
+  return this->load (file, resolve);
+}
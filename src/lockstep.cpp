@@ -0,0 +1,515 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "lockstep.h"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define LOCKSTEP_AVX2 1
+#else
+#define LOCKSTEP_AVX2 0
+#endif
+
+#define ALL_REGISTERS 0xFFFF
+
+namespace {
+
+/**
+ * @brief Pointers to the arrays of all the lanes an instruction of a group works on.
+ */
+struct LaneRegisters {
+  uint8_t *Vx;
+  uint8_t *Vy;
+  uint8_t *VF;
+  uint8_t *delay_timer;
+  uint8_t *sound_timer;
+  const uint8_t *group;
+  uint8_t *skip;
+  size_t begin;
+  size_t end;
+};
+
+/**
+ * Tells whether an instruction only works on registers and timers, so it can be executed for a
+ * whole group at once.
+ */
+bool vectorizable (Operation operation) {
+  switch (operation) {
+  case Operation::_0nnn:
+  case Operation::_1nnn:
+  case Operation::_3xkk:
+  case Operation::_4xkk:
+  case Operation::_5xy0:
+  case Operation::_6xkk:
+  case Operation::_7xkk:
+  case Operation::_8xy0:
+  case Operation::_8xy1:
+  case Operation::_8xy2:
+  case Operation::_8xy3:
+  case Operation::_8xy4:
+  case Operation::_8xy5:
+  case Operation::_8xy6:
+  case Operation::_8xy7:
+  case Operation::_8xyE:
+  case Operation::_9xy0:
+  case Operation::Annn:
+  case Operation::Fx07:
+  case Operation::Fx15:
+  case Operation::Fx18:
+  case Operation::Fx1E:
+  case Operation::Fx29: return true;
+  default: return false;
+  }
+}
+
+bool skips (Operation operation) {
+  switch (operation) {
+  case Operation::_3xkk:
+  case Operation::_4xkk:
+  case Operation::_5xy0:
+  case Operation::_9xy0: return true;
+  default: return false;
+  }
+}
+
+/**
+ * Finds the V registers an instruction executed by the Chip8 class can read or write, so only
+ * those have to be copied.
+ *
+ * @return A mask where bit n stands for register Vn.
+ */
+uint16_t used_registers (Operation operation, const Instruction &instruction) {
+  if (operation == Operation::Fx55 || operation == Operation::Fx65) {
+    return (2 << instruction.x) - 1;
+  }
+
+  // V0 is read by Bnnn and VF is written by Dxyn.
+  return 1 << instruction.x | 1 << instruction.y | 1 << 0x0 | 1 << 0xF;
+}
+
+bool reads_keypad (Operation operation) {
+  return operation == Operation::Ex9E || operation == Operation::ExA1
+         || operation == Operation::Fx0A;
+}
+
+uint64_t page_bit (uint16_t address) {
+  return 1ull << ((address & (RAM_SIZE - 1)) / CODE_PAGE_SIZE);
+}
+
+#if LOCKSTEP_AVX2
+__attribute__ ((target ("avx2")))
+__m256i load (const uint8_t *source) {
+  return _mm256_loadu_si256 ((const __m256i *)source);
+}
+
+/**
+ * Only the lanes of the group are overwritten, the others keep their value.
+ */
+__attribute__ ((target ("avx2")))
+void store (uint8_t *destination, __m256i value, __m256i group) {
+  _mm256_storeu_si256 ((__m256i *)destination,
+                       _mm256_blendv_epi8 (load (destination), value, group));
+}
+
+/**
+ * Executes the part of an instruction which works on the byte registers and timers for 32 lanes
+ * at a time. The flag register is always written before Vx, just like in the Chip8 class. Skips
+ * only compute their condition.
+ */
+__attribute__ ((target ("avx2")))
+void execute_avx2 (Operation operation, const Instruction &instruction,
+                   const LaneRegisters &lanes) {
+  const auto kk = _mm256_set1_epi8 ((char)instruction.kk);
+  const auto zero = _mm256_setzero_si256 ();
+  const auto one = _mm256_set1_epi8 (1);
+  const auto all = _mm256_set1_epi8 ((char)0xFF);
+
+  // The Chip8 class updates Vx in place after writing the flag, so if x is 0xF the flag is the
+  // value which is added to, subtracted from or shifted.
+  const auto x_is_flag = instruction.x == 0xF;
+
+  for (auto lane = lanes.begin; lane < lanes.end; lane += LOCKSTEP_LANE_BLOCK) {
+    auto group = load (lanes.group + lane);
+    auto x = load (lanes.Vx + lane);
+    auto y = load (lanes.Vy + lane);
+
+    switch (operation) {
+    case Operation::_3xkk: {
+      _mm256_storeu_si256 ((__m256i *)(lanes.skip + lane), _mm256_cmpeq_epi8 (x, kk));
+      break;
+    }
+    case Operation::_4xkk: {
+      auto equal = _mm256_cmpeq_epi8 (x, kk);
+      _mm256_storeu_si256 ((__m256i *)(lanes.skip + lane), _mm256_xor_si256 (equal, all));
+      break;
+    }
+    case Operation::_5xy0: {
+      _mm256_storeu_si256 ((__m256i *)(lanes.skip + lane), _mm256_cmpeq_epi8 (x, y));
+      break;
+    }
+    case Operation::_9xy0: {
+      auto equal = _mm256_cmpeq_epi8 (x, y);
+      _mm256_storeu_si256 ((__m256i *)(lanes.skip + lane), _mm256_xor_si256 (equal, all));
+      break;
+    }
+    case Operation::_6xkk: store (lanes.Vx + lane, kk, group); break;
+    case Operation::_7xkk: store (lanes.Vx + lane, _mm256_add_epi8 (x, kk), group); break;
+    case Operation::_8xy0: store (lanes.Vx + lane, y, group); break;
+    case Operation::_8xy1: store (lanes.Vx + lane, _mm256_or_si256 (x, y), group); break;
+    case Operation::_8xy2: store (lanes.Vx + lane, _mm256_and_si256 (x, y), group); break;
+    case Operation::_8xy3: store (lanes.Vx + lane, _mm256_xor_si256 (x, y), group); break;
+    case Operation::_8xy4: {
+      // The sum overflowed if it differs from the saturated sum.
+      auto no_carry = _mm256_cmpeq_epi8 (_mm256_add_epi8 (x, y), _mm256_adds_epu8 (x, y));
+      auto flag = _mm256_andnot_si256 (no_carry, one);
+      store (lanes.VF + lane, flag, group);
+      store (lanes.Vx + lane, _mm256_add_epi8 (x_is_flag ? flag : x, y), group);
+      break;
+    }
+    case Operation::_8xy5: {
+      auto no_borrow = _mm256_cmpeq_epi8 (_mm256_subs_epu8 (y, x), zero);
+      auto flag = _mm256_and_si256 (no_borrow, one);
+      store (lanes.VF + lane, flag, group);
+      store (lanes.Vx + lane, _mm256_sub_epi8 (x_is_flag ? flag : x, y), group);
+      break;
+    }
+    case Operation::_8xy6: {
+      // There is no shift of bytes, so the bits moving in from the neighbouring byte are cleared.
+      auto flag = _mm256_and_si256 (x, one);
+      store (lanes.VF + lane, flag, group);
+      auto shifted = _mm256_srli_epi16 (x_is_flag ? flag : x, 1);
+      store (lanes.Vx + lane, _mm256_and_si256 (shifted, _mm256_set1_epi8 (0x7F)), group);
+      break;
+    }
+    case Operation::_8xy7: {
+      auto no_borrow = _mm256_cmpeq_epi8 (_mm256_subs_epu8 (x, y), zero);
+      store (lanes.VF + lane, _mm256_and_si256 (no_borrow, one), group);
+      store (lanes.Vx + lane, _mm256_sub_epi8 (y, x), group);
+      break;
+    }
+    case Operation::_8xyE: {
+      auto flag = _mm256_and_si256 (_mm256_srli_epi16 (x, 7), one);
+      store (lanes.VF + lane, flag, group);
+      auto shifted = x_is_flag ? flag : x;
+      store (lanes.Vx + lane, _mm256_add_epi8 (shifted, shifted), group);
+      break;
+    }
+    case Operation::Fx07: store (lanes.Vx + lane, load (lanes.delay_timer + lane), group); break;
+    case Operation::Fx15: store (lanes.delay_timer + lane, x, group); break;
+    case Operation::Fx18: store (lanes.sound_timer + lane, x, group); break;
+    default: break;
+    }
+  }
+}
+#endif
+
+}
+
+LockstepEngine::LockstepEngine (size_t lanes) : lanes_ (lanes), vectorized_ (),
+                                                shift_reads_y_ (),
+                                                game_ (std::make_unique<Chip8> ()), chips_ (lanes),
+                                                V_ (), I_ (), program_counter_ (), delay_timer_ (),
+                                                sound_timer_ (), keypad_ (), written_pages_ (),
+                                                written_pages_of_any_lane_ (),
+                                                group_ (), skip_ (), done_ () {
+#if LOCKSTEP_AVX2
+  this->vectorized_ = __builtin_cpu_supports ("avx2");
+#endif
+
+  // The arrays are padded to whole blocks. The padding lanes never take part in a group.
+  auto padded = (lanes + LOCKSTEP_LANE_BLOCK - 1) / LOCKSTEP_LANE_BLOCK * LOCKSTEP_LANE_BLOCK;
+  for (auto &registers : this->V_) {
+    registers.resize (padded);
+  }
+
+  this->I_.resize (padded);
+  this->program_counter_.resize (padded);
+  this->delay_timer_.resize (padded);
+  this->sound_timer_.resize (padded);
+  this->keypad_.resize (padded);
+  this->written_pages_.resize (padded);
+  this->group_.resize (padded);
+  this->skip_.resize (padded);
+  this->done_.resize (padded, 1);
+
+  this->load_game ({});
+}
+
+void LockstepEngine::load_game (std::span<const uint8_t> game, QuirkProfile quirks) {
+  this->game_->initialize ();
+  this->game_->set_quirks (quirks);
+  this->game_->load_game (game);
+  this->shift_reads_y_ = with_quirks (quirks, [] (auto policy) {
+    return decltype (policy)::SHIFT_READS_Y;
+  });
+
+  for (size_t lane = 0; lane < this->lanes_; lane++) {
+    this->chips_[lane] = *this->game_;
+    this->store_registers (lane, ALL_REGISTERS);
+    this->keypad_[lane] = 0;
+    this->written_pages_[lane] = 0;
+  }
+
+  this->written_pages_of_any_lane_ = 0;
+}
+
+void LockstepEngine::run (uint64_t cycles) {
+  for (uint64_t cycle = 0; cycle < cycles; cycle++) {
+    std::fill_n (this->done_.begin (), this->lanes_, 0);
+
+    size_t first = 0;
+    auto waiting = this->lanes_;
+    while (waiting > 0) {
+      while (this->done_[first]) {
+        first++;
+      }
+
+      auto instruction = this->fetch (first, this->program_counter_[first]);
+      auto members = this->find_group (first, instruction);
+
+      // Every group costs a pass over the lanes, so small groups aren't worth it.
+      if (members * LOCKSTEP_MIN_GROUP_SHARE < waiting) {
+        for (auto lane = first; lane < this->lanes_; lane++) {
+          if (!this->done_[lane]) {
+            auto next = this->fetch (lane, this->program_counter_[lane]);
+            auto operation = decode_operation (next.opcode);
+            this->step (lane, next, operation, used_registers (operation, next));
+          }
+        }
+
+        break;
+      }
+
+      if (!this->execute_group (first, instruction)) {
+        auto operation = decode_operation (instruction.opcode);
+        auto registers = used_registers (operation, instruction);
+        for (auto lane = first; lane < this->lanes_; lane++) {
+          if (this->group_[lane]) {
+            this->step (lane, instruction, operation, registers);
+          }
+        }
+      }
+
+      waiting -= members;
+      if (waiting > 0) {
+        for (auto lane = first; lane < this->lanes_; lane++) {
+          this->done_[lane] |= this->group_[lane] & 1;
+        }
+      }
+    }
+  }
+}
+
+void LockstepEngine::tick_timers () {
+  for (size_t lane = 0; lane < this->lanes_; lane++) {
+    this->delay_timer_[lane] -= this->delay_timer_[lane] > 0;
+    this->sound_timer_[lane] -= this->sound_timer_[lane] > 0;
+  }
+}
+
+void LockstepEngine::press_key (size_t lane, uint8_t key) {
+  this->keypad_[lane] |= 1 << (key & 0xF);
+}
+
+void LockstepEngine::release_key (size_t lane, uint8_t key) {
+  this->keypad_[lane] &= ~(1 << (key & 0xF));
+}
+
+void LockstepEngine::snapshot (size_t lane, Chip8 &chip) const {
+  chip = this->chips_[lane];
+  this->load_registers (lane, chip, ALL_REGISTERS, true);
+}
+
+const std::array<DisplayRow, SCREEN_HEIGHT> &LockstepEngine::display (size_t lane) const {
+  return this->chips_[lane].display ();
+}
+
+const std::optional<Fault> &LockstepEngine::fault (size_t lane) const {
+  return this->chips_[lane].fault ();
+}
+
+size_t LockstepEngine::lanes () const {
+  return this->lanes_;
+}
+
+bool LockstepEngine::vectorized () const {
+  return this->vectorized_;
+}
+
+size_t LockstepEngine::find_group (size_t first, const Instruction &instruction) {
+  auto address = this->program_counter_[first];
+  auto pages = page_bit (address) | page_bit (address + 1);
+
+  auto begin = first & ~(size_t)(LOCKSTEP_LANE_BLOCK - 1);
+  auto end = this->group_.size ();
+
+  // Kept free of branches, so the compiler vectorizes it.
+  const auto *program_counter = this->program_counter_.data ();
+  const auto *done = this->done_.data ();
+  auto *group = this->group_.data ();
+  size_t members = 0;
+  for (auto lane = begin; lane < end; lane++) {
+    uint8_t member = (program_counter[lane] == address) & (done[lane] ^ 1);
+    group[lane] = -member;
+    members += member;
+  }
+
+  if (!(this->written_pages_of_any_lane_ & pages)) {
+    return members;
+  }
+
+  // The first lane may have modified the instruction, then only lanes with the same
+  // modification stay in the group.
+  auto same_as_game = this->game_->fetch (address).opcode == instruction.opcode;
+  for (auto lane = begin; lane < end; lane++) {
+    if (group[lane]) {
+      auto member = (this->written_pages_[lane] & pages)
+                        ? this->chips_[lane].fetch (address).opcode == instruction.opcode
+                        : same_as_game;
+      group[lane] = member ? 0xFF : 0;
+      members -= !member;
+    }
+  }
+
+  return members;
+}
+
+bool LockstepEngine::execute_group (size_t first, const Instruction &instruction) {
+  auto operation = decode_operation (instruction.opcode);
+  if (!this->vectorized_ || !vectorizable (operation)) {
+    return false;
+  }
+
+  // The vectorized shifts work on Vx, the profiles shifting Vy are left to the Chip8 class.
+  auto shift = operation == Operation::_8xy6 || operation == Operation::_8xyE;
+  if (shift && this->shift_reads_y_) {
+    return false;
+  }
+
+  auto begin = first & ~(size_t)(LOCKSTEP_LANE_BLOCK - 1);
+  auto end = this->group_.size ();
+
+#if LOCKSTEP_AVX2
+  LaneRegisters lanes{
+      this->V_[instruction.x].data (), this->V_[instruction.y].data (), this->V_[0xF].data (),
+      this->delay_timer_.data (), this->sound_timer_.data (), this->group_.data (),
+      this->skip_.data (), begin, end
+  };
+  execute_avx2 (operation, instruction, lanes);
+#endif
+
+  // The 16-bit registers are updated in plain loops, which the compiler vectorizes as well.
+  const auto *group = this->group_.data ();
+  const auto *Vx = this->V_[instruction.x].data ();
+  auto *I = this->I_.data ();
+  auto *program_counter = this->program_counter_.data ();
+
+  switch (operation) {
+  case Operation::Annn: {
+    for (auto lane = begin; lane < end; lane++) {
+      I[lane] = group[lane] ? instruction.nnn & (RAM_SIZE - 1) : I[lane];
+    }
+    break;
+  }
+  case Operation::Fx1E: {
+    for (auto lane = begin; lane < end; lane++) {
+      I[lane] = group[lane] ? (I[lane] + Vx[lane]) & (RAM_SIZE - 1) : I[lane];
+    }
+    break;
+  }
+  case Operation::Fx29: {
+    for (auto lane = begin; lane < end; lane++) {
+      I[lane] = group[lane] ? Vx[lane] * 5 : I[lane];
+    }
+    break;
+  }
+  default: break;
+  }
+
+  if (operation == Operation::_1nnn) {
+    for (auto lane = begin; lane < end; lane++) {
+      program_counter[lane] = group[lane] ? instruction.nnn : program_counter[lane];
+    }
+  } else if (skips (operation)) {
+    const auto *skip = this->skip_.data ();
+    for (auto lane = begin; lane < end; lane++) {
+      program_counter[lane] += group[lane] & (2 + (skip[lane] & 2));
+    }
+  } else {
+    for (auto lane = begin; lane < end; lane++) {
+      program_counter[lane] += group[lane] & 2;
+    }
+  }
+
+  return true;
+}
+
+void LockstepEngine::step (size_t lane, const Instruction &instruction, Operation operation,
+                           uint16_t registers) {
+  auto &chip = this->chips_[lane];
+  this->load_registers (lane, chip, registers, reads_keypad (operation));
+
+  auto address = chip.I_;
+
+  // The same as Chip8::cycle, but the instruction is already decoded.
+  chip.program_counter_ += 2;
+  (*chip.handlers_)[(size_t)operation] (chip, instruction);
+
+  // Remembers which pages differ from the game, so their instructions are read from the lane.
+  if (operation == Operation::Fx33 || operation == Operation::Fx55) {
+    auto written = operation == Operation::Fx33 ? 3 : instruction.x + 1;
+    for (auto offset = 0; offset < written; offset++) {
+      this->written_pages_[lane] |= page_bit (address + offset);
+    }
+
+    this->written_pages_of_any_lane_ |= this->written_pages_[lane];
+  }
+
+  this->store_registers (lane, registers);
+}
+
+Instruction LockstepEngine::fetch (size_t lane, uint16_t address) const {
+  auto pages = page_bit (address) | page_bit (address + 1);
+  const auto &chip = (this->written_pages_[lane] & pages) ? this->chips_[lane] : *this->game_;
+
+  return chip.fetch (address);
+}
+
+void LockstepEngine::load_registers (size_t lane, Chip8 &chip, uint16_t registers,
+                                     bool keypad) const {
+  for (auto remaining = registers; remaining != 0; remaining &= remaining - 1) {
+    auto index = std::countr_zero (remaining);
+    chip.V_[index] = this->V_[index][lane];
+  }
+
+  chip.I_ = this->I_[lane];
+  chip.program_counter_ = this->program_counter_[lane];
+  chip.delay_timer_ = this->delay_timer_[lane];
+  chip.sound_timer_ = this->sound_timer_[lane];
+
+  // The keys of the lane may have changed since an Fx0A, so it is executed again.
+  if (keypad) {
+    for (auto key = 0u; key < KEYPAD_SIZE; key++) {
+      chip.keypad_[key] = (this->keypad_[lane] >> key) & 1;
+    }
+
+    chip.waiting_for_key_ = false;
+  }
+}
+
+void LockstepEngine::store_registers (size_t lane, uint16_t registers) {
+  const auto &chip = this->chips_[lane];
+  for (auto remaining = registers; remaining != 0; remaining &= remaining - 1) {
+    auto index = std::countr_zero (remaining);
+    this->V_[index][lane] = chip.V_[index];
+  }
+
+  this->I_[lane] = chip.I_;
+  this->program_counter_[lane] = chip.program_counter_;
+  this->delay_timer_[lane] = chip.delay_timer_;
+  this->sound_timer_[lane] = chip.sound_timer_;
+}
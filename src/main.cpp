@@ -1,8 +1,43 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <random>
 
 #include "cxxopts.hpp"
 
+#include <audio.h>
 #include <chip8.h>
+#include <counters.h>
+#include <engine.h>
+#include <frontend.h>
+#include <headless.h>
+#include <idle.h>
+#include <movie.h>
+#include <pacer.h>
+#include <profiler.h>
+#include <rewind.h>
+#include <rom.h>
+#include <scheduler.h>
+
+// The milliseconds the window sleeps at most while the game waits for a key.
+#define KEY_WAIT_TIMEOUT 250
+
+#if CHIP8_COUNTERS
+// Set by SIGUSR1, the window then reports the counters after the next frame.
+static volatile std::sig_atomic_t counters_requested = 0;
+#endif
+
+/**
+ * Writes the counters of the executed instructions to the error output, if they are compiled in.
+ */
+static void report_counters ([[maybe_unused]] const Chip8 &chip) {
+#if CHIP8_COUNTERS
+  write_counters (std::cerr, chip.counters ());
+#endif
+}
 
 auto main (int argc, char **argv) noexcept -> int {
   cxxopts::Options options ("Chip-8", "A quick Chip-8 implementation to test out emulator "
@@ -10,12 +45,48 @@ auto main (int argc, char **argv) noexcept -> int {
 
   options.add_options ()
       ("i,input", "The file containing the Chip-8 instructions.", cxxopts::value<std::string> ())
-      ("c,cycles", "Defines how many cycles you want to execute each frame.",
-       cxxopts::value<uint64_t> ()->default_value ("10"))
+      ("ips", "Defines how many instructions are executed per second of emulated time. The timers "
+              "always count down at 60 Hz.", cxxopts::value<uint64_t> ()->default_value ("600"))
       ("s,scale", "Sets the factor which the pixels will get scaled by.",
        cxxopts::value<uint64_t> ()->default_value ("20"))
       ("f,fps", "Sets the rate of frames per second.",
-       cxxopts::value<uint64_t> ()->default_value ("60"));
+       cxxopts::value<uint64_t> ()->default_value ("60"))
+      ("vsync", "Synchronizes presenting a frame with the refresh rate of the display.")
+      ("mute", "Doesn't play the tone of the sound timer.")
+      ("keys", "Remaps the keypad by this file, where every line is a Chip-8 key and the SDL name "
+               "of a host key, e.g. \"5 Up\".", cxxopts::value<std::string> ())
+      ("e,engine", "Selects how the instructions are executed (interpreter, threaded or jit).",
+       cxxopts::value<std::string> ()->default_value ("interpreter"))
+      ("quirks", "Selects the variant of the Chip-8 the game is written for (default, vip, chip48 "
+                 "or schip).", cxxopts::value<std::string> ()->default_value ("default"))
+      ("headless", "Runs the game without a window as fast as possible. Requires --run-cycles or "
+                   "--run-frames.")
+      ("run-cycles", "Stops the headless run after this many cycles.",
+       cxxopts::value<uint64_t> ()->default_value ("0"))
+      ("run-frames", "Stops the headless run after this many frames.",
+       cxxopts::value<uint64_t> ()->default_value ("0"))
+      ("state", "The file for the save state, F5 saves into it and F9 restores it. Defaults to the "
+                "input with .state appended.", cxxopts::value<std::string> ())
+      ("load-state", "Restores the save state before the game starts.")
+      ("save-state", "Writes the save state when the headless run has finished.")
+      ("seed", "The seed of the random numbers. Without it a window gets a random seed and a "
+               "headless run always the same one.", cxxopts::value<uint32_t> ())
+      ("record", "Records the keys into this movie, which is written when the window is closed.",
+       cxxopts::value<std::string> ())
+      ("hash-interval", "The frames between two hashes of the display in a recorded movie.",
+       cxxopts::value<uint32_t> ()->default_value ("60"))
+      ("replay", "Replays this movie without a window as fast as possible and checks that the "
+                 "display is the same as during the recording.", cxxopts::value<std::string> ())
+      ("profile", "Attributes every cycle to the subroutine it was executed in and writes the "
+                  "folded stacks for flamegraph tools into this file at exit. The instructions "
+                  "are interpreted one at a time then.", cxxopts::value<std::string> ())
+      ("no-idle-skip", "Executes the loops in which the game only waits for a timer or a key, "
+                       "instead of skipping them.")
+      ("rewind-memory", "The megabytes used to record the recent frames, which are played "
+                        "backwards while backspace is held. 0 disables rewinding.",
+       cxxopts::value<uint64_t> ()->default_value ("4"))
+      ("render-benchmark", "Draws this many frames as fast as possible and prints how long "
+                           "drawing took.", cxxopts::value<uint64_t> ()->default_value ("0"));
 
   options.custom_help ("[options]");
   options.parse_positional ({"input"});
@@ -37,18 +108,224 @@ auto main (int argc, char **argv) noexcept -> int {
 
   auto input_path = result["input"].as<std::string> ();
   auto scale_factor = result["scale"].as<uint64_t> ();
-  auto cycles = result["cycles"].as<uint64_t> ();
+  auto instructions_per_second = result["ips"].as<uint64_t> ();
   auto fps = result["fps"].as<uint64_t> ();
 
+  auto engine_type = parse_engine_type (result["engine"].as<std::string> ());
+  if (!engine_type) {
+    std::cerr << "Unknown engine " << result["engine"].as<std::string> () << std::endl;
+    exit (1);
+  }
+
+  auto quirks = parse_quirk_profile (result["quirks"].as<std::string> ());
+  if (!quirks) {
+    std::cerr << "Unknown quirks " << result["quirks"].as<std::string> () << std::endl;
+    exit (1);
+  }
+
+  auto engine = make_engine (*engine_type);
+
+  // The profiler executes the instructions itself, so it replaces the chosen engine. Idle loops
+  // aren't skipped then, so the profile shows how long the game waits.
+  std::optional<GuestProfiler> profiler;
+  std::optional<IdleSkipper> skipper;
+  if (result.count ("profile")) {
+    profiler.emplace ();
+  } else if (!result.count ("no-idle-skip")) {
+    skipper.emplace (*engine);
+  }
+
+  Engine &base_engine = profiler ? (Engine &)*profiler : skipper ? (Engine &)*skipper : *engine;
+  auto write_profile = [&] {
+    if (!profiler) {
+      return;
+    }
+
+    auto profile_path = result["profile"].as<std::string> ();
+    std::ofstream profile (profile_path, std::ios::out | std::ios::trunc);
+    profiler->write_folded (profile);
+    if (!profile.good ()) {
+      std::cerr << "Couldn't write the profile to " << profile_path << std::endl;
+    }
+  };
+
+  if (instructions_per_second == 0) {
+    std::cerr << "The instructions per second have to be greater than 0." << std::endl;
+    exit (1);
+  }
+
+  Scheduler scheduler (instructions_per_second);
+
   Chip8 chip;
   chip.initialize ();
-  chip.load_game (input_path);
-  chip.initialize_display (scale_factor);
+  chip.set_quirks (*quirks);
+  if (auto loaded = chip.load_game (input_path); !loaded) {
+    std::cerr << "The ROM " << input_path << " " << to_string (loaded.error ()) << std::endl;
+    return EXIT_FAILURE;
+  }
 
-  uint32_t start_ticks = SDL_GetTicks ();
+  auto seed = result.count ("seed") ? result["seed"].as<uint32_t> () : DEFAULT_RANDOM_SEED;
+  if (!result.count ("seed") && !result.count ("headless")) {
+    seed = std::random_device () ();
+  }
+
+  chip.seed_random (seed);
+
+  auto state_path = result.count ("state") ? result["state"].as<std::string> ()
+                                           : input_path + ".state";
+  if (result.count ("load-state") && !chip.load_state_file (state_path)) {
+    std::cerr << "Couldn't load the state from " << state_path << std::endl;
+    exit (1);
+  }
+
+  // A movie starts right after loading the game, so it can't be combined with a state.
+  if (result.count ("load-state") && (result.count ("record") || result.count ("replay"))) {
+    std::cerr << "A movie can't be recorded or replayed from a save state." << std::endl;
+    exit (1);
+  }
+
+  if (result.count ("replay")) {
+    auto movie_path = result["replay"].as<std::string> ();
+    Movie movie{};
+    if (!movie.load (movie_path)) {
+      std::cerr << "Couldn't load the movie from " << movie_path << std::endl;
+      exit (1);
+    }
+
+    auto replay = replay_movie (movie, chip, base_engine);
+    write_profile ();
+
+    std::cout << "cycles:  " << replay.cycles << std::endl
+              << "hashes:  " << replay.checked_hashes << std::endl
+              << "seconds: " << replay.seconds << std::endl
+              << "ips:     " << (uint64_t)(replay.cycles / replay.seconds) << std::endl
+              << "display: " << std::hex << display_hash (chip) << std::dec << std::endl;
+
+    if (!replay.game_matches) {
+      std::cerr << "The movie was recorded with another game." << std::endl;
+    } else if (replay.mismatch_frame) {
+      std::cerr << "The display differs from the recording at frame " << *replay.mismatch_frame
+                << "." << std::endl;
+    } else if (!replay.final_matches) {
+      std::cerr << "The display differs from the recording at the end." << std::endl;
+    }
+
+    return replay.matches () ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (result.count ("headless")) {
+    auto run_cycles = result["run-cycles"].as<uint64_t> ();
+    auto run_frames = result["run-frames"].as<uint64_t> ();
+    if (run_cycles == 0 && run_frames == 0) {
+      std::cerr << "A headless run requires --run-cycles or --run-frames." << std::endl;
+      exit (1);
+    }
+
+    auto stats = run_headless (chip, base_engine, scheduler, {run_cycles, run_frames});
+    std::cout << "cycles:  " << stats.cycles << std::endl
+              << "frames:  " << stats.frames << std::endl
+              << "seconds: " << stats.seconds << std::endl
+              << "ips:     " << (uint64_t)(stats.cycles / stats.seconds) << std::endl
+              << "display: " << std::hex << display_hash (chip) << std::dec << std::endl;
+
+    report_counters (chip);
+    write_profile ();
+
+    if (result.count ("save-state") && !chip.save_state_file (state_path)) {
+      std::cerr << "Couldn't save the state to " << state_path << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (chip.fault ()) {
+      std::cerr << "The game faulted with " << to_string (chip.fault ()->reason) << " on "
+                << std::hex << chip.fault ()->opcode << " at " << chip.fault ()->address
+                << std::dec << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+  }
+
+  // Declared first, so the audio device is closed before the beeper goes away.
+  Beeper beeper (AUDIO_SAMPLE_RATE, AUDIO_LATENCY);
+
+  Frontend frontend;
+  if (result.count ("keys")) {
+    auto loaded = frontend.load_key_map (result["keys"].as<std::string> ());
+    if (!loaded) {
+      std::cerr << "The keys couldn't be remapped, " << loaded.error () << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  frontend.initialize (scale_factor, result.count ("vsync"));
+
+  auto benchmark_frames = result["render-benchmark"].as<uint64_t> ();
+  if (benchmark_frames > 0) {
+    // Only drawing is measured, the game is still running so the texture changes every frame.
+    double total_ms = 0.0;
+    double slowest_ms = 0.0;
+    for (auto frame = 0ull; frame < benchmark_frames; frame++) {
+      scheduler.run (chip, base_engine, scheduler.cycles_until_tick ());
+
+      // Every frame is drawn in full to measure the worst case.
+      auto start = std::chrono::steady_clock::now ();
+      frontend.draw (chip, ~0u);
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now () - start;
+
+      total_ms += elapsed.count ();
+      slowest_ms = std::max (slowest_ms, elapsed.count ());
+    }
+
+    std::cout << "frames:      " << benchmark_frames << std::endl
+              << "resolution:  " << SCREEN_WIDTH * scale_factor << "x"
+              << SCREEN_HEIGHT * scale_factor << std::endl
+              << "average ms:  " << total_ms / benchmark_frames << std::endl
+              << "slowest ms:  " << slowest_ms << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  // While recording, the keys go through the recorder and the recorder is the engine.
+  std::optional<MovieRecorder> recorder;
+  if (result.count ("record")) {
+    recorder.emplace (chip, base_engine, instructions_per_second, seed,
+                      result["hash-interval"].as<uint32_t> ());
+  }
+
+  Engine &active_engine = recorder ? (Engine &)*recorder : base_engine;
+
+  // Without sound the changes of the tone aren't tracked at all.
+  auto audio = !result.count ("mute") && frontend.open_audio (beeper);
+  ToneTracker tones (active_engine, beeper, instructions_per_second);
+  Engine &frame_engine = audio ? (Engine &)tones : active_engine;
+  auto save_movie = [&] {
+    auto movie_path = result["record"].as<std::string> ();
+    if (!recorder->finish (chip).save (movie_path)) {
+      std::cerr << "Couldn't save the movie to " << movie_path << std::endl;
+    }
+  };
+
+#if CHIP8_COUNTERS && defined(SIGUSR1)
+  std::signal (SIGUSR1, [] (int) { counters_requested = 1; });
+#endif
+
+  FramePacer pacer (fps);
+  RewindBuffer rewind (result["rewind-memory"].as<uint64_t> () << 20);
 
   auto running = true;
+  auto rewinding = false;
+  auto window_changed = true;
+  uint64_t frames = 0;
   while (running) {
+    // A game waiting for a key with both timers stopped can't change before the next event, so
+    // the window sleeps until one arrives instead of stepping through empty frames.
+    if (!rewinding && chip.waiting_for_key () && !chip.timers_running ()) {
+      SDL_WaitEventTimeout (nullptr, KEY_WAIT_TIMEOUT);
+    }
+
+    // Sleeps until the next frame is due, if the host fell behind a few frames are caught up.
+    auto due_frames = pacer.wait ();
+
     SDL_Event event;
     while (SDL_PollEvent (&event)) {
       switch (event.type) {
@@ -57,28 +334,95 @@ auto main (int argc, char **argv) noexcept -> int {
         continue;
       }
       case SDL_KEYDOWN: {
-        chip.press_key (event.key.keysym.sym);
+        // Going back in time would make the recorded movie useless.
+        auto goes_back = event.key.keysym.sym == SDLK_BACKSPACE || event.key.keysym.sym == SDLK_F9;
+        if (recorder && goes_back) {
+          std::cerr << "Rewinding and loading states are disabled while recording." << std::endl;
+        } else if (event.key.keysym.sym == SDLK_BACKSPACE) {
+          rewinding = true;
+        } else if (event.key.keysym.sym == SDLK_F5 && !chip.save_state_file (state_path)) {
+          std::cerr << "Couldn't save the state to " << state_path << std::endl;
+        } else if (event.key.keysym.sym == SDLK_F9 && !chip.load_state_file (state_path)) {
+          std::cerr << "Couldn't load the state from " << state_path << std::endl;
+        }
+
+        auto key = frontend.map_key (event.key.keysym);
+        if (key && recorder) {
+          recorder->press_key (chip, *key);
+        } else if (key) {
+          chip.press_key (*key);
+        }
         break;
       }
       case SDL_KEYUP: {
-        chip.release_key (event.key.keysym.sym);
+        if (event.key.keysym.sym == SDLK_BACKSPACE) {
+          rewinding = false;
+        }
+
+        auto key = frontend.map_key (event.key.keysym);
+        if (key && recorder) {
+          recorder->release_key (chip, *key);
+        } else if (key) {
+          chip.release_key (*key);
+        }
+        break;
+      }
+      case SDL_WINDOWEVENT: {
+        window_changed = true;
         break;
       }
       default: break;
       }
     }
 
-    uint32_t end_ticks = SDL_GetTicks ();
-    double delta = end_ticks - start_ticks;
-    if (delta > 1000.0 / fps) {
-      start_ticks = end_ticks;
+    // While rewinding the game stands still and one recorded frame is undone per frame instead.
+    if (rewinding) {
+      tones.silence ();
+      rewind.rewind (chip);
+    } else {
+      scheduler.advance (chip, frame_engine, due_frames * pacer.period ());
+      if (chip.fault ()) {
+        std::cerr << "The game faulted with " << to_string (chip.fault ()->reason) << " on "
+                  << std::hex << chip.fault ()->opcode << " at " << chip.fault ()->address
+                  << std::dec << std::endl;
+        if (recorder) {
+          save_movie ();
+        }
 
-      for (auto index = 0u; index < cycles; index++) {
-        chip.cycle ();
+        report_counters (chip);
+        write_profile ();
+        return EXIT_FAILURE;
       }
 
-      chip.draw (scale_factor);
+      rewind.push (chip);
     }
+
+    // Nothing is presented as long as the display and the window stay the same.
+    auto dirty_rows = chip.take_dirty_rows ();
+    if (dirty_rows != 0 || window_changed) {
+      frontend.draw (chip, dirty_rows);
+      window_changed = false;
+    }
+
+#if CHIP8_COUNTERS
+    if (counters_requested) {
+      counters_requested = 0;
+      report_counters (chip);
+    }
+#endif
+
+    frames += due_frames;
+    if (frames >= fps) {
+      frames = 0;
+      frontend.set_title ("CHIP-8 (" + std::to_string ((int)(pacer.cpu_usage () * 100)) + "% CPU)");
+    }
+  }
+
+  report_counters (chip);
+  write_profile ();
+
+  if (recorder) {
+    save_movie ();
   }
 
   return EXIT_SUCCESS;
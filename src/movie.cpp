@@ -0,0 +1,241 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "movie.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <type_traits>
+
+#include "headless.h"
+#include "rom.h"
+#include "scheduler.h"
+
+/**
+ * @brief The fixed part at the start of a movie file, followed by the events (8 bytes cycle,
+ * 1 byte key, 1 byte pressed) and the hashes.
+ */
+struct MovieHeader {
+  uint32_t magic;
+  uint16_t version;
+  // Was reserved before, so older movies are played with QuirkProfile::Default.
+  uint16_t quirks;
+  uint32_t seed;
+  uint32_t hash_interval;
+  uint64_t instructions_per_second;
+  uint64_t game_hash;
+  uint64_t cycles;
+  uint64_t final_hash;
+  uint64_t event_count;
+  uint64_t hash_count;
+};
+static_assert(std::has_unique_object_representations_v<MovieHeader>);
+
+/**
+ * Computes a FNV-1a hash of the memory, which contains the game right after loading it.
+ */
+static uint64_t game_hash (const Chip8 &chip) {
+  SaveState state;
+  chip.save_state (state);
+  return rom_hash (state.memory);
+}
+
+bool Movie::save (const std::string &path) const {
+  MovieHeader header{MOVIE_MAGIC, MOVIE_VERSION, (uint16_t)this->quirks, this->seed,
+                     this->hash_interval, this->instructions_per_second, this->game_hash,
+                     this->cycles, this->final_hash, this->events.size (), this->hashes.size ()};
+
+  std::ofstream file (path, std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write (reinterpret_cast<const char *> (&header), sizeof (header));
+
+  for (const auto &event : this->events) {
+    uint8_t key_and_state[2] = {event.key, event.pressed};
+    file.write (reinterpret_cast<const char *> (&event.cycle), sizeof (event.cycle));
+    file.write (reinterpret_cast<const char *> (key_and_state), sizeof (key_and_state));
+  }
+
+  file.write (reinterpret_cast<const char *> (this->hashes.data ()),
+              (std::streamsize)(this->hashes.size () * sizeof (uint64_t)));
+  return file.good ();
+}
+
+bool Movie::load (const std::string &path) {
+  std::ifstream file (path, std::ios::in | std::ios::binary);
+
+  MovieHeader header;
+  file.read (reinterpret_cast<char *> (&header), sizeof (header));
+  if (!file.good () || header.magic != MOVIE_MAGIC || header.version != MOVIE_VERSION
+      || header.quirks >= (uint16_t)QuirkProfile::Count || header.hash_interval == 0) {
+    return false;
+  }
+
+  std::vector<MovieEvent> read_events;
+  for (auto index = 0ull; index < header.event_count && file.good (); index++) {
+    MovieEvent event{};
+    uint8_t key_and_state[2];
+    file.read (reinterpret_cast<char *> (&event.cycle), sizeof (event.cycle));
+    file.read (reinterpret_cast<char *> (key_and_state), sizeof (key_and_state));
+    event.key = key_and_state[0] % KEYPAD_SIZE;
+    event.pressed = key_and_state[1] != 0;
+    read_events.push_back (event);
+  }
+
+  std::vector<uint64_t> read_hashes;
+  for (auto index = 0ull; index < header.hash_count && file.good (); index++) {
+    uint64_t hash;
+    file.read (reinterpret_cast<char *> (&hash), sizeof (hash));
+    read_hashes.push_back (hash);
+  }
+
+  if (!file.good () || file.peek () != std::ifstream::traits_type::eof ()) {
+    return false;
+  }
+
+  this->seed = header.seed;
+  this->hash_interval = header.hash_interval;
+  this->instructions_per_second = header.instructions_per_second;
+  this->quirks = (QuirkProfile)header.quirks;
+  this->game_hash = header.game_hash;
+  this->cycles = header.cycles;
+  this->final_hash = header.final_hash;
+  this->events = std::move (read_events);
+  this->hashes = std::move (read_hashes);
+  return true;
+}
+
+MovieRecorder::MovieRecorder (Chip8 &chip, Engine &engine, uint64_t instructions_per_second,
+                              uint32_t seed, uint32_t hash_interval)
+    : engine_ (engine), movie_ (), cycles_ (0) {
+  chip.seed_random (seed);
+
+  this->movie_.seed = seed;
+  this->movie_.hash_interval = std::max (hash_interval, 1u);
+  this->movie_.instructions_per_second = instructions_per_second;
+  this->movie_.quirks = chip.quirks ();
+  this->movie_.game_hash = game_hash (chip);
+  this->next_hash_cycle_ = Scheduler::tick_cycle (instructions_per_second,
+                                                  this->movie_.hash_interval);
+}
+
+void MovieRecorder::run (Chip8 &chip, uint64_t cycles) {
+  while (cycles > 0) {
+    auto chunk = std::min (cycles, this->next_hash_cycle_ - this->cycles_);
+    this->engine_.run (chip, chunk);
+    this->cycles_ += chunk;
+    cycles -= chunk;
+
+    if (this->cycles_ == this->next_hash_cycle_) {
+      this->movie_.hashes.push_back (display_hash (chip));
+      auto frame = (this->movie_.hashes.size () + 1) * this->movie_.hash_interval;
+      this->next_hash_cycle_ = Scheduler::tick_cycle (this->movie_.instructions_per_second, frame);
+    }
+  }
+}
+
+void MovieRecorder::press_key (Chip8 &chip, uint8_t key) {
+  this->movie_.events.push_back ({this->cycles_, key, true});
+  chip.press_key (key);
+}
+
+void MovieRecorder::release_key (Chip8 &chip, uint8_t key) {
+  this->movie_.events.push_back ({this->cycles_, key, false});
+  chip.release_key (key);
+}
+
+const Movie &MovieRecorder::finish (const Chip8 &chip) {
+  this->movie_.cycles = this->cycles_;
+  this->movie_.final_hash = display_hash (chip);
+  return this->movie_;
+}
+
+/**
+ * @brief Plays the events of a movie back. Like the recorder it sits between the Scheduler and
+ * the real engine, and stops before every event and at every hash.
+ */
+class MoviePlayer : public Engine {
+ public:
+  MoviePlayer (const Movie &movie, Engine &engine, ReplayResult &result)
+      : movie_ (movie), engine_ (engine), result_ (result), cycles_ (0), next_event_ (0),
+        next_hash_cycle_ (Scheduler::tick_cycle (movie.instructions_per_second,
+                                                 movie.hash_interval)) {}
+
+  void run (Chip8 &chip, uint64_t cycles) override {
+    while (true) {
+      this->apply_events (chip);
+      if (cycles == 0) {
+        break;
+      }
+
+      auto chunk = std::min (cycles, this->next_hash_cycle_ - this->cycles_);
+      if (this->next_event_ < this->movie_.events.size ()) {
+        chunk = std::min (chunk, this->movie_.events[this->next_event_].cycle - this->cycles_);
+      }
+
+      this->engine_.run (chip, chunk);
+      this->cycles_ += chunk;
+      cycles -= chunk;
+
+      if (this->cycles_ == this->next_hash_cycle_) {
+        this->check_hash (chip);
+      }
+    }
+  }
+
+ private:
+  void apply_events (Chip8 &chip) {
+    while (this->next_event_ < this->movie_.events.size ()
+           && this->movie_.events[this->next_event_].cycle <= this->cycles_) {
+      const auto &event = this->movie_.events[this->next_event_++];
+      if (event.pressed) {
+        chip.press_key (event.key);
+      } else {
+        chip.release_key (event.key);
+      }
+    }
+  }
+
+  void check_hash (const Chip8 &chip) {
+    auto index = this->result_.checked_hashes++;
+    auto frame = (index + 1) * this->movie_.hash_interval;
+    if (index < this->movie_.hashes.size () && this->movie_.hashes[index] != display_hash (chip)
+        && !this->result_.mismatch_frame) {
+      this->result_.mismatch_frame = frame;
+    }
+
+    this->next_hash_cycle_ = Scheduler::tick_cycle (this->movie_.instructions_per_second,
+                                                    frame + this->movie_.hash_interval);
+  }
+
+  const Movie &movie_;
+  Engine &engine_;
+  ReplayResult &result_;
+  uint64_t cycles_;
+  size_t next_event_;
+  uint64_t next_hash_cycle_;
+};
+
+bool ReplayResult::matches () const {
+  return this->game_matches && !this->mismatch_frame && this->final_matches;
+}
+
+ReplayResult replay_movie (const Movie &movie, Chip8 &chip, Engine &engine) {
+  ReplayResult result{};
+  result.game_matches = game_hash (chip) == movie.game_hash;
+
+  auto start = std::chrono::steady_clock::now ();
+
+  chip.seed_random (movie.seed);
+  chip.set_quirks (movie.quirks);
+  Scheduler scheduler (movie.instructions_per_second);
+  MoviePlayer player (movie, engine, result);
+  scheduler.run (chip, player, movie.cycles);
+
+  auto end = std::chrono::steady_clock::now ();
+
+  result.cycles = movie.cycles;
+  result.final_matches = display_hash (chip) == movie.final_hash;
+  result.seconds = std::chrono::duration<double> (end - start).count ();
+  return result;
+}
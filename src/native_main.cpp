@@ -0,0 +1,71 @@
+#include <iostream>
+
+#include "cxxopts.hpp"
+
+#include <aot.h>
+#include <chip8.h>
+#include <headless.h>
+#include <scheduler.h>
+
+// Defined by the translation unit which chip8_aot generated for the ROM.
+extern const AotProgram AOT_PROGRAM;
+
+auto main (int argc, char **argv) noexcept -> int {
+  cxxopts::Options options ("Chip-8", "A Chip-8 game translated ahead of time, which runs "
+                                      "headless.");
+
+  options.add_options ()
+      ("ips", "Defines how many instructions are executed per second of emulated time.",
+       cxxopts::value<uint64_t> ()->default_value ("600"))
+      ("interpret", "Runs the game with the interpreter instead of the native code.")
+      ("run-cycles", "Stops the run after this many cycles.",
+       cxxopts::value<uint64_t> ()->default_value ("0"))
+      ("run-frames", "Stops the run after this many frames.",
+       cxxopts::value<uint64_t> ()->default_value ("0"));
+
+  options.custom_help ("[options]");
+
+  cxxopts::ParseResult result;
+  try {
+    result = options.parse (argc, argv);
+  }
+  catch (...) {
+    std::cout << options.help () << std::endl;
+    exit (0);
+  }
+
+  auto instructions_per_second = result["ips"].as<uint64_t> ();
+  auto run_cycles = result["run-cycles"].as<uint64_t> ();
+  auto run_frames = result["run-frames"].as<uint64_t> ();
+  if (result.count ("help") || (run_cycles == 0 && run_frames == 0)
+      || instructions_per_second == 0) {
+    std::cout << options.help () << std::endl;
+    exit (0);
+  }
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.set_quirks (AOT_PROGRAM.quirks);
+  chip.load_game (AOT_PROGRAM.rom);
+
+  AotEngine native (AOT_PROGRAM);
+  InterpreterEngine interpreter;
+  Engine &engine = result.count ("interpret") ? (Engine &)interpreter : (Engine &)native;
+
+  Scheduler scheduler (instructions_per_second);
+  auto stats = run_headless (chip, engine, scheduler, {run_cycles, run_frames});
+  std::cout << "cycles:  " << stats.cycles << std::endl
+            << "frames:  " << stats.frames << std::endl
+            << "seconds: " << stats.seconds << std::endl
+            << "ips:     " << (uint64_t)(stats.cycles / stats.seconds) << std::endl
+            << "display: " << std::hex << display_hash (chip) << std::dec << std::endl;
+
+  if (chip.fault ()) {
+    std::cerr << "The game faulted with " << to_string (chip.fault ()->reason) << " on "
+              << std::hex << chip.fault ()->opcode << " at " << chip.fault ()->address
+              << std::dec << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,53 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "pacer.h"
+
+#include <algorithm>
+#include <thread>
+
+FramePacer::FramePacer (uint64_t frames_per_second)
+    : period_ (std::chrono::duration_cast<Clock::duration> (
+          std::chrono::duration<double> (1.0 / (double)std::max (frames_per_second, (uint64_t)1)))),
+      deadline_ (Clock::now () + period_), usage_wall_time_ (Clock::now ()),
+      usage_processor_time_ (std::clock ()) {}
+
+uint32_t FramePacer::wait () {
+  std::this_thread::sleep_until (this->deadline_);
+
+  // Waking up late is normal, the next deadline is still on the grid.
+  return this->catch_up (std::max (Clock::now (), this->deadline_));
+}
+
+FramePacer::Clock::duration FramePacer::period () const {
+  return this->period_;
+}
+
+double FramePacer::cpu_usage () {
+  auto wall_time = Clock::now ();
+  auto processor_time = std::clock ();
+
+  auto wall_seconds = std::chrono::duration<double> (wall_time - this->usage_wall_time_).count ();
+  auto processor_seconds = (double)(processor_time - this->usage_processor_time_) / CLOCKS_PER_SEC;
+
+  this->usage_wall_time_ = wall_time;
+  this->usage_processor_time_ = processor_time;
+
+  return wall_seconds > 0.0 ? processor_seconds / wall_seconds : 0.0;
+}
+
+uint32_t FramePacer::catch_up (Clock::time_point now) {
+  uint32_t frames = 0;
+  while (this->deadline_ <= now && frames < PACER_MAX_CATCH_UP_FRAMES) {
+    this->deadline_ += this->period_;
+    frames++;
+  }
+
+  // The host is too far behind, so the remaining frames are dropped and a new grid starts.
+  if (this->deadline_ <= now) {
+    this->deadline_ = now + this->period_;
+  }
+
+  return frames;
+}
@@ -0,0 +1,19 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "pixels.h"
+
+void convert_display (const std::array<DisplayRow, SCREEN_HEIGHT> &display, uint32_t first_row,
+                      uint32_t last_row, uint32_t *pixels, size_t pitch) {
+  for (auto y = first_row; y <= last_row; y++) {
+    auto *line = (uint32_t *)((uint8_t *)pixels + (y - first_row) * pitch);
+    auto row = display[y];
+
+    // Branchless, so the compiler can vectorize the loop.
+    for (auto x = 0u; x < SCREEN_WIDTH; x++) {
+      auto bit = (uint32_t)(row >> (SCREEN_WIDTH - 1 - x)) & 1;
+      line[x] = PIXEL_OFF | ((PIXEL_ON ^ PIXEL_OFF) * bit);
+    }
+  }
+}
@@ -0,0 +1,65 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "pool.h"
+
+#include <algorithm>
+#include <thread>
+
+WorkStealingPool::WorkStealingPool (size_t threads) : queues_ () {
+  if (threads == 0) {
+    threads = std::max (std::thread::hardware_concurrency (), 1u);
+  }
+
+  for (size_t index = 0; index < threads; index++) {
+    this->queues_.push_back (std::make_unique<Queue> ());
+  }
+}
+
+void WorkStealingPool::run (size_t count, const std::function<void (size_t)> &job) {
+  for (size_t index = 0; index < count; index++) {
+    this->queues_[index % this->queues_.size ()]->jobs.push_back (index);
+  }
+
+  // The jthreads are joined when the vector goes out of scope.
+  std::vector<std::jthread> workers;
+  for (size_t worker = 0; worker < this->queues_.size (); worker++) {
+    workers.emplace_back ([this, worker, &job] {
+      size_t index;
+      while (this->take (worker, index)) {
+        job (index);
+      }
+    });
+  }
+}
+
+size_t WorkStealingPool::threads () const {
+  return this->queues_.size ();
+}
+
+bool WorkStealingPool::take (size_t worker, size_t &job) {
+  {
+    auto &own = *this->queues_[worker];
+    std::lock_guard lock (own.mutex);
+    if (!own.jobs.empty ()) {
+      job = own.jobs.back ();
+      own.jobs.pop_back ();
+      return true;
+    }
+  }
+
+  // No job is ever added while running, so a single pass over the others is enough to be sure
+  // that nothing is left.
+  for (size_t offset = 1; offset < this->queues_.size (); offset++) {
+    auto &victim = *this->queues_[(worker + offset) % this->queues_.size ()];
+    std::lock_guard lock (victim.mutex);
+    if (!victim.jobs.empty ()) {
+      job = victim.jobs.front ();
+      victim.jobs.pop_front ();
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,86 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+GuestProfiler::GuestProfiler () : nodes_ ({{0, MEMORY_PROGRAM_START, 0}}), children_ (),
+                                  calls_ ({0}) {}
+
+void GuestProfiler::run (Chip8 &chip, uint64_t cycles) {
+  for (uint64_t cycle = 0; cycle < cycles; cycle++) {
+    this->nodes_[this->calls_.back ()].cycles++;
+    chip.cycle ();
+
+    // The stack pointer tells how deep the game is, which also covers restored states. A broken
+    // stack pointer is clamped, so the profile stays consistent.
+    auto depth = (size_t)std::min (chip.stack_pointer_, (uint8_t)STACK_SIZE) + 1;
+    while (this->calls_.size () > depth) {
+      this->calls_.pop_back ();
+    }
+
+    while (this->calls_.size () < depth) {
+      this->calls_.push_back (this->child (this->calls_.back (), chip.program_counter_));
+    }
+  }
+}
+
+void GuestProfiler::write_folded (std::ostream &output) const {
+  std::vector<std::string> paths (this->nodes_.size ());
+  paths[0] = "main";
+
+  // A node is always created after its parent, so the path of the parent is already known.
+  for (size_t index = 1; index < this->nodes_.size (); index++) {
+    const auto &node = this->nodes_[index];
+
+    char name[8];
+    std::snprintf (name, sizeof (name), "0x%03X", node.address);
+    paths[index] = paths[node.parent] + ";" + name;
+  }
+
+  for (size_t index = 0; index < this->nodes_.size (); index++) {
+    if (this->nodes_[index].cycles > 0) {
+      output << paths[index] << " " << this->nodes_[index].cycles << "\n";
+    }
+  }
+
+  output.flush ();
+}
+
+uint64_t GuestProfiler::inclusive_cycles (uint16_t address) const {
+  uint64_t cycles = 0;
+  for (size_t index = 1; index < this->nodes_.size (); index++) {
+    // Every cycle is counted once, even if the subroutine appears several times on the path.
+    for (auto current = (uint32_t)index; current != 0; current = this->nodes_[current].parent) {
+      if (this->nodes_[current].address == address) {
+        cycles += this->nodes_[index].cycles;
+        break;
+      }
+    }
+  }
+
+  return cycles;
+}
+
+uint64_t GuestProfiler::total_cycles () const {
+  uint64_t cycles = 0;
+  for (const auto &node : this->nodes_) {
+    cycles += node.cycles;
+  }
+
+  return cycles;
+}
+
+uint32_t GuestProfiler::child (uint32_t parent, uint16_t address) {
+  auto key = ((uint64_t)parent << 16) | address;
+  auto [entry, inserted] = this->children_.try_emplace (key, (uint32_t)this->nodes_.size ());
+  if (inserted) {
+    this->nodes_.push_back ({parent, address, 0});
+  }
+
+  return entry->second;
+}
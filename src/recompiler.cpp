@@ -0,0 +1,375 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "recompiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+/**
+ * Tells whether a whole instruction at the given location is part of the ROM.
+ */
+bool inside_rom (std::span<const uint8_t> rom, uint32_t address) {
+  return address >= MEMORY_PROGRAM_START && address + 2 <= MEMORY_PROGRAM_START + rom.size ()
+         && address + 2 <= RAM_SIZE;
+}
+
+Instruction fetch (std::span<const uint8_t> rom, uint16_t address) {
+  auto offset = address - MEMORY_PROGRAM_START;
+  return Instruction::decode ((uint16_t)(rom[offset] << 8 | rom[offset + 1]));
+}
+
+/**
+ * Tells whether a basic block has to end after the given operation, because it changes the
+ * control flow or writes into the memory.
+ */
+bool ends_block (Operation operation) {
+  switch (operation) {
+  case Operation::Invalid:
+  case Operation::_00EE:
+  case Operation::_1nnn:
+  case Operation::_2nnn:
+  case Operation::_3xkk:
+  case Operation::_4xkk:
+  case Operation::_5xy0:
+  case Operation::_9xy0:
+  case Operation::Bnnn:
+  case Operation::Ex9E:
+  case Operation::ExA1:
+  case Operation::Fx0A:
+  case Operation::Fx33:
+  case Operation::Fx55: return true;
+  default: return false;
+  }
+}
+
+std::string hex (uint32_t value, int digits) {
+  std::ostringstream stream;
+  stream << "0x" << std::uppercase << std::hex << std::setw (digits) << std::setfill ('0') << value;
+  return stream.str ();
+}
+
+std::string label (uint16_t address) {
+  std::ostringstream stream;
+  stream << "block_" << std::hex << std::setw (3) << std::setfill ('0') << address;
+  return stream.str ();
+}
+
+/**
+ * Returns the enumerator of the profile as it is written into the generated code.
+ */
+std::string profile_enumerator (QuirkProfile quirks) {
+  switch (quirks) {
+  case QuirkProfile::CosmacVip: return "QuirkProfile::CosmacVip";
+  case QuirkProfile::Chip48: return "QuirkProfile::Chip48";
+  case QuirkProfile::SuperChip: return "QuirkProfile::SuperChip";
+  default: return "QuirkProfile::Default";
+  }
+}
+
+/**
+ * Returns the native code for the instructions that only work on registers, or an empty string if
+ * the instruction has to be executed by the Chip8 class. The shifts depend on the profile, all
+ * other instructions with quirks are executed by the Chip8 class anyway.
+ */
+std::string translate_instruction (Operation operation, const Instruction &instruction,
+                                   bool shift_reads_y) {
+  auto Vx = "V[" + hex (instruction.x, 1) + "]";
+  auto Vy = "V[" + hex (instruction.y, 1) + "]";
+  auto kk = hex (instruction.kk, 2);
+
+  switch (operation) {
+  case Operation::_0nnn: return "// ignored";
+  case Operation::_6xkk: return Vx + " = " + kk + ";";
+  case Operation::_7xkk: return Vx + " += " + kk + ";";
+  case Operation::_8xy0: return Vx + " = " + Vy + ";";
+  case Operation::_8xy1: return Vx + " |= " + Vy + ";";
+  case Operation::_8xy2: return Vx + " &= " + Vy + ";";
+  case Operation::_8xy3: return Vx + " ^= " + Vy + ";";
+  case Operation::_8xy4:
+    return "{ auto x_value = " + Vx + ", y_value = " + Vy + "; V[0xF] = y_value > 0xFF - x_value; "
+           + Vx + " += y_value; }";
+  case Operation::_8xy5:
+    return "{ auto x_value = " + Vx + ", y_value = " + Vy + "; V[0xF] = !(x_value < y_value); "
+           + Vx + " -= y_value; }";
+  case Operation::_8xy6:
+    if (shift_reads_y) {
+      return "{ auto y_value = " + Vy + "; V[0xF] = y_value & 0b1; " + Vx + " = y_value >> 1; }";
+    }
+    return "{ auto x_value = " + Vx + "; V[0xF] = x_value & 0b1; " + Vx + " >>= 1; }";
+  case Operation::_8xy7:
+    return "{ auto x_value = " + Vx + ", y_value = " + Vy + "; V[0xF] = !(y_value < x_value); "
+           + Vx + " = y_value - x_value; }";
+  case Operation::_8xyE:
+    if (shift_reads_y) {
+      return "{ auto y_value = " + Vy + "; V[0xF] = y_value >> 7; " + Vx + " = y_value << 1; }";
+    }
+    return "{ auto x_value = " + Vx + "; V[0xF] = x_value >> 7; " + Vx + " <<= 1; }";
+  case Operation::Annn: return "I = " + hex (instruction.nnn, 3) + ";";
+  case Operation::Fx1E: return "I = (I + " + Vx + ") & (RAM_SIZE - 1);";
+  case Operation::Fx29: return "I = " + Vx + " * 5;";
+  default: return "";
+  }
+}
+
+}
+
+CodeMap analyse_rom (std::span<const uint8_t> rom) {
+  CodeMap map;
+  std::vector<uint16_t> pending{MEMORY_PROGRAM_START};
+  map.leaders.insert (MEMORY_PROGRAM_START);
+
+  auto branch = [&] (uint32_t target) {
+    if (inside_rom (rom, target)) {
+      map.leaders.insert (target);
+      pending.push_back (target);
+    }
+  };
+
+  while (!pending.empty ()) {
+    uint32_t address = pending.back ();
+    pending.pop_back ();
+
+    // Follows the straight-line code until it was already visited or the control flow changes.
+    while (inside_rom (rom, address) && map.instructions.insert (address).second) {
+      auto instruction = fetch (rom, address);
+      auto operation = decode_operation (instruction.opcode);
+
+      switch (operation) {
+      case Operation::Invalid:
+      case Operation::_00EE:
+      case Operation::Bnnn: break;
+      case Operation::_1nnn: branch (instruction.nnn); break;
+      case Operation::_2nnn: branch (instruction.nnn); branch (address + 2); break;
+      case Operation::Fx0A: {
+        // Waiting for a key repeats the instruction, so it starts its own block.
+        map.leaders.insert (address);
+        branch (address + 2);
+        break;
+      }
+      default: {
+        if (ends_block (operation)) {
+          branch (address + 2);
+          if (operation != Operation::Fx33 && operation != Operation::Fx55) {
+            branch (address + 4);
+          }
+        }
+        break;
+      }
+      }
+
+      if (ends_block (operation)) {
+        break;
+      }
+
+      address += 2;
+    }
+  }
+
+  return map;
+}
+
+std::string translate_rom (std::span<const uint8_t> rom, const std::string &name,
+                           QuirkProfile quirks) {
+  auto map = analyse_rom (rom);
+  auto shift_reads_y = with_quirks (quirks, [] (auto policy) {
+    return decltype (policy)::SHIFT_READS_Y;
+  });
+
+  struct Block {
+    uint16_t start;
+    std::vector<uint16_t> instructions;
+  };
+
+  // Long straight-line code is split, since a block only runs if enough cycles are left for it.
+  std::vector<Block> blocks;
+  std::vector<uint16_t> pending (map.leaders.begin (), map.leaders.end ());
+  while (!pending.empty ()) {
+    Block block{pending.back (), {}};
+    pending.pop_back ();
+
+    uint32_t address = block.start;
+    while (map.instructions.contains (address)) {
+      if (block.instructions.size () == AOT_BLOCK_MAX_INSTRUCTIONS) {
+        if (map.leaders.insert (address).second) {
+          pending.push_back (address);
+        }
+        break;
+      }
+
+      auto operation = decode_operation (fetch (rom, address).opcode);
+      if (operation == Operation::Invalid) {
+        break;
+      }
+
+      block.instructions.push_back (address);
+      address += 2;
+
+      if (ends_block (operation) || map.leaders.contains (address)) {
+        break;
+      }
+    }
+
+    if (block.instructions.empty ()) {
+      map.leaders.erase (block.start);
+    } else {
+      blocks.push_back (std::move (block));
+    }
+  }
+
+  std::ranges::sort (blocks, {}, &Block::start);
+
+  auto transfer = [&] (uint32_t target) {
+    if (map.leaders.contains (target)) {
+      return "goto " + label (target) + ";";
+    }
+
+    return "pc = " + hex (target, 3) + "; goto leave;";
+  };
+
+  std::ostringstream out;
+  out << "// Generated by chip8_aot from " << name << ". Do not edit.\n"
+      << "\n"
+      << "#include \"aot.h\"\n"
+      << "\n"
+      << "namespace {\n"
+      << "\n"
+      << "const uint8_t ROM[] = {";
+  for (size_t index = 0; index < rom.size (); index++) {
+    out << (index % 12 == 0 ? "\n    " : " ") << hex (rom[index], 2) << ",";
+  }
+
+  out << "\n};\n"
+      << "\n"
+      << "const uint8_t CODE[] = {";
+  for (size_t index = 0; index < rom.size (); index++) {
+    uint16_t address = MEMORY_PROGRAM_START + index;
+    auto code = map.instructions.contains (address) || map.instructions.contains (address - 1);
+    out << (index % 32 == 0 ? "\n    " : " ") << code << ",";
+  }
+
+  out << "\n};\n"
+      << "\n"
+      << "uint64_t run (AotEngine &engine, Chip8 &chip, uint64_t cycles) {\n"
+      << "  [[maybe_unused]] auto &V = AotEngine::registers (chip);\n"
+      << "  [[maybe_unused]] auto &I = AotEngine::index_register (chip);\n"
+      << "  auto &pc = AotEngine::program_counter (chip);\n"
+      << "  auto remaining = cycles;\n"
+      << "\n";
+
+  // The blocks are generated first, since the label in front of the dispatch is only emitted if
+  // some block returns to it.
+  std::ostringstream body;
+  auto dispatches = false;
+  for (const auto &block : blocks) {
+    auto length = block.instructions.size ();
+    auto first_page = block.start / CODE_PAGE_SIZE;
+    auto last_page = (block.instructions.back () + 1) / CODE_PAGE_SIZE;
+
+    body << "\n" << label (block.start) << ":\n"
+         << "  if (remaining < " << length;
+    for (auto page = first_page; page <= last_page; page++) {
+      body << " || !engine.unchanged (chip, " << page << ")";
+    }
+
+    body << ") {\n"
+         << "    pc = " << hex (block.start, 3) << ";\n"
+         << "    goto leave;\n"
+         << "  }\n"
+         << "  remaining -= " << length << ";\n";
+
+    for (auto address : block.instructions) {
+      auto instruction = fetch (rom, address);
+      auto operation = decode_operation (instruction.opcode);
+      const auto &[opcode, nnn, x, y, kk, n] = instruction;
+      auto Vx = "V[" + hex (x, 1) + "]";
+
+      body << "  // " << hex (address, 3) << ": " << hex (opcode, 4) << "\n";
+
+      auto code = translate_instruction (operation, instruction, shift_reads_y);
+      if (!code.empty ()) {
+        body << "  " << code << "\n";
+        continue;
+      }
+
+      switch (operation) {
+      case Operation::_1nnn: {
+        body << "  " << transfer (nnn) << "\n";
+        break;
+      }
+      case Operation::_3xkk:
+      case Operation::_4xkk:
+      case Operation::_5xy0:
+      case Operation::_9xy0: {
+        std::string condition;
+        switch (operation) {
+        case Operation::_3xkk: condition = Vx + " == " + hex (kk, 2); break;
+        case Operation::_4xkk: condition = Vx + " != " + hex (kk, 2); break;
+        case Operation::_5xy0: condition = Vx + " == V[" + hex (y, 1) + "]"; break;
+        default: condition = Vx + " != V[" + hex (y, 1) + "]"; break;
+        }
+
+        body << "  if (" << condition << ") {\n"
+             << "    " << transfer (address + 4) << "\n"
+             << "  }\n"
+             << "  " << transfer (address + 2) << "\n";
+        break;
+      }
+      default: {
+        if (!ends_block (operation)) {
+          body << "  AotEngine::execute (chip, " << hex (opcode, 4) << ");\n";
+          break;
+        }
+
+        // Calls, returns, computed jumps, key checks and memory writes are left to the Chip8
+        // class. Afterwards the new program counter is looked up again, except after waiting for
+        // a key, where the engine stops if no key was pressed.
+        body << "  pc = " << hex (address + 2, 3) << ";\n"
+             << "  AotEngine::execute (chip, " << hex (opcode, 4) << ");\n";
+        if (operation == Operation::Fx0A) {
+          body << "  goto leave;\n";
+          break;
+        }
+
+        body << "  goto dispatch;\n";
+        dispatches = true;
+        break;
+      }
+      }
+    }
+
+    if (!ends_block (decode_operation (fetch (rom, block.instructions.back ()).opcode))) {
+      body << "  " << transfer (block.instructions.back () + 2) << "\n";
+    }
+  }
+
+  if (dispatches) {
+    out << "dispatch:\n";
+  }
+
+  out << "  switch (pc) {\n";
+  for (const auto &block : blocks) {
+    out << "  case " << hex (block.start, 3) << ": goto " << label (block.start) << ";\n";
+  }
+
+  out << "  default: goto leave;\n"
+      << "  }\n"
+      << body.str ()
+      << "\n"
+      << "leave:\n"
+      << "  return cycles - remaining;\n"
+      << "}\n"
+      << "\n"
+      << "}\n"
+      << "\n"
+      << "extern const AotProgram AOT_PROGRAM;\n"
+      << "const AotProgram AOT_PROGRAM{ROM, CODE, " << profile_enumerator (quirks)
+      << ", run};\n";
+
+  return out.str ();
+}
@@ -0,0 +1,179 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "rewind.h"
+
+#include <algorithm>
+#include <cstring>
+
+// The offsets inside a state have to fit into the 16 bit fields of a difference.
+static_assert(sizeof (SaveState) <= UINT16_MAX);
+
+static constexpr size_t RECORD_OVERHEAD = 2 * sizeof (uint32_t);
+
+// In the worst case every changed byte is followed by a gap, which costs a header per block.
+static constexpr size_t MAX_DELTA_SIZE
+    = sizeof (SaveState) + (sizeof (SaveState) / REWIND_MIN_GAP + 1) * 2 * sizeof (uint16_t);
+
+RewindBuffer::RewindBuffer (size_t budget)
+    : ring_ (budget), head_ (0), tail_ (0), used_ (0), frames_ (0), has_newest_ (false),
+      newest_ (), next_ (), scratch_ (MAX_DELTA_SIZE) {}
+
+void RewindBuffer::push (const Chip8 &chip) {
+  if (!this->has_newest_) {
+    chip.save_state (this->newest_);
+    this->has_newest_ = true;
+    return;
+  }
+
+  chip.save_state (this->next_);
+  auto size = this->encode (this->newest_, this->next_);
+  this->newest_ = this->next_;
+
+  auto record_size = size + RECORD_OVERHEAD;
+  if (record_size > this->ring_.size ()) {
+    // The difference doesn't fit at all, so nothing before this frame can be restored.
+    this->head_ = this->tail_ = this->used_ = this->frames_ = 0;
+    return;
+  }
+
+  while (this->ring_.size () - this->used_ < record_size) {
+    this->drop_oldest ();
+  }
+
+  auto stored_size = (uint32_t)size;
+  this->write_ring (this->head_, &stored_size, sizeof (stored_size));
+  this->write_ring (this->head_ + sizeof (stored_size), this->scratch_.data (), size);
+  this->write_ring (this->head_ + sizeof (stored_size) + size, &stored_size, sizeof (stored_size));
+
+  this->head_ = (this->head_ + record_size) % this->ring_.size ();
+  this->used_ += record_size;
+  this->frames_++;
+}
+
+bool RewindBuffer::rewind (Chip8 &chip) {
+  if (this->frames_ == 0) {
+    return false;
+  }
+
+  auto capacity = this->ring_.size ();
+
+  uint32_t size;
+  this->read_ring ((this->head_ + capacity - sizeof (size)) % capacity, &size, sizeof (size));
+
+  auto start = (this->head_ + capacity - size - RECORD_OVERHEAD) % capacity;
+  this->read_ring (start + sizeof (size), this->scratch_.data (), size);
+  decode (this->scratch_.data (), size, this->newest_);
+
+  this->head_ = start;
+  this->used_ -= size + RECORD_OVERHEAD;
+  this->frames_--;
+
+  chip.save_state (this->next_);
+  auto keypad = this->next_.keypad;
+  this->next_ = this->newest_;
+  this->next_.keypad = keypad;
+  return chip.load_state (this->next_);
+}
+
+void RewindBuffer::clear () {
+  this->head_ = this->tail_ = this->used_ = this->frames_ = 0;
+  this->has_newest_ = false;
+}
+
+size_t RewindBuffer::frames () const {
+  return this->frames_;
+}
+
+size_t RewindBuffer::used () const {
+  return this->used_;
+}
+
+size_t RewindBuffer::encode (const SaveState &previous, const SaveState &next) {
+  const auto *old_bytes = reinterpret_cast<const uint8_t *> (&previous);
+  const auto *new_bytes = reinterpret_cast<const uint8_t *> (&next);
+  auto *output = this->scratch_.data ();
+
+  auto is_gap = [&] (size_t position) {
+    auto end = std::min (position + REWIND_MIN_GAP, sizeof (SaveState));
+    for (; position < end; position++) {
+      if (old_bytes[position] != new_bytes[position]) {
+        return false;
+      }
+    }
+
+    return true;
+  };
+
+  size_t size = 0;
+  size_t position = 0;
+  while (true) {
+    auto skip_start = position;
+    while (position < sizeof (SaveState) && old_bytes[position] == new_bytes[position]) {
+      position++;
+    }
+
+    if (position == sizeof (SaveState)) {
+      break;
+    }
+
+    auto literal_start = position;
+    while (position < sizeof (SaveState) && !is_gap (position)) {
+      position++;
+    }
+
+    auto skip = (uint16_t)(literal_start - skip_start);
+    auto count = (uint16_t)(position - literal_start);
+    std::memcpy (output + size, &skip, sizeof (skip));
+    std::memcpy (output + size + sizeof (skip), &count, sizeof (count));
+    size += sizeof (skip) + sizeof (count);
+
+    for (auto index = literal_start; index < position; index++) {
+      output[size++] = old_bytes[index] ^ new_bytes[index];
+    }
+  }
+
+  return size;
+}
+
+void RewindBuffer::decode (const uint8_t *delta, size_t size, SaveState &state) {
+  auto *bytes = reinterpret_cast<uint8_t *> (&state);
+
+  size_t position = 0;
+  size_t offset = 0;
+  while (offset < size) {
+    uint16_t skip, count;
+    std::memcpy (&skip, delta + offset, sizeof (skip));
+    std::memcpy (&count, delta + offset + sizeof (skip), sizeof (count));
+    offset += sizeof (skip) + sizeof (count);
+
+    position += skip;
+    for (auto index = 0u; index < count; index++) {
+      bytes[position++] ^= delta[offset++];
+    }
+  }
+}
+
+void RewindBuffer::write_ring (size_t offset, const void *source, size_t size) {
+  offset %= this->ring_.size ();
+  auto first = std::min (size, this->ring_.size () - offset);
+  std::memcpy (this->ring_.data () + offset, source, first);
+  std::memcpy (this->ring_.data (), (const uint8_t *)source + first, size - first);
+}
+
+void RewindBuffer::read_ring (size_t offset, void *target, size_t size) const {
+  offset %= this->ring_.size ();
+  auto first = std::min (size, this->ring_.size () - offset);
+  std::memcpy (target, this->ring_.data () + offset, first);
+  std::memcpy ((uint8_t *)target + first, this->ring_.data (), size - first);
+}
+
+void RewindBuffer::drop_oldest () {
+  uint32_t size;
+  this->read_ring (this->tail_, &size, sizeof (size));
+
+  this->tail_ = (this->tail_ + size + RECORD_OVERHEAD) % this->ring_.size ();
+  this->used_ -= size + RECORD_OVERHEAD;
+  this->frames_--;
+}
@@ -0,0 +1,89 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "rom.h"
+
+#include <algorithm>
+#include <fstream>
+
+std::expected<std::vector<uint8_t>, RomError> read_rom (const std::string &path) {
+  // Opened at the end, so the size is known before anything is read.
+  std::ifstream file (path, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!file.is_open ()) {
+    return std::unexpected (RomError::OpenFailed);
+  }
+
+  auto size = (std::streamoff)file.tellg ();
+  if (size < 0) {
+    return std::unexpected (RomError::ReadFailed);
+  } else if (size == 0) {
+    return std::unexpected (RomError::Empty);
+  } else if (size > ROM_MAX_SIZE) {
+    return std::unexpected (RomError::TooLarge);
+  }
+
+  std::vector<uint8_t> rom ((size_t)size);
+  file.seekg (0);
+  file.read (reinterpret_cast<char *> (rom.data ()), size);
+  if (file.gcount () != size) {
+    return std::unexpected (RomError::ReadFailed);
+  }
+
+  return rom;
+}
+
+uint64_t rom_hash (std::span<const uint8_t> rom) {
+  uint64_t hash = 0xCBF29CE484222325;
+  for (auto byte : rom) {
+    hash ^= byte;
+    hash *= 0x100000001B3;
+  }
+
+  return hash;
+}
+
+std::string to_string (RomError error) {
+  switch (error) {
+  case RomError::OpenFailed: return "can't be opened";
+  case RomError::ReadFailed: return "can't be read";
+  case RomError::Empty: return "is empty";
+  default: return "is larger than the " + std::to_string (ROM_MAX_SIZE) + " bytes of free memory";
+  }
+}
+
+RomCache::RomCache () : mutex_ (), paths_ (), images_ () {}
+
+std::expected<RomImage, RomError> RomCache::load (const std::string &path) {
+  {
+    std::lock_guard lock (this->mutex_);
+    auto cached = this->paths_.find (path);
+    if (cached != this->paths_.end ()) {
+      return cached->second;
+    }
+  }
+
+  // Reading happens outside of the lock, so other threads can read their ROMs meanwhile.
+  auto rom = read_rom (path);
+  if (!rom) {
+    return std::unexpected (rom.error ());
+  }
+
+  auto hash = rom_hash (*rom);
+
+  std::lock_guard lock (this->mutex_);
+  auto &image = this->images_[hash];
+  if (image == nullptr) {
+    image = std::make_shared<const std::vector<uint8_t>> (std::move (*rom));
+  } else if (!std::ranges::equal (*image, *rom)) {
+    // Two different ROMs with the same hash, the later one simply isn't shared.
+    return this->paths_[path] = std::make_shared<const std::vector<uint8_t>> (std::move (*rom));
+  }
+
+  return this->paths_[path] = image;
+}
+
+size_t RomCache::images () const {
+  std::lock_guard lock (this->mutex_);
+  return this->images_.size ();
+}
@@ -0,0 +1,55 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "scheduler.h"
+
+#include <algorithm>
+
+Scheduler::Scheduler (uint64_t instructions_per_second)
+    : instructions_per_second_ (std::max (instructions_per_second, (uint64_t)1)), cycles_ (),
+      ticks_ (), time_ () {}
+
+void Scheduler::run (Chip8 &chip, Engine &engine, uint64_t cycles) {
+  while (true) {
+    // Below 60 instructions per second several ticks can be due after the same instruction.
+    while (this->next_tick () <= this->cycles_) {
+      chip.tick_timers ();
+      this->ticks_++;
+    }
+
+    if (cycles == 0) {
+      break;
+    }
+
+    auto chunk = std::min (cycles, this->next_tick () - this->cycles_);
+    engine.run (chip, chunk);
+
+    this->cycles_ += chunk;
+    cycles -= chunk;
+  }
+}
+
+uint64_t Scheduler::advance (Chip8 &chip, Engine &engine, std::chrono::nanoseconds elapsed) {
+  this->time_ += elapsed;
+
+  // The target is computed from the whole emulated time, so rounding errors don't add up.
+  auto seconds = std::chrono::duration<double> (this->time_).count ();
+  auto target = (uint64_t)(seconds * (double)this->instructions_per_second_);
+  auto cycles = target > this->cycles_ ? target - this->cycles_ : 0;
+
+  this->run (chip, engine, cycles);
+  return cycles;
+}
+
+uint64_t Scheduler::cycles_until_tick () const {
+  return this->next_tick () - this->cycles_;
+}
+
+uint64_t Scheduler::tick_cycle (uint64_t instructions_per_second, uint64_t tick) {
+  return (tick * instructions_per_second + TIMER_FREQUENCY - 1) / TIMER_FREQUENCY;
+}
+
+uint64_t Scheduler::next_tick () const {
+  return tick_cycle (this->instructions_per_second_, this->ticks_ + 1);
+}
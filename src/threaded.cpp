@@ -0,0 +1,191 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "threaded.h"
+
+#include <algorithm>
+#include <iterator>
+
+#if !defined(__GNUC__)
+#error "The threaded engine relies on computed goto, which is a GNU extension."
+#endif
+
+// Computed goto (labels as values) is a GNU extension, so the pedantic warnings are silenced.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+ThreadedEngine::ThreadedEngine () : chip_ (), generation_ (), quirks_ (), superblocks_ () {}
+
+void ThreadedEngine::run (Chip8 &chip, uint64_t cycles) {
+  // The superblocks hold the labels of one instantiation, so they can't be used by another.
+  if (this->chip_ != &chip || this->generation_ != chip.generation_
+      || this->quirks_ != chip.quirks_) {
+    for (auto &superblock : this->superblocks_) {
+      superblock.reset ();
+    }
+
+    this->chip_ = &chip;
+    this->generation_ = chip.generation_;
+    this->quirks_ = chip.quirks_;
+  }
+
+  with_quirks (chip.quirks_, [&] (auto quirks) {
+    this->execute<decltype (quirks)> (chip, cycles);
+  });
+}
+
+template<typename Quirks>
+void ThreadedEngine::execute (Chip8 &chip, uint64_t cycles) {
+  static const void *const LABELS[] = {
+      &&Invalid,
+      &&_0nnn, &&_00E0, &&_00EE, &&_1nnn, &&_2nnn, &&_3xkk, &&_4xkk, &&_5xy0, &&_6xkk, &&_7xkk,
+      &&_8xy0, &&_8xy1, &&_8xy2, &&_8xy3, &&_8xy4, &&_8xy5, &&_8xy6, &&_8xy7, &&_8xyE, &&_9xy0,
+      &&Annn, &&Bnnn, &&Cxkk, &&Dxyn, &&Ex9E, &&ExA1,
+      &&Fx07, &&Fx0A, &&Fx15, &&Fx18, &&Fx1E, &&Fx29, &&Fx33, &&Fx55, &&Fx65,
+  };
+  static_assert(std::size (LABELS) == (size_t)Operation::Count);
+
+  while (cycles > 0 && !chip.waiting_for_key_) {
+    const auto &superblock = this->lookup (chip, LABELS);
+
+    // If not enough cycles are left, only the beginning of the superblock is executed.
+    auto length = std::min ((uint64_t)superblock.entries.size (), cycles);
+    cycles -= length;
+
+    // Only the instructions ending a superblock read the program counter, so it is written when
+    // one of them is reached.
+    const auto start = chip.program_counter_;
+    const auto *const first = superblock.entries.data ();
+    const auto *const last = first + length;
+    const auto *entry = first;
+
+#define EXECUTED ((size_t)(entry - first))
+#define X entry->instruction.x
+#define Y entry->instruction.y
+#define KK entry->instruction.kk
+#define NNN entry->instruction.nnn
+#define N entry->instruction.n
+#define NEXT if (++entry == last) goto Leave; goto *entry->label
+#define LEAVE_PROGRAM_COUNTER chip.program_counter_ = start + 2 * (EXECUTED + 1)
+
+    goto *entry->label;
+
+  Invalid:
+    LEAVE_PROGRAM_COUNTER;
+    (*chip.handlers_)[(size_t)Operation::Invalid] (chip, entry->instruction);
+    NEXT;
+  _0nnn: NEXT;
+  _00E0: chip._00E0 (); NEXT;
+  _00EE: LEAVE_PROGRAM_COUNTER; chip._00EE (); NEXT;
+  _1nnn: LEAVE_PROGRAM_COUNTER; chip._1nnn (NNN); NEXT;
+  _2nnn: LEAVE_PROGRAM_COUNTER; chip._2nnn (NNN); NEXT;
+  _3xkk: LEAVE_PROGRAM_COUNTER; chip._3xkk (X, KK); NEXT;
+  _4xkk: LEAVE_PROGRAM_COUNTER; chip._4xkk (X, KK); NEXT;
+  _5xy0: LEAVE_PROGRAM_COUNTER; chip._5xy0 (X, Y); NEXT;
+  _6xkk: chip._6xkk (X, KK); NEXT;
+  _7xkk: chip._7xkk (X, KK); NEXT;
+  _8xy0: chip._8xy0 (X, Y); NEXT;
+  _8xy1: chip._8xy1 (X, Y); NEXT;
+  _8xy2: chip._8xy2 (X, Y); NEXT;
+  _8xy3: chip._8xy3 (X, Y); NEXT;
+  _8xy4: chip._8xy4 (X, Y); NEXT;
+  _8xy5: chip._8xy5 (X, Y); NEXT;
+  _8xy6: chip._8xy6<Quirks> (X, Y); NEXT;
+  _8xy7: chip._8xy7 (X, Y); NEXT;
+  _8xyE: chip._8xyE<Quirks> (X, Y); NEXT;
+  _9xy0: LEAVE_PROGRAM_COUNTER; chip._9xy0 (X, Y); NEXT;
+  Annn: chip.Annn (NNN); NEXT;
+  Bnnn: LEAVE_PROGRAM_COUNTER; chip.Bnnn<Quirks> (NNN); NEXT;
+  Cxkk: chip.Cxkk (X, KK); NEXT;
+  Dxyn: chip.Dxyn<Quirks> (X, Y, N); NEXT;
+  Ex9E: LEAVE_PROGRAM_COUNTER; chip.Ex9E (X); NEXT;
+  ExA1: LEAVE_PROGRAM_COUNTER; chip.ExA1 (X); NEXT;
+  Fx07: chip.Fx07 (X); NEXT;
+  Fx0A: LEAVE_PROGRAM_COUNTER; chip.Fx0A (X); NEXT;
+  Fx15: chip.Fx15 (X); NEXT;
+  Fx18: chip.Fx18 (X); NEXT;
+  Fx1E: chip.Fx1E (X); NEXT;
+  Fx29: chip.Fx29 (X); NEXT;
+  Fx33: LEAVE_PROGRAM_COUNTER; chip.Fx33 (X); NEXT;
+  Fx55: LEAVE_PROGRAM_COUNTER; chip.Fx55<Quirks> (X); NEXT;
+  Fx65: chip.Fx65<Quirks> (X); NEXT;
+
+  Leave:
+    if (EXECUTED < superblock.entries.size () || superblock.falls_through) {
+      chip.program_counter_ = start + 2 * EXECUTED;
+    }
+
+#undef EXECUTED
+#undef X
+#undef Y
+#undef KK
+#undef NNN
+#undef N
+#undef NEXT
+#undef LEAVE_PROGRAM_COUNTER
+  }
+}
+
+#pragma GCC diagnostic pop
+
+const ThreadedEngine::Superblock &ThreadedEngine::lookup (const Chip8 &chip,
+                                                          const void *const *labels) {
+  uint16_t start = chip.program_counter_ & (RAM_SIZE - 1);
+
+  auto &superblock = this->superblocks_[start];
+  if (superblock != nullptr
+      && chip.page_versions_[superblock->first_page] == superblock->first_page_version
+      && chip.page_versions_[superblock->last_page] == superblock->last_page_version) {
+    return *superblock;
+  }
+
+  if (superblock == nullptr) {
+    superblock = std::make_unique<Superblock> ();
+  }
+
+  superblock->entries.clear ();
+  superblock->falls_through = true;
+
+  // The superblock stops at the end of the memory, only its first instruction may wrap around.
+  uint16_t address = start;
+  do {
+    auto instruction = chip.fetch (address);
+    auto operation = decode_operation (instruction.opcode);
+
+    superblock->entries.push_back ({labels[(size_t)operation], instruction});
+    address += 2;
+
+    if (ends_superblock (operation)) {
+      superblock->falls_through = false;
+      break;
+    }
+  } while (superblock->entries.size () < SUPERBLOCK_MAX_INSTRUCTIONS && address < RAM_SIZE);
+
+  superblock->first_page = start / CODE_PAGE_SIZE;
+  superblock->last_page = ((address - 1) & (RAM_SIZE - 1)) / CODE_PAGE_SIZE;
+  superblock->first_page_version = chip.page_versions_[superblock->first_page];
+  superblock->last_page_version = chip.page_versions_[superblock->last_page];
+
+  return *superblock;
+}
+
+bool ThreadedEngine::ends_superblock (Operation operation) {
+  switch (operation) {
+  case Operation::Invalid:
+  case Operation::_00EE:
+  case Operation::_1nnn:
+  case Operation::_2nnn:
+  case Operation::_3xkk:
+  case Operation::_4xkk:
+  case Operation::_5xy0:
+  case Operation::_9xy0:
+  case Operation::Bnnn:
+  case Operation::Ex9E:
+  case Operation::ExA1:
+  case Operation::Fx0A:
+  case Operation::Fx33:
+  case Operation::Fx55: return true;
+  default: return false;
+  }
+}
@@ -0,0 +1,81 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "aot.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+// Random programs of programs.h, which were translated by chip8_aot during the build. The seeds
+// are listed in AOT_TEST_SEEDS of the CMakeLists.txt.
+extern const AotProgram AOT_PROGRAM_0;
+extern const AotProgram AOT_PROGRAM_1;
+extern const AotProgram AOT_PROGRAM_2;
+extern const AotProgram AOT_PROGRAM_3;
+
+static const AotProgram *const AOT_TEST_PROGRAMS[] = {
+    &AOT_PROGRAM_0, &AOT_PROGRAM_1, &AOT_PROGRAM_2, &AOT_PROGRAM_3,
+};
+
+/**
+ * Runs the ROM once with the interpreter and once with the native code of the program, which is
+ * called with the given amount of cycles at a time.
+ */
+static void expect_same_state (AotEngine &engine, std::span<const uint8_t> rom, uint64_t cycles,
+                               uint64_t chunk) {
+  auto expected = std::make_unique<Chip8> ();
+  auto actual = std::make_unique<Chip8> ();
+  for (auto *chip : {expected.get (), actual.get ()}) {
+    chip->initialize ();
+    chip->load_game (rom);
+    chip->press_key (0x5);
+  }
+
+  InterpreterEngine interpreter;
+  interpreter.run (*expected, cycles);
+
+  for (uint64_t executed = 0; executed < cycles; executed += chunk) {
+    engine.run (*actual, std::min (chunk, cycles - executed));
+  }
+
+  EXPECT_TRUE(*expected == *actual);
+}
+
+TEST(AotTest, MatchesInterpreterOnTranslatedPrograms) {
+  for (const auto *program : AOT_TEST_PROGRAMS) {
+    AotEngine engine (*program);
+    expect_same_state (engine, program->rom, 5000, 5000);
+    expect_same_state (engine, program->rom, 5000, 7);
+  }
+}
+
+TEST(AotTest, InterpretsOtherGames) {
+  // The native code of the first program must not be used for the others.
+  AotEngine engine (*AOT_TEST_PROGRAMS[0]);
+  for (const auto *program : AOT_TEST_PROGRAMS) {
+    expect_same_state (engine, program->rom, 5000, 5000);
+  }
+}
+
+TEST(AotTest, RevalidatesForANewMachineAtTheSameAddress) {
+  AotEngine engine (*AOT_TEST_PROGRAMS[0]);
+  InterpreterEngine interpreter;
+  for (const auto *program : {AOT_TEST_PROGRAMS[0], AOT_TEST_PROGRAMS[1]}) {
+    auto expected = std::make_unique<Chip8> ();
+    expected->initialize ();
+    expected->load_game (program->rom);
+    interpreter.run (*expected, 5000);
+
+    // Lives in the same stack slot in every iteration, with the same page versions.
+    Chip8 actual;
+    actual.initialize ();
+    actual.load_game (program->rom);
+    engine.run (actual, 5000);
+
+    EXPECT_TRUE(*expected == actual);
+  }
+}
@@ -0,0 +1,33 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "../programs.h"
+
+#define AOT_TEST_INSTRUCTIONS 64
+
+/**
+ * Writes one of the random programs into a ROM, so chip8_aot can translate it during the build.
+ * Expects the seed and the path of the ROM as arguments.
+ */
+auto main (int argc, char **argv) noexcept -> int {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <seed> <output>" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto seed = (uint32_t)std::strtoul (argv[1], nullptr, 10);
+  auto program = random_program (seed, AOT_TEST_INSTRUCTIONS);
+  std::ofstream output (argv[2], std::ios::binary);
+  output.write ((const char *)program.data (), (std::streamsize)program.size ());
+  if (!output) {
+    std::cerr << "Couldn't write " << argv[2] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
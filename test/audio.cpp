@@ -0,0 +1,177 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "audio.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "idle.h"
+#include "scheduler.h"
+
+/**
+ * Renders the given amount of samples in buffers of the size the device asks for.
+ */
+static std::vector<int16_t> render (Beeper &beeper, size_t count) {
+  std::vector<int16_t> samples (count);
+  for (size_t done = 0; done < count; done += AUDIO_BUFFER_SAMPLES) {
+    beeper.render (samples.data () + done, std::min ((size_t)AUDIO_BUFFER_SAMPLES, count - done));
+  }
+
+  return samples;
+}
+
+/**
+ * @return The index after the last sample which isn't silent, or 0 if all of them are.
+ */
+static size_t sound_end (const std::vector<int16_t> &samples) {
+  for (auto index = samples.size (); index > 0; index--) {
+    if (samples[index - 1] != 0) {
+      return index;
+    }
+  }
+
+  return 0;
+}
+
+TEST(SpscRingTest, PassesEverythingInOrderBetweenThreads) {
+  SpscRing<uint32_t, 64> ring;
+  constexpr uint32_t COUNT = 100000;
+
+  // Both sides yield when they have to wait, so the test is fast on a single core as well.
+  std::thread producer ([&] {
+    for (uint32_t value = 0; value < COUNT;) {
+      if (ring.push (value)) {
+        value++;
+      } else {
+        std::this_thread::yield ();
+      }
+    }
+  });
+
+  for (uint32_t expected = 0; expected < COUNT;) {
+    if (auto value = ring.peek ()) {
+      ASSERT_EQ(*value, expected);
+      ring.pop ();
+      expected++;
+    } else {
+      std::this_thread::yield ();
+    }
+  }
+
+  producer.join ();
+  EXPECT_FALSE(ring.peek ());
+}
+
+TEST(SpscRingTest, KeepsOneSlotFree) {
+  SpscRing<int, 4> ring;
+  EXPECT_TRUE(ring.push (1));
+  EXPECT_TRUE(ring.push (2));
+  EXPECT_TRUE(ring.push (3));
+  EXPECT_FALSE(ring.push (4));
+
+  ring.pop ();
+  EXPECT_TRUE(ring.push (4));
+  EXPECT_EQ(ring.peek (), 2);
+}
+
+TEST(BeeperTest, PlaysTheToneBehindTheEmulation) {
+  Beeper beeper (AUDIO_SAMPLE_RATE, AUDIO_LATENCY);
+  EXPECT_EQ(sound_end (render (beeper, 1000)), 0);
+
+  // The first change decides where the emulated time is played, everything else keeps its distance.
+  beeper.set_tone (5000, true);
+  beeper.set_tone (5000 + 800, false);
+  auto samples = render (beeper, 4000);
+
+  auto silent = std::all_of (samples.begin (), samples.begin () + AUDIO_LATENCY,
+                             [] (int16_t sample) { return sample == 0; });
+  EXPECT_TRUE(silent);
+  EXPECT_NE(sound_end (samples), 0);
+  EXPECT_GE(sound_end (samples), AUDIO_LATENCY + 800);
+  EXPECT_LE(sound_end (samples), AUDIO_LATENCY + 800 + BEEPER_RAMP_SAMPLES);
+
+  // The emulation stood still meanwhile, so the next tone is late and played after the latency.
+  beeper.set_tone (5000 + 1000, true);
+  beeper.set_tone (5000 + 1100, false);
+  samples = render (beeper, 1000);
+  EXPECT_GE(sound_end (samples), AUDIO_LATENCY + 100);
+  EXPECT_LE(sound_end (samples), AUDIO_LATENCY + 100 + BEEPER_RAMP_SAMPLES);
+}
+
+TEST(BeeperTest, StaysWithinTheAmplitude) {
+  Beeper beeper (AUDIO_SAMPLE_RATE, 0);
+  beeper.set_tone (0, true);
+
+  auto samples = render (beeper, AUDIO_SAMPLE_RATE / 10);
+  auto [lowest, highest] = std::minmax_element (samples.begin (), samples.end ());
+  EXPECT_GE(*lowest, -BEEPER_AMPLITUDE);
+  EXPECT_LE(*highest, BEEPER_AMPLITUDE);
+  EXPECT_GT(*highest, BEEPER_AMPLITUDE / 2);
+}
+
+TEST(ToneTrackerTest, StampsTheSoundTimerInEmulatedTime) {
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (std::vector<uint8_t>{
+      0x60, 0x03, // V0 = 3
+      0xF0, 0x18, // ST = V0
+      0x12, 0x04, // jump 0x204
+  });
+
+  // Ten samples per instruction and no latency, so the tone starts with the first sample.
+  Beeper beeper (6000, 0);
+  InterpreterEngine engine;
+  ToneTracker tones (engine, beeper, 600);
+  Scheduler scheduler (600);
+  scheduler.run (chip, tones, 100);
+  EXPECT_FALSE(chip.beeping ());
+
+  // The tone starts after the Fx18 at cycle 2, although the run of the whole frame is a single
+  // chunk, and stops at the third tick at cycle 30.
+  auto samples = render (beeper, 600);
+  EXPECT_GE(sound_end (samples), 280);
+  EXPECT_LE(sound_end (samples), 280 + BEEPER_RAMP_SAMPLES);
+}
+
+TEST(ToneTrackerTest, RunsTheEngineInLongChunks) {
+  /**
+   * Remembers how many cycles every run was given.
+   */
+  class RecordingEngine : public Engine {
+   public:
+    void run (Chip8 &chip, uint64_t cycles) override {
+      this->runs.push_back (cycles);
+      this->interpreter.run (chip, cycles);
+    }
+
+    InterpreterEngine interpreter;
+    std::vector<uint64_t> runs;
+  };
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (std::vector<uint8_t>{0x12, 0x00});
+
+  Beeper beeper (AUDIO_SAMPLE_RATE, AUDIO_LATENCY);
+  RecordingEngine engine;
+
+  // A frame at 600 instructions per second is shorter than a chunk, so it is run at once.
+  ToneTracker slow (engine, beeper, 600);
+  slow.run (chip, 10);
+  EXPECT_EQ(engine.runs, (std::vector<uint64_t>{10}));
+
+  // Without a loop to skip the chunks never get shorter than IDLE_CHECK_INTERVAL.
+  engine.runs.clear ();
+  slow.run (chip, 2 * IDLE_CHECK_INTERVAL + 1);
+  EXPECT_EQ(engine.runs, (std::vector<uint64_t>{IDLE_CHECK_INTERVAL, IDLE_CHECK_INTERVAL, 1}));
+
+  // At high rates a chunk is a millisecond of emulated time.
+  engine.runs.clear ();
+  ToneTracker fast (engine, beeper, 1000000);
+  fast.run (chip, 2500);
+  EXPECT_EQ(engine.runs, (std::vector<uint64_t>{1000, 1000, 500}));
+}
@@ -0,0 +1,90 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "batch.h"
+#include "pool.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+TEST(WorkStealingPoolTest, RunsEveryJobOnce) {
+  std::vector<std::atomic<int>> calls (1000);
+
+  WorkStealingPool pool (4);
+  pool.run (calls.size (), [&] (size_t index) { calls[index]++; });
+
+  for (const auto &count : calls) {
+    ASSERT_EQ(count, 1);
+  }
+}
+
+TEST(BatchTest, ReportsEveryRomSeparately) {
+  auto directory = std::filesystem::temp_directory_path () / "chip8_batch_test";
+  std::filesystem::create_directories (directory);
+
+  auto write = [&] (const std::string &name, std::vector<uint8_t> rom) {
+    auto path = (directory / name).string ();
+    std::ofstream (path, std::ios::binary).write ((const char *)rom.data (), rom.size ());
+    return path;
+  };
+
+  auto loop = write ("loop.ch8", {0x60, 0x01, 0x12, 0x02});
+  auto invalid = write ("invalid.ch8", {0x60, 0x01, 0x81, 0x2F});
+  auto missing = (directory / "missing.ch8").string ();
+
+  auto results = run_batch ({loop, invalid, missing},
+                            {EngineType::Interpreter, 600, {0, 3}, 2});
+  std::filesystem::remove_all (directory);
+
+  ASSERT_EQ(results.size (), 3);
+
+  EXPECT_EQ(results[0].exit, BatchExit::Completed);
+  EXPECT_EQ(results[0].frames, 3);
+  EXPECT_EQ(results[0].cycles, 30);
+  EXPECT_FALSE(results[0].fault);
+
+  EXPECT_EQ(results[1].exit, BatchExit::Faulted);
+  EXPECT_EQ(results[1].frames, 1);
+  EXPECT_EQ(results[1].fault, (Fault{0x202, 0x812F, FaultReason::UnknownOpcode}));
+
+  EXPECT_EQ(results[2].path, missing);
+  EXPECT_EQ(results[2].exit, BatchExit::LoadFailed);
+  EXPECT_EQ(results[2].load_error, RomError::OpenFailed);
+}
+
+TEST(BatchTest, ReportsStackFaults) {
+  auto directory = std::filesystem::temp_directory_path () / "chip8_batch_stack_test";
+  std::filesystem::create_directories (directory);
+
+  auto write = [&] (const std::string &name, std::vector<uint8_t> rom) {
+    auto path = (directory / name).string ();
+    std::ofstream (path, std::ios::binary).write ((const char *)rom.data (), rom.size ());
+    return path;
+  };
+
+  // Returns without a call, and calls itself until the stack is full.
+  auto underflow = write ("underflow.ch8", {0x60, 0x01, 0x00, 0xEE});
+  auto overflow = write ("overflow.ch8", {0x60, 0x01, 0x22, 0x02});
+
+  for (auto engine : {EngineType::Interpreter, EngineType::Threaded, EngineType::Jit}) {
+    auto results = run_batch ({underflow, overflow}, {engine, 600, {0, 3}, 2});
+    ASSERT_EQ(results.size (), 2);
+
+    EXPECT_EQ(results[0].exit, BatchExit::Faulted);
+    EXPECT_EQ(results[0].fault, (Fault{0x202, 0x00EE, FaultReason::StackUnderflow}));
+
+    EXPECT_EQ(results[1].exit, BatchExit::Faulted);
+    EXPECT_EQ(results[1].fault, (Fault{0x202, 0x2202, FaultReason::StackOverflow}));
+  }
+
+  std::filesystem::remove_all (directory);
+}
+
+TEST(BatchTest, QuotesCsvFields) {
+  EXPECT_EQ(csv_quote ("roms/pong.ch8"), "\"roms/pong.ch8\"");
+  EXPECT_EQ(csv_quote ("a \"b\", c\\d"), "\"a \"\"b\"\", c\\d\"");
+}
@@ -4,6 +4,7 @@
 
 #include "chip8.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include "gtest/gtest.h"
@@ -24,15 +25,19 @@ class InstructionTest : public ::testing::Test {
 };
 
 TEST_F(InstructionTest, FullyClearsScreen) {
-  for (auto &pixel : this->chip_.display_) {
-    pixel = true;
-  }
+  this->chip_.display_.fill (~(DisplayRow)0);
+  this->chip_.display_[3] = 0;
+  this->chip_.dirty_rows_ = 0;
 
   this->chip_._00E0 ();
 
-  for (const auto &pixel : this->chip_.display_) {
-    EXPECT_FALSE(pixel);
+  for (const auto &row : this->chip_.display_) {
+    EXPECT_EQ(row, 0);
   }
+
+  // The row which was empty already didn't change.
+  EXPECT_EQ(this->chip_.take_dirty_rows (), ~(1u << 3));
+  EXPECT_EQ(this->chip_.take_dirty_rows (), 0);
 }
 
 TEST_F(InstructionTest, SuccessfullyReturnsSubroutine) {
@@ -45,6 +50,15 @@ TEST_F(InstructionTest, SuccessfullyReturnsSubroutine) {
   ASSERT_EQ(this->chip_.program_counter_, AFTER_INSTRUCTION_PC);
 }
 
+TEST_F(InstructionTest, ReturnFaultsOnEmptyStack) {
+  this->chip_._00EE ();
+
+  ASSERT_EQ(this->chip_.stack_pointer_, 0);
+  ASSERT_EQ(this->chip_.program_counter_, MEMORY_PROGRAM_START);
+  ASSERT_EQ(this->chip_.fault (),
+            (Fault{MEMORY_PROGRAM_START, 0x00EE, FaultReason::StackUnderflow}));
+}
+
 TEST_F(InstructionTest, JumpsToAddress) {
   this->chip_._1nnn (AFTER_INSTRUCTION_PC + 42);
 
@@ -63,6 +77,17 @@ TEST_F(InstructionTest, SuccessfullyCalledSubroutine) {
   ASSERT_EQ(stack_top, AFTER_INSTRUCTION_PC);
 }
 
+TEST_F(InstructionTest, CallFaultsOnFullStack) {
+  this->chip_.stack_pointer_ = STACK_SIZE;
+
+  this->chip_._2nnn (0x234);
+
+  ASSERT_EQ(this->chip_.stack_pointer_, STACK_SIZE);
+  ASSERT_EQ(this->chip_.program_counter_, MEMORY_PROGRAM_START);
+  ASSERT_EQ(this->chip_.fault (),
+            (Fault{MEMORY_PROGRAM_START, 0x2234, FaultReason::StackOverflow}));
+}
+
 TEST_F(InstructionTest, SkipIfXEqToConst_True) {
   this->chip_.V_[0x0] = 42;
   this->chip_._3xkk (0x0, 42);
@@ -189,7 +214,7 @@ TEST_F(InstructionTest, SubYFromXWithBorrow) {
 
 TEST_F(InstructionTest, DivXBy2NoLSB) {
   this->chip_.V_[0x0] = 0b00101010;
-  this->chip_._8xy6 (0x0);
+  this->chip_._8xy6 (0x0, 0x1);
 
   ASSERT_EQ(this->chip_.V_[0x0], 0b00010101);
   ASSERT_EQ(this->chip_.V_[0xF], 0);
@@ -197,7 +222,7 @@ TEST_F(InstructionTest, DivXBy2NoLSB) {
 
 TEST_F(InstructionTest, DivXBy2WithLSB) {
   this->chip_.V_[0x0] = 0b00101011;
-  this->chip_._8xy6 (0x0);
+  this->chip_._8xy6 (0x0, 0x1);
 
   ASSERT_EQ(this->chip_.V_[0x0], 0b00010101);
   ASSERT_EQ(this->chip_.V_[0xF], 1);
@@ -223,7 +248,7 @@ TEST_F(InstructionTest, SubXFromYWithBorrow) {
 
 TEST_F(InstructionTest, MulXBy2NoMSB) {
   this->chip_.V_[0x0] = 0b01000000;
-  this->chip_._8xyE (0x0);
+  this->chip_._8xyE (0x0, 0x1);
 
   ASSERT_EQ(this->chip_.V_[0x0], 0b10000000);
   ASSERT_EQ(this->chip_.V_[0xF], 0);
@@ -231,12 +256,26 @@ TEST_F(InstructionTest, MulXBy2NoMSB) {
 
 TEST_F(InstructionTest, MulXBy2WithMSB) {
   this->chip_.V_[0x0] = 0b10000000;
-  this->chip_._8xyE (0x0);
+  this->chip_._8xyE (0x0, 0x1);
 
   ASSERT_EQ(this->chip_.V_[0x0], 0);
   ASSERT_EQ(this->chip_.V_[0xF], 1);
 }
 
+TEST_F(InstructionTest, ShiftsYIntoXWithVipQuirks) {
+  this->chip_.V_[0x1] = 0b10000011;
+  this->chip_._8xy6<CosmacVipQuirks> (0x0, 0x1);
+
+  EXPECT_EQ(this->chip_.V_[0x0], 0b01000001);
+  EXPECT_EQ(this->chip_.V_[0xF], 1);
+
+  this->chip_._8xyE<CosmacVipQuirks> (0x0, 0x1);
+
+  EXPECT_EQ(this->chip_.V_[0x0], 0b00000110);
+  EXPECT_EQ(this->chip_.V_[0xF], 1);
+  EXPECT_EQ(this->chip_.V_[0x1], 0b10000011);
+}
+
 TEST_F(InstructionTest, SkipIfXNotEqToY_True) {
   this->chip_.V_[0x0] = 42;
   this->chip_.V_[0x1] = 42;
@@ -266,32 +305,83 @@ TEST_F(InstructionTest, JumpAddressRelativeToV0) {
   ASSERT_EQ(this->chip_.program_counter_, AFTER_INSTRUCTION_PC + 42);
 }
 
+TEST_F(InstructionTest, JumpAddressRelativeToXWithChip48Quirks) {
+  this->chip_.V_[0x0] = 2;
+  this->chip_.V_[0x3] = 4;
+  this->chip_.Bnnn<Chip48Quirks> (0x340);
+
+  ASSERT_EQ(this->chip_.program_counter_, 0x344);
+}
+
 TEST_F(InstructionTest, AndRandomNumberWithConstant) {
-  // TODO: W.I.P
+  std::array<uint8_t, 32> numbers;
+  for (auto &number : numbers) {
+    this->chip_.Cxkk (0x3, 0xF0);
+    number = this->chip_.V_[0x3];
+    EXPECT_EQ(number & 0x0F, 0);
+  }
+
+  // The same seed gives the same numbers.
+  this->chip_.seed_random (DEFAULT_RANDOM_SEED);
+  for (auto number : numbers) {
+    this->chip_.Cxkk (0x3, 0xF0);
+    EXPECT_EQ(this->chip_.V_[0x3], number);
+  }
+
+  EXPECT_NE(std::count (numbers.begin (), numbers.end (), numbers[0]), numbers.size ());
 }
 
 TEST_F(InstructionTest, DrawNSpritesAtXY) {
   this->chip_.I_ = AFTER_INSTRUCTION_PC;
 
   this->chip_.memory_[this->chip_.I_] = 0b10101010;
+  this->chip_.dirty_rows_ = 0;
 
   this->chip_.Dxyn (0, 0, 2);
 
-  EXPECT_TRUE(this->chip_.draw_flag_);
+  // The second byte of the sprite is empty, so only the first row changed.
+  EXPECT_EQ(this->chip_.take_dirty_rows (), 0b1);
   EXPECT_FALSE(this->chip_.V_[0x0F]);
 
-  for (auto index = 0u; index < 8; index++) {
-    ASSERT_EQ(this->chip_.display_[index], index % 2 == 0);
-  }
+  EXPECT_EQ(this->chip_.display_[0], (DisplayRow)0b10101010 << 56);
 
   this->chip_.Dxyn (0, 0, 2);
 
-  EXPECT_TRUE(this->chip_.draw_flag_);
+  EXPECT_EQ(this->chip_.take_dirty_rows (), 0b1);
   EXPECT_TRUE(this->chip_.V_[0x0F]);
 
-  for (auto index = 0u; index < 8; index++) {
-    EXPECT_FALSE(this->chip_.display_[index]);
-  }
+  EXPECT_EQ(this->chip_.display_[0], 0);
+}
+
+TEST_F(InstructionTest, DrawWrapsAroundEdges) {
+  this->chip_.I_ = AFTER_INSTRUCTION_PC;
+  this->chip_.memory_[this->chip_.I_] = 0b11110001;
+  this->chip_.memory_[this->chip_.I_ + 1] = 0b10000000;
+
+  this->chip_.V_[0x0] = SCREEN_WIDTH + 60;
+  this->chip_.V_[0x1] = SCREEN_HEIGHT - 1;
+  this->chip_.Dxyn (0, 1, 2);
+
+  EXPECT_FALSE(this->chip_.V_[0x0F]);
+  EXPECT_EQ(this->chip_.display_[SCREEN_HEIGHT - 1], 0b1111 | (DisplayRow)0b0001 << 60);
+  EXPECT_EQ(this->chip_.display_[0], 0b1000);
+}
+
+TEST_F(InstructionTest, DrawClipsAtEdgesWithVipQuirks) {
+  this->chip_.I_ = AFTER_INSTRUCTION_PC;
+  this->chip_.memory_[this->chip_.I_] = 0b11110001;
+  this->chip_.memory_[this->chip_.I_ + 1] = 0b10000000;
+  this->chip_.dirty_rows_ = 0;
+
+  // The position still wraps around, only the sprite is cut off.
+  this->chip_.V_[0x0] = SCREEN_WIDTH + 60;
+  this->chip_.V_[0x1] = SCREEN_HEIGHT - 1;
+  this->chip_.Dxyn<CosmacVipQuirks> (0, 1, 2);
+
+  EXPECT_FALSE(this->chip_.V_[0x0F]);
+  EXPECT_EQ(this->chip_.display_[SCREEN_HEIGHT - 1], 0b1111);
+  EXPECT_EQ(this->chip_.display_[0], 0);
+  EXPECT_EQ(this->chip_.take_dirty_rows (), 1u << (SCREEN_HEIGHT - 1));
 }
 
 TEST_F(InstructionTest, SkipIfXKeyIsPressed_True) {
@@ -334,6 +424,17 @@ TEST_F(InstructionTest, SkipIfXKeyIsNotPressed_False) {
   }
 }
 
+TEST_F(InstructionTest, KeyChecksUseLowNibble) {
+  this->chip_.keypad_[0x3] = true;
+  this->chip_.V_[0x0] = 0xF3;
+
+  this->chip_.Ex9E (0x0);
+  EXPECT_EQ(this->chip_.program_counter_, AFTER_INSTRUCTION_PC + 2);
+
+  this->chip_.ExA1 (0x0);
+  EXPECT_EQ(this->chip_.program_counter_, AFTER_INSTRUCTION_PC + 2);
+}
+
 TEST_F(InstructionTest, StoreDelayTimerIntoX) {
   this->chip_.delay_timer_ = 42;
   this->chip_.Fx07 (0x0);
@@ -360,6 +461,39 @@ TEST_F(InstructionTest, WaitTillKeyPressedThenStoreIntoX_False) {
   }
 }
 
+TEST_F(InstructionTest, WaitsWithoutExecutingUntilAKeyChanges) {
+  this->chip_.initialize ();
+  this->chip_.memory_[MEMORY_PROGRAM_START] = 0xF3;
+  this->chip_.memory_[MEMORY_PROGRAM_START + 1] = 0x0A;
+  this->chip_.memory_[MEMORY_PROGRAM_START + 2] = 0x73;
+  this->chip_.memory_[MEMORY_PROGRAM_START + 3] = 0x01;
+
+  this->chip_.cycle ();
+  EXPECT_TRUE(this->chip_.waiting_for_key ());
+  EXPECT_EQ(this->chip_.program_counter_, MEMORY_PROGRAM_START);
+
+  // Nothing happens, not even the instruction is fetched again.
+  auto waiting = this->chip_;
+  for (auto index = 0; index < 100; index++) {
+    this->chip_.cycle ();
+  }
+  EXPECT_TRUE(this->chip_ == waiting);
+  EXPECT_TRUE(this->chip_.waiting_for_key ());
+
+  // A released key wakes the machine as well, but it goes back to waiting right away.
+  this->chip_.release_key (0x7);
+  EXPECT_FALSE(this->chip_.waiting_for_key ());
+  this->chip_.cycle ();
+  EXPECT_TRUE(this->chip_.waiting_for_key ());
+
+  this->chip_.press_key (0x7);
+  EXPECT_FALSE(this->chip_.waiting_for_key ());
+  this->chip_.cycle ();
+  this->chip_.cycle ();
+  EXPECT_EQ(this->chip_.V_[0x3], 0x8);
+  EXPECT_EQ(this->chip_.program_counter_, MEMORY_PROGRAM_START + 4);
+}
+
 TEST_F(InstructionTest, StoreXIntoDelayTimer) {
   this->chip_.V_[0x0] = 42;
   this->chip_.Fx15 (0x0);
@@ -447,3 +581,136 @@ TEST_F(InstructionTest, StoreIToXIntoRegs) {
     EXPECT_EQ(this->chip_.V_[index], 42 + index);
   }
 }
+
+TEST_F(InstructionTest, IncreasesIByXWithChip48Quirks) {
+  this->chip_.I_ = AFTER_INSTRUCTION_PC;
+  this->chip_.V_[0x2] = 42;
+  this->chip_.Fx55<Chip48Quirks> (0x2);
+
+  EXPECT_EQ(this->chip_.I_, AFTER_INSTRUCTION_PC + 2);
+  EXPECT_EQ(this->chip_.memory_[AFTER_INSTRUCTION_PC + 2], 42);
+}
+
+TEST_F(InstructionTest, KeepsIWithSuperChipQuirks) {
+  this->chip_.I_ = AFTER_INSTRUCTION_PC;
+  this->chip_.memory_[AFTER_INSTRUCTION_PC + 2] = 42;
+  this->chip_.Fx65<SuperChipQuirks> (0x2);
+
+  EXPECT_EQ(this->chip_.I_, AFTER_INSTRUCTION_PC);
+  EXPECT_EQ(this->chip_.V_[0x2], 42);
+}
+
+TEST_F(InstructionTest, DispatchesToTheHandlersOfTheProfile) {
+  // V0 = V1 >> 1 on the COSMAC VIP, V0 = V0 >> 1 otherwise.
+  this->chip_.memory_[MEMORY_PROGRAM_START] = 0x80;
+  this->chip_.memory_[MEMORY_PROGRAM_START + 1] = 0x16;
+  this->chip_.V_[0x1] = 4;
+
+  this->chip_.program_counter_ = MEMORY_PROGRAM_START;
+  this->chip_.cycle ();
+  EXPECT_EQ(this->chip_.quirks (), QuirkProfile::Default);
+  EXPECT_EQ(this->chip_.V_[0x0], 0);
+
+  // The instruction was decoded with the default handler, which must not be used any longer.
+  this->chip_.set_quirks (QuirkProfile::CosmacVip);
+  this->chip_.program_counter_ = MEMORY_PROGRAM_START;
+  this->chip_.cycle ();
+  EXPECT_EQ(this->chip_.quirks (), QuirkProfile::CosmacVip);
+  EXPECT_EQ(this->chip_.V_[0x0], 2);
+
+  // The profile isn't part of the state.
+  this->chip_.initialize ();
+  EXPECT_EQ(this->chip_.quirks (), QuirkProfile::CosmacVip);
+}
+
+TEST(QuirkTest, ParsesProfileNames) {
+  EXPECT_EQ(parse_quirk_profile ("default"), QuirkProfile::Default);
+  EXPECT_EQ(parse_quirk_profile ("vip"), QuirkProfile::CosmacVip);
+  EXPECT_EQ(parse_quirk_profile ("chip48"), QuirkProfile::Chip48);
+  EXPECT_EQ(parse_quirk_profile ("schip"), QuirkProfile::SuperChip);
+  EXPECT_EQ(parse_quirk_profile ("superchip"), std::nullopt);
+}
+
+TEST(OperationTest, DecodesEveryGroup) {
+  EXPECT_EQ(decode_operation (0x00E0), Operation::_00E0);
+  EXPECT_EQ(decode_operation (0x00EE), Operation::_00EE);
+  EXPECT_EQ(decode_operation (0x0123), Operation::_0nnn);
+  EXPECT_EQ(decode_operation (0x1234), Operation::_1nnn);
+  EXPECT_EQ(decode_operation (0x5120), Operation::_5xy0);
+  EXPECT_EQ(decode_operation (0x812E), Operation::_8xyE);
+  EXPECT_EQ(decode_operation (0x9120), Operation::_9xy0);
+  EXPECT_EQ(decode_operation (0xD125), Operation::Dxyn);
+  EXPECT_EQ(decode_operation (0xE1A1), Operation::ExA1);
+  EXPECT_EQ(decode_operation (0xF165), Operation::Fx65);
+}
+
+TEST(OperationTest, DoesNotFallThroughToOtherGroups) {
+  EXPECT_EQ(decode_operation (0x5121), Operation::Invalid);
+  EXPECT_EQ(decode_operation (0x812F), Operation::Invalid);
+  EXPECT_EQ(decode_operation (0x9121), Operation::Invalid);
+  EXPECT_EQ(decode_operation (0xE107), Operation::Invalid);
+  EXPECT_EQ(decode_operation (0xF1FF), Operation::Invalid);
+}
+
+TEST_F(InstructionTest, IgnoresSystemCall) {
+  this->chip_.execute (Instruction::decode (0x0123));
+
+  ASSERT_EQ(this->chip_.program_counter_, AFTER_INSTRUCTION_PC);
+}
+
+TEST_F(InstructionTest, RejectsUnknownOpcodes) {
+  this->chip_.program_counter_ = AFTER_INSTRUCTION_PC;
+  this->chip_.execute (Instruction::decode (0x812F));
+
+  ASSERT_EQ(this->chip_.program_counter_, MEMORY_PROGRAM_START);
+  ASSERT_EQ(this->chip_.fault (),
+            (Fault{MEMORY_PROGRAM_START, 0x812F, FaultReason::UnknownOpcode}));
+
+  this->chip_.initialize ();
+  ASSERT_FALSE(this->chip_.fault ());
+}
+
+TEST_F(InstructionTest, ExecutesSelfModifiedCode) {
+  this->chip_.memory_[0x300] = 0x61;
+  this->chip_.memory_[0x301] = 0x11;
+
+  this->chip_.program_counter_ = 0x300;
+  this->chip_.cycle ();
+
+  EXPECT_EQ(this->chip_.V_[0x1], 0x11);
+
+  this->chip_.I_ = 0x300;
+  this->chip_.V_[0x0] = 0x62;
+  this->chip_.V_[0x1] = 0x22;
+  this->chip_.Fx55 (0x1);
+
+  this->chip_.program_counter_ = 0x300;
+  this->chip_.cycle ();
+
+  EXPECT_EQ(this->chip_.V_[0x2], 0x22);
+}
+
+TEST_F(InstructionTest, ExecutesFromOddAddress) {
+  this->chip_.memory_[0x301] = 0x61;
+  this->chip_.memory_[0x302] = 0x11;
+
+  this->chip_.program_counter_ = 0x301;
+  this->chip_.cycle ();
+
+  EXPECT_EQ(this->chip_.V_[0x1], 0x11);
+  EXPECT_EQ(this->chip_.program_counter_, 0x303);
+}
+
+TEST_F(InstructionTest, TimersStopAtZero) {
+  this->chip_.delay_timer_ = 2;
+  this->chip_.sound_timer_ = 1;
+
+  this->chip_.tick_timers ();
+  EXPECT_EQ(this->chip_.delay_timer_, 1);
+  EXPECT_EQ(this->chip_.sound_timer_, 0);
+
+  this->chip_.tick_timers ();
+  this->chip_.tick_timers ();
+  EXPECT_EQ(this->chip_.delay_timer_, 0);
+  EXPECT_EQ(this->chip_.sound_timer_, 0);
+}
@@ -0,0 +1,88 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "counters.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "engine.h"
+
+TEST(CountersTest, NamesEveryOperation) {
+  EXPECT_STREQ(operation_name (Operation::Invalid), "invalid");
+  EXPECT_STREQ(operation_name (Operation::_8xy4), "8xy4");
+  EXPECT_STREQ(operation_name (decode_operation (0xF265)), "Fx65");
+}
+
+#if CHIP8_COUNTERS
+TEST(CountersTest, CountsOperationsAddressesAndPixels) {
+  const std::vector<uint8_t> program = {
+      0x60, 0x05, // V0 = 5
+      0xA0, 0x00, // I = 0x000, the sprite of 0
+      0xD0, 0x05, // draw 5 bytes at V0, V0
+      0x70, 0x01, // V0 += 1
+      0x12, 0x04, // jump 0x204
+  };
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (program);
+  for (auto cycle = 0; cycle < 2 + 3 * 10; cycle++) {
+    chip.cycle ();
+  }
+
+  const auto &counters = chip.counters ();
+  EXPECT_EQ(counters.operations[(size_t)Operation::_6xkk], 1);
+  EXPECT_EQ(counters.operations[(size_t)Operation::Annn], 1);
+  EXPECT_EQ(counters.operations[(size_t)Operation::Dxyn], 10);
+  EXPECT_EQ(counters.operations[(size_t)Operation::_7xkk], 10);
+  EXPECT_EQ(counters.addresses[0x204], 10);
+  EXPECT_EQ(counters.addresses[0x200], 1);
+
+  // The sprite of 0 has 14 pixels, and every draw overlaps the previous one, shifted by one.
+  EXPECT_EQ(counters.pixels_drawn, 10 * 14);
+  EXPECT_EQ(counters.collisions, 9);
+
+  std::ostringstream report;
+  write_counters (report, counters);
+  EXPECT_NE(report.str ().find ("Dxyn"), std::string::npos);
+  EXPECT_NE(report.str ().find ("204"), std::string::npos);
+}
+
+TEST(CountersTest, CountsOddAddressesAndOnlyTheDrawingOfOtherEngines) {
+  const std::vector<uint8_t> program = {
+      0x60, 0x05, // 0x200: V0 = 5
+      0x12, 0x05, // 0x202: jump 0x205
+      0x00, 0xA0, // 0x204: 0x205: I = 0x000, the sprite of 0
+      0x00, 0xD0, // 0x206: 0x207: draw 5 bytes at V0, V0
+      0x05, 0x12, // 0x208: 0x209: jump 0x200
+      0x00,
+  };
+
+  Chip8 interpreted;
+  interpreted.initialize ();
+  interpreted.load_game (program);
+  for (auto cycle = 0; cycle < 5 * 100; cycle++) {
+    interpreted.cycle ();
+  }
+
+  EXPECT_EQ(interpreted.counters ().addresses[0x205], 100);
+  EXPECT_EQ(interpreted.counters ().addresses[0x207], 100);
+  EXPECT_EQ(interpreted.counters ().operations[(size_t)Operation::Dxyn], 100);
+
+  // The threaded engine doesn't go through cycle, but every draw is still counted.
+  Chip8 threaded;
+  threaded.initialize ();
+  threaded.load_game (program);
+  make_engine (EngineType::Threaded)->run (threaded, 5 * 100);
+
+  EXPECT_EQ(threaded.counters ().operations[(size_t)Operation::Dxyn], 0);
+  EXPECT_EQ(threaded.counters ().addresses[0x207], 0);
+  EXPECT_EQ(threaded.counters ().pixels_drawn, interpreted.counters ().pixels_drawn);
+  EXPECT_EQ(threaded.counters ().collisions, interpreted.counters ().collisions);
+}
+#endif
@@ -0,0 +1,184 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "engine.h"
+
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+#include "programs.h"
+
+class EngineTest : public ::testing::TestWithParam<EngineType> {
+ protected:
+  /**
+   * Runs the program once with the interpreter and once with the tested engine. The tested engine
+   * is called with the given amount of cycles at a time, so superblocks are also cut off.
+   */
+  void expect_same_state (const std::vector<uint8_t> &program, uint64_t cycles, uint64_t chunk,
+                          QuirkProfile quirks = QuirkProfile::Default) {
+    auto expected = std::make_unique<Chip8> ();
+    auto actual = std::make_unique<Chip8> ();
+
+    for (auto *chip : {expected.get (), actual.get ()}) {
+      chip->initialize ();
+      chip->set_quirks (quirks);
+      chip->load_game (program);
+      chip->press_key (0x5);
+    }
+
+    InterpreterEngine interpreter;
+    interpreter.run (*expected, cycles);
+
+    auto engine = make_engine (GetParam ());
+    for (uint64_t executed = 0; executed < cycles; executed += chunk) {
+      engine->run (*actual, std::min (chunk, cycles - executed));
+    }
+
+    EXPECT_TRUE(*expected == *actual);
+  }
+};
+
+TEST_P(EngineTest, MatchesInterpreterOnRandomPrograms) {
+  for (auto seed = 0u; seed < 200; seed++) {
+    expect_same_state (random_program (seed, 64), 5000, 5000);
+    expect_same_state (random_program (seed, 64), 5000, 7);
+  }
+}
+
+TEST_P(EngineTest, MatchesInterpreterWithEveryQuirkProfile) {
+  for (auto profile = 0u; profile < (unsigned)QuirkProfile::Count; profile++) {
+    for (auto seed = 0u; seed < 50; seed++) {
+      expect_same_state (random_program (seed, 64), 5000, 7, (QuirkProfile)profile);
+    }
+  }
+}
+
+TEST_P(EngineTest, RetranslatesWhenTheProfileChanges) {
+  // V0 = 0x81, then V1 = V1 << 1 or V1 = V0 << 1 in a loop, which is hot enough to be translated.
+  const std::vector<uint8_t> program = {0x60, 0x81, 0x81, 0x0E, 0x12, 0x02};
+
+  auto expected = std::make_unique<Chip8> ();
+  auto actual = std::make_unique<Chip8> ();
+  for (auto *chip : {expected.get (), actual.get ()}) {
+    chip->initialize ();
+    chip->load_game (program);
+  }
+
+  InterpreterEngine interpreter;
+  auto engine = make_engine (GetParam ());
+  for (auto quirks : {QuirkProfile::Default, QuirkProfile::CosmacVip, QuirkProfile::Default}) {
+    expected->set_quirks (quirks);
+    actual->set_quirks (quirks);
+
+    interpreter.run (*expected, 1000);
+    engine->run (*actual, 1000);
+    EXPECT_TRUE(*expected == *actual);
+  }
+}
+
+TEST_P(EngineTest, MatchesInterpreterOnSubroutinesAndTimers) {
+  std::vector<uint8_t> program = {
+      0x60, 0x1E, // V0 = 30
+      0xF0, 0x15, // DT = V0
+      0x22, 0x10, // call 0x210
+      0xF1, 0x07, // V1 = DT
+      0x31, 0x00, // skip if V1 == 0
+      0x12, 0x04, // jump 0x204
+      0x12, 0x00, // jump 0x200
+      0x00, 0x00,
+      0xA4, 0x00, // I = 0x400
+      0xF2, 0x33, // BCD of V2
+      0xF2, 0x65, // V0-V2 = BCD
+      0x72, 0x01, // V2 += 1
+      0xD0, 0x15, // draw
+      0x00, 0xEE, // return
+  };
+
+  expect_same_state (program, 100000, 100000);
+  expect_same_state (program, 100000, 3);
+}
+
+TEST_P(EngineTest, MatchesInterpreterOnSelfModifyingCode) {
+  std::vector<uint8_t> program = {
+      0x60, 0x62, // V0 = 0x62
+      0x61, 0x00, // V1 = 0
+      0x71, 0x01, // V1 += 1
+      0xA2, 0x20, // I = 0x220
+      0xF1, 0x55, // store V0-V1 at 0x220, which changes the code
+      0x12, 0x20, // jump 0x220
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00,
+      0x00, 0x00, // overwritten with V2 = V1
+      0x73, 0x01, // V3 += 1
+      0x12, 0x04, // jump 0x204
+  };
+
+  expect_same_state (program, 100000, 100000);
+  expect_same_state (program, 100000, 5);
+}
+
+TEST_P(EngineTest, StopsWhileWaitingForAKey) {
+  std::vector<uint8_t> program = {
+      0x70, 0x01, // V0 += 1
+      0xF1, 0x0A, // V1 = key
+      0x81, 0x04, // V1 += V0
+      0x12, 0x00, // jump 0x200
+  };
+
+  auto expected = std::make_unique<Chip8> ();
+  auto actual = std::make_unique<Chip8> ();
+  for (auto *chip : {expected.get (), actual.get ()}) {
+    chip->initialize ();
+    chip->load_game (program);
+  }
+
+  InterpreterEngine interpreter;
+  auto engine = make_engine (GetParam ());
+  for (auto step = 0; step < 20; step++) {
+    // While the key is held the loop keeps going, once it is released the machine waits.
+    auto pressed = step % 2 == 1;
+    interpreter.run (*expected, 1000);
+    engine->run (*actual, 1000);
+    ASSERT_EQ(actual->waiting_for_key (), !pressed) << "step " << step;
+    ASSERT_TRUE(*expected == *actual) << "step " << step;
+
+    for (auto *chip : {expected.get (), actual.get ()}) {
+      if (pressed) {
+        chip->release_key ((uint8_t)step);
+      } else {
+        chip->press_key ((uint8_t)(step + 1));
+      }
+    }
+  }
+}
+
+TEST_P(EngineTest, RetranslatesForANewMachineAtTheSameAddress) {
+  // V0 = 0x11 or V0 = 0x22 in a loop, which is hot enough to be translated.
+  const std::vector<std::vector<uint8_t>> programs = {
+      {0x60, 0x11, 0x12, 0x00},
+      {0x60, 0x22, 0x12, 0x00},
+  };
+
+  InterpreterEngine interpreter;
+  auto engine = make_engine (GetParam ());
+  for (const auto &program : programs) {
+    auto expected = std::make_unique<Chip8> ();
+    expected->initialize ();
+    expected->load_game (program);
+    interpreter.run (*expected, 1000);
+
+    // Lives in the same stack slot in every iteration, with the same page versions.
+    Chip8 actual;
+    actual.initialize ();
+    actual.load_game (program);
+    engine->run (actual, 1000);
+
+    EXPECT_TRUE(*expected == actual);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, EngineTest, ::testing::Values (EngineType::Threaded,
+                                                                  EngineType::Jit));
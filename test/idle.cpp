@@ -0,0 +1,165 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "idle.h"
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "programs.h"
+#include "scheduler.h"
+
+/**
+ * Runs the program for the given amount of frames, once executing every instruction and once
+ * skipping the idle loops. Both machines have to end up the same after every frame.
+ *
+ * @return The amount of skipped instructions.
+ */
+static uint64_t expect_same_frames (const std::vector<uint8_t> &program, uint32_t frames,
+                                    EngineType type = EngineType::Interpreter) {
+  auto expected = std::make_unique<Chip8> ();
+  auto actual = std::make_unique<Chip8> ();
+  for (auto *chip : {expected.get (), actual.get ()}) {
+    chip->initialize ();
+    chip->load_game (program);
+  }
+
+  InterpreterEngine interpreter;
+  auto engine = make_engine (type);
+  IdleSkipper skipper (*engine);
+
+  Scheduler expected_scheduler (1000), actual_scheduler (1000);
+  for (auto frame = 0u; frame < frames; frame++) {
+    // A key is pressed for a while now and then.
+    if (frame % 50 == 40) {
+      expected->press_key (frame % KEYPAD_SIZE);
+      actual->press_key (frame % KEYPAD_SIZE);
+    } else if (frame % 50 == 45) {
+      expected->release_key ((frame - 5) % KEYPAD_SIZE);
+      actual->release_key ((frame - 5) % KEYPAD_SIZE);
+    }
+
+    expected_scheduler.run (*expected, interpreter, expected_scheduler.cycles_until_tick ());
+    actual_scheduler.run (*actual, skipper, actual_scheduler.cycles_until_tick ());
+    EXPECT_TRUE(*expected == *actual) << "frame " << frame;
+    if (!(*expected == *actual)) {
+      break;
+    }
+  }
+
+  return skipper.skipped ();
+}
+
+TEST(IdleTest, SkipsWaitingForTheDelayTimer) {
+  const std::vector<uint8_t> program = {
+      0x62, 0x1E, // 0x200: V2 = 30
+      0xF2, 0x15, // 0x202: delay timer = V2
+      0xF3, 0x07, // 0x204: V3 = delay timer
+      0x33, 0x00, // 0x206: skip if V3 == 0
+      0x12, 0x04, // 0x208: jump 0x204
+      0x74, 0x01, // 0x20A: V4 += 1
+      0x12, 0x02, // 0x20C: jump 0x202
+  };
+
+  // Nearly every frame is spent waiting, only parts of an iteration at its ends are executed.
+  EXPECT_GT(expect_same_frames (program, 300), 300 * 1000 / 60 * 8 / 10);
+
+  // The other way around, the loop waits as long as the timer is 0, which is forever here.
+  const std::vector<uint8_t> inverted = {
+      0xF3, 0x07, // 0x200: V3 = delay timer
+      0x43, 0x00, // 0x202: skip if V3 != 0
+      0x12, 0x00, // 0x204: jump 0x200
+  };
+
+  EXPECT_GT(expect_same_frames (inverted, 300), 300 * 1000 / 60 * 8 / 10);
+}
+
+TEST(IdleTest, SkipsWaitingForAKey) {
+  const std::vector<uint8_t> program = {
+      0xF5, 0x0A, // 0x200: V5 = next key
+      0x75, 0x01, // 0x202: V5 += 1
+      0x12, 0x00, // 0x204: jump 0x200
+  };
+
+  auto skipped = expect_same_frames (program, 300);
+  EXPECT_GT(skipped, 0);
+}
+
+TEST(IdleTest, KeepsWaitingAfterAQuickTap) {
+  const std::vector<uint8_t> program = {
+      0xF5, 0x0A, // 0x200: V5 = next key
+      0x12, 0x00, // 0x202: jump 0x200
+  };
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (program);
+
+  InterpreterEngine interpreter;
+  IdleSkipper skipper (interpreter);
+  skipper.run (chip, 100);
+  ASSERT_TRUE(chip.waiting_for_key ());
+
+  // Pressed and released before the next run, so the Fx0A saw no key.
+  chip.press_key (0x3);
+  chip.release_key (0x3);
+  EXPECT_FALSE(chip.waiting_for_key ());
+
+  skipper.run (chip, 100);
+  EXPECT_TRUE(chip.waiting_for_key ());
+}
+
+TEST(IdleTest, SkipsHaltingAndFaults) {
+  const std::vector<uint8_t> halt = {
+      0x60, 0x01, // 0x200: V0 = 1
+      0x12, 0x02, // 0x202: jump 0x202
+  };
+
+  // Only the first frame is executed.
+  EXPECT_GE(expect_same_frames (halt, 100), 99 * 1000 / 60);
+
+  const std::vector<uint8_t> fault = {
+      0x60, 0x01, // 0x200: V0 = 1
+      0xFF, 0xFF, // 0x202: unknown
+  };
+
+  EXPECT_GE(expect_same_frames (fault, 100), 99 * 1000 / 60);
+}
+
+TEST(IdleTest, FindsOnlyLoopsWhichCantEnd) {
+  const std::vector<uint8_t> program = {
+      0xF3, 0x07, // 0x200: V3 = delay timer
+      0x33, 0x00, // 0x202: skip if V3 == 0
+      0x12, 0x00, // 0x204: jump 0x200
+  };
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (program);
+
+  // With the timer at 0 the loop ends right away.
+  EXPECT_FALSE(IdleSkipper::find_loop (chip));
+
+  chip.delay_timer_ = 5;
+  for (auto step = 0; step < 3; step++) {
+    auto loop = IdleSkipper::find_loop (chip);
+    ASSERT_TRUE(loop);
+    EXPECT_EQ(loop->start, 0x200);
+    EXPECT_EQ(loop->length, 3);
+    chip.cycle ();
+  }
+
+  chip.program_counter_ = 0x206;
+  EXPECT_FALSE(IdleSkipper::find_loop (chip));
+}
+
+TEST(IdleTest, MatchesEveryEngineOnRandomPrograms) {
+  for (auto type : {EngineType::Interpreter, EngineType::Threaded, EngineType::Jit}) {
+    for (auto seed = 0u; seed < 20; seed++) {
+      expect_same_frames (random_program (seed, 32), 120, type);
+    }
+  }
+}
@@ -0,0 +1,90 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "keymap.h"
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+// The scancodes of 1-4, Q-R, A-F and Z-V, as SDL numbers them.
+static constexpr KeyMap HEX_KEYPAD ({
+    27, 30, 31, 32,
+    20, 26, 8, 4,
+    22, 7, 29, 6,
+    33, 21, 9, 25,
+});
+
+static_assert(HEX_KEYPAD.map (30) == 0x1);
+static_assert(HEX_KEYPAD.map (25) == 0xF);
+static_assert(!HEX_KEYPAD.map (5));
+
+/**
+ * Resolves the names "Key<n>" to the scancode n.
+ */
+static std::optional<uint16_t> resolve (const std::string &name) {
+  if (name.rfind ("Key", 0) != 0) {
+    return std::nullopt;
+  }
+
+  return (uint16_t)std::stoi (name.substr (3));
+}
+
+TEST(KeyMapTest, MapsEveryScancode) {
+  // Every Chip-8 key is pressed by exactly one host key.
+  std::array<int, KEYPAD_SIZE> hosts{};
+  for (auto scancode = 0u; scancode < KEY_MAP_SCANCODES; scancode++) {
+    if (auto key = HEX_KEYPAD.map (scancode)) {
+      hosts[*key]++;
+    }
+  }
+
+  for (auto count : hosts) {
+    EXPECT_EQ(count, 1);
+  }
+
+  EXPECT_EQ(HEX_KEYPAD.map (27), 0x0);
+  EXPECT_EQ(HEX_KEYPAD.map (6), 0xB);
+  EXPECT_FALSE(HEX_KEYPAD.map (KEY_MAP_SCANCODES));
+  EXPECT_FALSE(HEX_KEYPAD.map (0x40000052));
+}
+
+TEST(KeyMapTest, LoadsRemappedKeys) {
+  auto map = HEX_KEYPAD;
+  std::istringstream config ("# Arrows for the movement\n"
+                             "\n"
+                             "5 Key82\n"
+                             "  8\tKey81  \n"
+                             "5 Key100\n");
+  ASSERT_TRUE(map.load (config, resolve));
+
+  // The old key of a remapped Chip-8 key is free, both new ones press it.
+  EXPECT_FALSE(map.map (26));
+  EXPECT_EQ(map.map (82), 0x5);
+  EXPECT_EQ(map.map (100), 0x5);
+  EXPECT_FALSE(map.map (22));
+  EXPECT_EQ(map.map (81), 0x8);
+
+  // Everything else stays.
+  EXPECT_EQ(map.map (30), 0x1);
+  EXPECT_EQ(map.map (25), 0xF);
+}
+
+TEST(KeyMapTest, RejectsInvalidLines) {
+  for (const auto *line : {"5", "G Key82", "10 Key82", "5 Unknown", "5 Key600"}) {
+    auto map = HEX_KEYPAD;
+    std::istringstream config (std::string ("1 Key90\n") + line + "\n");
+
+    auto loaded = map.load (config, resolve);
+    ASSERT_FALSE(loaded) << line;
+    EXPECT_EQ(loaded.error ().rfind ("line 2: ", 0), 0) << loaded.error ();
+
+    // Nothing of the configuration is applied.
+    EXPECT_EQ(map.map (30), 0x1);
+    EXPECT_FALSE(map.map (90));
+  }
+
+  auto map = HEX_KEYPAD;
+  EXPECT_FALSE(map.load_file ("/nonexistent/keys.txt", resolve));
+}
@@ -0,0 +1,84 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "lockstep.h"
+
+#include "gtest/gtest.h"
+
+#include "programs.h"
+
+/**
+ * Runs the program in every lane with a different key pressed and compares each lane with a
+ * Chip8 that ran the same program on its own.
+ */
+void expect_same_lanes (const std::vector<uint8_t> &program, uint64_t cycles,
+                        QuirkProfile quirks = QuirkProfile::Default) {
+  const size_t lanes = 40;
+
+  LockstepEngine lockstep (lanes);
+  lockstep.load_game (program, quirks);
+  for (size_t lane = 0; lane < lanes; lane++) {
+    lockstep.press_key (lane, lane % KEYPAD_SIZE);
+  }
+
+  // Split into frames, so the timers tick in between.
+  for (uint64_t executed = 0; executed < cycles; executed += 10) {
+    lockstep.run (10);
+    lockstep.tick_timers ();
+  }
+
+  for (size_t lane = 0; lane < lanes; lane++) {
+    auto expected = std::make_unique<Chip8> ();
+    auto actual = std::make_unique<Chip8> ();
+    expected->initialize ();
+    expected->set_quirks (quirks);
+    expected->load_game (program);
+    expected->press_key (lane % KEYPAD_SIZE);
+    for (uint64_t executed = 0; executed < cycles; executed += 10) {
+      for (auto cycle = 0; cycle < 10; cycle++) {
+        expected->cycle ();
+      }
+
+      expected->tick_timers ();
+    }
+
+    lockstep.snapshot (lane, *actual);
+    ASSERT_TRUE(*expected == *actual) << "lane " << lane;
+  }
+}
+
+TEST(LockstepTest, MatchesChip8OnRandomPrograms) {
+  for (auto seed = 0u; seed < 50; seed++) {
+    // Every lane draws from its own random numbers, so the order of the lanes doesn't matter.
+    expect_same_lanes (random_program (seed, 64), 2000);
+  }
+}
+
+TEST(LockstepTest, MatchesChip8WithEveryQuirkProfile) {
+  for (auto profile = 0u; profile < (unsigned)QuirkProfile::Count; profile++) {
+    for (auto seed = 0u; seed < 10; seed++) {
+      expect_same_lanes (random_program (seed, 64), 2000, (QuirkProfile)profile);
+    }
+  }
+}
+
+TEST(LockstepTest, ReadsModifiedCodeFromTheLane) {
+  // Either only the lanes with key 0 pressed or all the others overwrite the instruction at 0x20E.
+  // Afterwards they execute a different instruction at the same address as the other lanes.
+  for (uint8_t condition : {0x9E, 0xA1}) {
+    std::vector<uint8_t> program = {
+        0x60, 0x71,      // V0 = 0x71
+        0x61, 0x05,      // V1 = 0x05
+        0xA2, 0x0E,      // I = 0x20E
+        0xE2, condition, // skip if key V2 is (not) pressed
+        0x12, 0x0C,      // jump 0x20C
+        0xF1, 0x55,      // store V0 and V1 at 0x20E
+        0x6F, 0x00,      // VF = 0
+        0x72, 0x01,      // V2 += 1, becomes V1 += 5
+        0x12, 0x0E,      // jump 0x20E
+    };
+
+    expect_same_lanes (program, 200);
+  }
+}
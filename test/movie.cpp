@@ -0,0 +1,116 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "movie.h"
+
+#include <cstdio>
+#include <random>
+
+#include "gtest/gtest.h"
+
+#include "programs.h"
+#include "scheduler.h"
+
+/**
+ * Plays a random program like a player would: the frames are of uneven length and keys are
+ * pressed and released between them.
+ */
+static Movie record (uint32_t seed, Chip8 &chip, uint32_t hash_interval) {
+  chip.initialize ();
+  chip.load_game (random_program (seed, 64));
+
+  InterpreterEngine engine;
+  MovieRecorder recorder (chip, engine, 600, seed * 7 + 3, hash_interval);
+  Scheduler scheduler (600);
+
+  std::mt19937 random (seed);
+  for (auto step = 0; step < 200; step++) {
+    scheduler.run (chip, recorder, random () % 40);
+
+    auto key = (uint8_t)(random () % KEYPAD_SIZE);
+    if (random () % 2) {
+      recorder.press_key (chip, key);
+    } else {
+      recorder.release_key (chip, key);
+    }
+  }
+
+  return recorder.finish (chip);
+}
+
+TEST(MovieTest, ReplaysBitIdentical) {
+  for (auto seed = 0u; seed < 20; seed++) {
+    Chip8 recorded;
+    auto movie = record (seed, recorded, 5);
+    ASSERT_FALSE(movie.hashes.empty ());
+
+    for (auto type : {EngineType::Interpreter, EngineType::Threaded, EngineType::Jit}) {
+      Chip8 chip;
+      chip.initialize ();
+      chip.load_game (random_program (seed, 64));
+
+      auto engine = make_engine (type);
+      auto result = replay_movie (movie, chip, *engine);
+      EXPECT_TRUE(result.matches ()) << "seed " << seed;
+      EXPECT_EQ(result.checked_hashes, movie.hashes.size ()) << "seed " << seed;
+      EXPECT_TRUE(chip == recorded) << "seed " << seed;
+    }
+  }
+}
+
+TEST(MovieTest, ReplaysWithTheRecordedQuirks) {
+  Chip8 recorded;
+  recorded.set_quirks (QuirkProfile::CosmacVip);
+  auto movie = record (3, recorded, 5);
+  EXPECT_EQ(movie.quirks, QuirkProfile::CosmacVip);
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (random_program (3, 64));
+
+  InterpreterEngine engine;
+  EXPECT_TRUE(replay_movie (movie, chip, engine).matches ());
+  EXPECT_EQ(chip.quirks (), QuirkProfile::CosmacVip);
+  EXPECT_TRUE(chip == recorded);
+}
+
+TEST(MovieTest, FindsTheFirstDifference) {
+  Chip8 recorded;
+  auto movie = record (1, recorded, 1);
+  ASSERT_GT(movie.hashes.size (), 4);
+
+  movie.hashes[3] ^= 1;
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (random_program (1, 64));
+
+  InterpreterEngine engine;
+  auto result = replay_movie (movie, chip, engine);
+  EXPECT_FALSE(result.matches ());
+  EXPECT_EQ(result.mismatch_frame, 4);
+  EXPECT_TRUE(result.final_matches);
+
+  // Another game is detected right away.
+  chip.initialize ();
+  chip.load_game (random_program (2, 64));
+  EXPECT_FALSE(replay_movie (movie, chip, engine).game_matches);
+}
+
+TEST(MovieTest, RoundTripsThroughAFile) {
+  auto path = ::testing::TempDir () + "chip8_movie_test.c8m";
+
+  Chip8 recorded;
+  recorded.set_quirks (QuirkProfile::SuperChip);
+  auto movie = record (4, recorded, 10);
+  ASSERT_TRUE(movie.save (path));
+
+  Movie loaded{};
+  ASSERT_TRUE(loaded.load (path));
+  EXPECT_TRUE(loaded == movie);
+
+  std::remove (path.c_str ());
+  EXPECT_FALSE(loaded.load (path));
+  EXPECT_TRUE(loaded == movie);
+}
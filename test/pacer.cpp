@@ -0,0 +1,32 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "pacer.h"
+
+#include "gtest/gtest.h"
+
+TEST(FramePacerTest, StaysOnTheGrid) {
+  FramePacer pacer (100);
+  auto start = pacer.deadline_;
+
+  // Waking up a bit late every frame doesn't move the following deadlines.
+  for (auto frame = 1; frame <= 100; frame++) {
+    auto late = pacer.deadline_ + std::chrono::milliseconds (3);
+    EXPECT_EQ(pacer.catch_up (late), 1);
+    EXPECT_EQ(pacer.deadline_, start + frame * pacer.period ());
+  }
+}
+
+TEST(FramePacerTest, CatchesUpWithinLimits) {
+  FramePacer pacer (100);
+  auto start = pacer.deadline_;
+
+  EXPECT_EQ(pacer.catch_up (start + 2 * pacer.period ()), 3);
+  EXPECT_EQ(pacer.deadline_, start + 3 * pacer.period ());
+
+  // Far behind, only a few frames are caught up and the grid starts over.
+  auto now = pacer.deadline_ + 100 * pacer.period ();
+  EXPECT_EQ(pacer.catch_up (now), PACER_MAX_CATCH_UP_FRAMES);
+  EXPECT_EQ(pacer.deadline_, now + pacer.period ());
+}
@@ -0,0 +1,44 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "pixels.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(PixelsTest, ConvertsRowsRespectingPitch) {
+  std::array<DisplayRow, SCREEN_HEIGHT> display{};
+  display[0] = (DisplayRow)1 << 63 | 1;
+  display[SCREEN_HEIGHT - 1] = (DisplayRow)0b101 << 61;
+
+  // Every row has some padding after its pixels, which has to stay untouched.
+  const size_t stride = SCREEN_WIDTH + 3;
+  std::vector<uint32_t> pixels (stride * SCREEN_HEIGHT, 42);
+  convert_display (display, 0, SCREEN_HEIGHT - 1, pixels.data (), stride * sizeof (uint32_t));
+
+  EXPECT_EQ(pixels[0], PIXEL_ON);
+  EXPECT_EQ(pixels[1], PIXEL_OFF);
+  EXPECT_EQ(pixels[SCREEN_WIDTH - 1], PIXEL_ON);
+  EXPECT_EQ(pixels[SCREEN_WIDTH], 42);
+  EXPECT_EQ(pixels[stride], PIXEL_OFF);
+
+  const auto *last = &pixels[stride * (SCREEN_HEIGHT - 1)];
+  EXPECT_EQ(last[0], PIXEL_ON);
+  EXPECT_EQ(last[1], PIXEL_OFF);
+  EXPECT_EQ(last[2], PIXEL_ON);
+  EXPECT_EQ(last[3], PIXEL_OFF);
+}
+
+TEST(PixelsTest, ConvertsOnlyTheGivenRows) {
+  std::array<DisplayRow, SCREEN_HEIGHT> display{};
+  display[4] = (DisplayRow)1 << 63;
+
+  std::vector<uint32_t> pixels (SCREEN_WIDTH * 3, 42);
+  convert_display (display, 3, 4, pixels.data (), SCREEN_WIDTH * sizeof (uint32_t));
+
+  EXPECT_EQ(pixels[0], PIXEL_OFF);
+  EXPECT_EQ(pixels[SCREEN_WIDTH], PIXEL_ON);
+  EXPECT_EQ(pixels[SCREEN_WIDTH * 2], 42);
+}
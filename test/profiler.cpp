@@ -0,0 +1,92 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "profiler.h"
+
+#include <sstream>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "programs.h"
+
+TEST(ProfilerTest, AttributesCyclesToSubroutines) {
+  const std::vector<uint8_t> program = {
+      0x22, 0x06, // 0x200: call 0x206
+      0x12, 0x00, // 0x202: jump 0x200
+      0x00, 0x00, // 0x204: unused
+      0x70, 0x01, // 0x206: V0 += 1
+      0x22, 0x0E, // 0x208: call 0x20E
+      0x00, 0xEE, // 0x20A: return
+      0x00, 0x00, // 0x20C: unused
+      0x71, 0x01, // 0x20E: V1 += 1
+      0x72, 0x01, // 0x210: V2 += 1
+      0x00, 0xEE, // 0x212: return
+  };
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (program);
+
+  // One round is 2 cycles in main, 3 in 0x206 and 3 in 0x20E.
+  GuestProfiler profiler;
+  profiler.run (chip, 8 * 100);
+
+  std::ostringstream folded;
+  profiler.write_folded (folded);
+  EXPECT_EQ(folded.str (), "main 200\nmain;0x206 300\nmain;0x206;0x20E 300\n");
+
+  EXPECT_EQ(profiler.total_cycles (), 800);
+  EXPECT_EQ(profiler.inclusive_cycles (0x206), 600);
+  EXPECT_EQ(profiler.inclusive_cycles (0x20E), 300);
+  EXPECT_EQ(profiler.inclusive_cycles (0x300), 0);
+}
+
+TEST(ProfilerTest, CountsRecursionOnce) {
+  const std::vector<uint8_t> program = {
+      0x60, 0x03, // 0x200: V0 = 3
+      0x22, 0x06, // 0x202: call 0x206
+      0x12, 0x00, // 0x204: jump 0x200
+      0x30, 0x00, // 0x206: skip if V0 == 0
+      0x12, 0x0C, // 0x208: jump 0x20C
+      0x00, 0xEE, // 0x20A: return
+      0x70, 0xFF, // 0x20C: V0 -= 1
+      0x22, 0x06, // 0x20E: call 0x206
+      0x00, 0xEE, // 0x210: return
+  };
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (program);
+
+  GuestProfiler profiler;
+  profiler.run (chip, 1000);
+
+  EXPECT_EQ(profiler.total_cycles (), 1000);
+  EXPECT_LE(profiler.inclusive_cycles (0x206), profiler.total_cycles ());
+
+  // The innermost call shows up with the whole path of recursive calls.
+  std::ostringstream folded;
+  profiler.write_folded (folded);
+  EXPECT_NE(folded.str ().find ("main;0x206;0x206;0x206;0x206 "), std::string::npos);
+}
+
+TEST(ProfilerTest, LeavesTheSameStateAsTheInterpreter) {
+  for (auto seed = 0u; seed < 10; seed++) {
+    Chip8 expected, actual;
+    for (auto *chip : {&expected, &actual}) {
+      chip->initialize ();
+      chip->load_game (random_program (seed, 64));
+    }
+
+    InterpreterEngine interpreter;
+    interpreter.run (expected, 5000);
+
+    GuestProfiler profiler;
+    profiler.run (actual, 5000);
+
+    EXPECT_TRUE(expected == actual) << "seed " << seed;
+    EXPECT_EQ(profiler.total_cycles (), 5000);
+  }
+}
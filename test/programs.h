@@ -0,0 +1,74 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#ifndef _PROGRAMS_H_
+#define _PROGRAMS_H_
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * Generates a program consisting of random, but valid instructions. Calls, returns, computed
+ * jumps and memory writes are left out, so the program can neither overflow the stack nor jump
+ * into data. All jumps stay inside the program and the last instruction jumps back to the start.
+ * The key checks (Ex9E, ExA1) always test VE, which is only ever loaded with a key number.
+ *
+ * @param [in] seed         The seed of the random number generator.
+ * @param [in] instructions The amount of instructions to generate.
+ * @return The bytes of the program.
+ */
+inline std::vector<uint8_t> random_program (uint32_t seed, size_t instructions) {
+  static constexpr uint16_t TEMPLATES[] = {
+      0x00E0, 0x1000, 0x3000, 0x4000, 0x5000, 0x6000, 0x7000, 0x8000, 0x8001, 0x8002, 0x8003,
+      0x8004, 0x8005, 0x8006, 0x8007, 0x800E, 0x9000, 0xA000, 0xC000, 0xD000, 0xE09E, 0xE0A1,
+      0xF007, 0xF015, 0xF018, 0xF01E, 0xF029, 0xF065,
+  };
+
+  std::mt19937 random (seed);
+  std::vector<uint8_t> program;
+
+  for (auto index = 0u; index < instructions; index++) {
+    uint16_t opcode = TEMPLATES[random () % std::size (TEMPLATES)];
+    switch (opcode >> 12) {
+    case 0x1: opcode |= 0x200 + 2 * (random () % instructions); break;
+    case 0x3:
+    case 0x4:
+    case 0x6:
+    case 0x7:
+    case 0xA:
+    case 0xC:
+    case 0xD: opcode |= random () % 0x1000; break;
+    case 0x5:
+    case 0x8:
+    case 0x9: opcode |= (random () % 0x100) << 4; break;
+    case 0xE: opcode |= 0xE << 8; break;
+    case 0xF: opcode |= (random () % 0x10) << 8; break;
+    default: break;
+    }
+
+    // Keeps VE below KEYPAD_SIZE: 6Ekk loads a key number, the other writes use VD instead.
+    auto x = (opcode >> 8) & 0xF;
+    auto writes_x = (opcode >> 12) == 0x6 || (opcode >> 12) == 0x7 || (opcode >> 12) == 0x8
+                    || (opcode >> 12) == 0xC || (opcode & 0xF0FF) == 0xF007;
+    if ((opcode >> 12) == 0x6 && x == 0xE) {
+      opcode &= 0xFF0F;
+    } else if ((writes_x && x == 0xE) || ((opcode & 0xF0FF) == 0xF065 && x >= 0xE)) {
+      opcode = (opcode & 0xF0FF) | 0xD00;
+    }
+
+    program.push_back (opcode >> 8);
+    program.push_back (opcode & 0xFF);
+  }
+
+  // Twice, as a skip could jump over the first one.
+  for (auto index = 0u; index < 2; index++) {
+    program.push_back (0x12);
+    program.push_back (0x00);
+  }
+
+  return program;
+}
+
+#endif //_PROGRAMS_H_
@@ -0,0 +1,62 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "recompiler.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(RecompilerTest, FollowsJumpsCallsAndSkips) {
+  const std::vector<uint8_t> rom = {
+      0x22, 0x08, // 0x200: call 0x208
+      0x30, 0x01, // 0x202: skip if V0 == 1
+      0x12, 0x04, // 0x204: jump 0x204
+      0x12, 0x06, // 0x206: jump 0x206
+      0x00, 0xEE, // 0x208: return
+      0xFF, 0xFF, // 0x20A: data
+  };
+
+  auto map = analyse_rom (rom);
+
+  EXPECT_EQ(map.instructions, (std::set<uint16_t>{0x200, 0x202, 0x204, 0x206, 0x208}));
+  EXPECT_EQ(map.leaders, (std::set<uint16_t>{0x200, 0x202, 0x204, 0x206, 0x208}));
+}
+
+TEST(RecompilerTest, StopsAtComputedJumps) {
+  const std::vector<uint8_t> rom = {
+      0x60, 0x02, // 0x200: V0 = 2
+      0xB2, 0x04, // 0x202: jump 0x204 + V0
+      0x60, 0x03, // 0x204: V0 = 3
+      0x12, 0x06, // 0x206: jump 0x206
+  };
+
+  auto map = analyse_rom (rom);
+  EXPECT_EQ(map.instructions, (std::set<uint16_t>{0x200, 0x202}));
+
+  // The computed jump is executed by the Chip8 class, afterwards the target is looked up.
+  auto source = translate_rom (rom, "test");
+  EXPECT_NE(source.find ("case 0x200: goto block_200;"), std::string::npos);
+  EXPECT_NE(source.find ("AotEngine::execute (chip, 0xB204);\n  goto dispatch;"),
+            std::string::npos);
+  EXPECT_EQ(source.find ("block_204"), std::string::npos);
+}
+
+TEST(RecompilerTest, TranslatesTheShiftsOfTheProfile) {
+  const std::vector<uint8_t> rom = {
+      0x80, 0x16, // 0x200: shift right
+      0x12, 0x00, // 0x202: jump 0x200
+  };
+
+  auto source = translate_rom (rom, "test");
+  EXPECT_NE(source.find ("V[0x0] >>= 1;"), std::string::npos);
+  EXPECT_NE(source.find ("AOT_PROGRAM{ROM, CODE, QuirkProfile::Default, run}"), std::string::npos);
+
+  // The COSMAC VIP shifts Vy into Vx.
+  source = translate_rom (rom, "test", QuirkProfile::CosmacVip);
+  EXPECT_NE(source.find ("auto y_value = V[0x1];"), std::string::npos);
+  EXPECT_NE(source.find ("V[0x0] = y_value >> 1;"), std::string::npos);
+  EXPECT_NE(source.find ("AOT_PROGRAM{ROM, CODE, QuirkProfile::CosmacVip, run}"),
+            std::string::npos);
+}
@@ -0,0 +1,148 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "rewind.h"
+
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "programs.h"
+#include "scheduler.h"
+
+/**
+ * Runs a random program for the given amount of frames and records every frame, including the
+ * initial state.
+ */
+static std::vector<Chip8> record (RewindBuffer &buffer, Chip8 &chip, uint32_t seed,
+                                  uint32_t frames) {
+  chip.initialize ();
+  chip.load_game (random_program (seed, 64));
+
+  InterpreterEngine engine;
+  Scheduler scheduler (600);
+
+  std::vector<Chip8> history = {chip};
+  buffer.push (chip);
+  for (auto frame = 0u; frame < frames; frame++) {
+    scheduler.run (chip, engine, scheduler.cycles_until_tick ());
+    history.push_back (chip);
+    buffer.push (chip);
+  }
+
+  return history;
+}
+
+TEST(RewindTest, StepsBackThroughEveryFrame) {
+  for (auto seed = 0u; seed < 10; seed++) {
+    RewindBuffer buffer (1 << 20);
+    Chip8 chip;
+    auto history = record (buffer, chip, seed, 300);
+    ASSERT_EQ(buffer.frames (), 300);
+
+    for (auto frame = history.size () - 1; frame > 0; frame--) {
+      ASSERT_TRUE(buffer.rewind (chip));
+      ASSERT_TRUE(chip == history[frame - 1]) << "seed " << seed << " frame " << frame - 1;
+    }
+
+    EXPECT_FALSE(buffer.rewind (chip));
+    EXPECT_EQ(buffer.used (), 0);
+  }
+}
+
+TEST(RewindTest, DropsTheOldestFrames) {
+  RewindBuffer buffer (2048);
+  Chip8 chip;
+  auto history = record (buffer, chip, 3, 500);
+
+  ASSERT_GT(buffer.frames (), 0);
+  ASSERT_LT(buffer.frames (), 500);
+  EXPECT_LE(buffer.used (), 2048);
+
+  // The frames which are left are still restored correctly, after recording more on top.
+  auto frames = buffer.frames ();
+  for (auto step = 1u; step <= frames; step++) {
+    ASSERT_TRUE(buffer.rewind (chip));
+    ASSERT_TRUE(chip == history[history.size () - 1 - step]) << "step " << step;
+  }
+
+  EXPECT_FALSE(buffer.rewind (chip));
+}
+
+TEST(RewindTest, ContinuesRecordingAfterRewinding) {
+  RewindBuffer buffer (1 << 20);
+  Chip8 chip;
+  auto history = record (buffer, chip, 5, 100);
+
+  for (auto step = 0; step < 50; step++) {
+    ASSERT_TRUE(buffer.rewind (chip));
+  }
+
+  // The machine is changed by hand, so the new frame differs from the one it replaces.
+  chip.press_key (0x3);
+  auto changed = chip;
+  buffer.push (chip);
+  EXPECT_EQ(buffer.frames (), 51);
+
+  ASSERT_TRUE(buffer.rewind (chip));
+  chip.release_key (0x3);
+  EXPECT_TRUE(chip == history[50]);
+
+  buffer.push (changed);
+  ASSERT_TRUE(buffer.rewind (chip));
+  EXPECT_TRUE(chip == history[50]);
+}
+
+TEST(RewindTest, KeepsTheCurrentKeys) {
+  RewindBuffer buffer (1 << 20);
+  Chip8 chip;
+  chip.initialize ();
+  chip.press_key (0x5);
+  buffer.push (chip);
+
+  chip.cycle ();
+  buffer.push (chip);
+
+  // The key was released while rewinding, so it has to stay released.
+  chip.release_key (0x5);
+  chip.press_key (0xA);
+  ASSERT_TRUE(buffer.rewind (chip));
+
+  Chip8 expected;
+  expected.initialize ();
+  expected.press_key (0xA);
+  EXPECT_TRUE(chip == expected);
+}
+
+TEST(RewindTest, EncodesOnlyChangedBytes) {
+  Chip8 chip;
+  chip.initialize ();
+
+  SaveState previous, next;
+  chip.save_state (previous);
+  next = previous;
+
+  RewindBuffer buffer (0);
+  EXPECT_EQ(buffer.encode (previous, next), 0);
+
+  // Two changes close to each other share one block, a far one gets its own.
+  next.memory[0x300] ^= 0x12;
+  next.memory[0x302] ^= 0x34;
+  next.memory[0x800] ^= 0x56;
+  EXPECT_EQ(buffer.encode (previous, next), 2 * 2 * sizeof (uint16_t) + 3 + 1);
+
+  auto restored = next;
+  RewindBuffer::decode (buffer.scratch_.data (), buffer.encode (previous, next), restored);
+  EXPECT_EQ(std::memcmp (&restored, &previous, sizeof (SaveState)), 0);
+}
+
+TEST(RewindTest, FrameFitsIntoAFewBytes) {
+  RewindBuffer buffer (1 << 20);
+  Chip8 chip;
+  record (buffer, chip, 7, 600);
+
+  // A few minutes of history have to fit into a few megabytes.
+  EXPECT_LT(buffer.used () / buffer.frames (), 256);
+}
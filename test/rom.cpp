@@ -0,0 +1,82 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "rom.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+class RomTest : public ::testing::Test {
+ protected:
+  void SetUp () override {
+    this->directory_ = std::filesystem::temp_directory_path () / "chip8_rom_test";
+    std::filesystem::create_directories (this->directory_);
+  }
+
+  void TearDown () override {
+    std::filesystem::remove_all (this->directory_);
+  }
+
+  std::string write (const std::string &name, const std::vector<uint8_t> &rom) {
+    auto path = (this->directory_ / name).string ();
+    std::ofstream (path, std::ios::binary).write ((const char *)rom.data (), rom.size ());
+    return path;
+  }
+
+  std::filesystem::path directory_;
+};
+
+TEST_F(RomTest, ChecksTheSize) {
+  std::vector<uint8_t> largest (ROM_MAX_SIZE, 0x12);
+  auto rom = read_rom (this->write ("largest.ch8", largest));
+  ASSERT_TRUE(rom);
+  EXPECT_EQ(*rom, largest);
+
+  largest.push_back (0x34);
+  EXPECT_EQ(read_rom (this->write ("too_large.ch8", largest)).error (), RomError::TooLarge);
+  EXPECT_EQ(read_rom (this->write ("empty.ch8", {})).error (), RomError::Empty);
+  EXPECT_EQ(read_rom ((this->directory_ / "missing.ch8").string ()).error (),
+            RomError::OpenFailed);
+}
+
+TEST_F(RomTest, LoadsNothingBehindTheGame) {
+  Chip8 chip;
+  chip.initialize ();
+  ASSERT_TRUE(chip.load_game (this->write ("game.ch8", {0x60, 0x01, 0x12, 0x02})));
+
+  Chip8 expected;
+  expected.initialize ();
+  expected.load_game (std::vector<uint8_t>{0x60, 0x01, 0x12, 0x02});
+  EXPECT_TRUE(chip == expected);
+
+  // A failed load leaves the game in place.
+  EXPECT_EQ(chip.load_game (this->write ("empty.ch8", {})).error (), RomError::Empty);
+  EXPECT_TRUE(chip == expected);
+}
+
+TEST_F(RomTest, CacheReadsEveryFileOnce) {
+  auto path = this->write ("game.ch8", {0x60, 0x01});
+  auto copy = this->write ("copy.ch8", {0x60, 0x01});
+  auto other = this->write ("other.ch8", {0x60, 0x02});
+
+  RomCache cache;
+  auto first = cache.load (path);
+  ASSERT_TRUE(first);
+
+  // Once it is cached, the file isn't needed anymore.
+  std::filesystem::remove (path);
+  auto second = cache.load (path);
+  ASSERT_TRUE(second);
+  EXPECT_EQ(*first, *second);
+
+  // Equal content shares the image.
+  EXPECT_EQ(*cache.load (copy), *first);
+  EXPECT_NE(*cache.load (other), *first);
+  EXPECT_EQ(cache.images (), 2);
+
+  EXPECT_EQ(cache.load ((this->directory_ / "missing.ch8").string ()).error (),
+            RomError::OpenFailed);
+}
@@ -0,0 +1,52 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(SchedulerTest, TicksSixtyTimesPerEmulatedSecond) {
+  const std::vector<uint8_t> program = {
+      0x12, 0x00, // jump 0x200
+  };
+
+  for (uint64_t instructions_per_second : {7, 60, 600, 1000}) {
+    for (uint64_t chunk : {instructions_per_second, (uint64_t)3}) {
+      Chip8 chip;
+      chip.initialize ();
+      chip.load_game (program);
+      chip.delay_timer_ = 255;
+
+      InterpreterEngine engine;
+      Scheduler scheduler (instructions_per_second);
+      for (uint64_t executed = 0; executed < instructions_per_second; executed += chunk) {
+        scheduler.run (chip, engine, std::min (chunk, instructions_per_second - executed));
+      }
+
+      EXPECT_EQ(chip.delay_timer_, 255 - TIMER_FREQUENCY) << instructions_per_second << " ips";
+    }
+  }
+}
+
+TEST(SchedulerTest, AdvancesByHostTime) {
+  Chip8 chip;
+  chip.initialize ();
+  chip.delay_timer_ = 255;
+
+  InterpreterEngine engine;
+  Scheduler scheduler (1000);
+
+  // A third of a millisecond isn't a whole instruction, but the fractions add up.
+  uint64_t executed = 0;
+  for (auto step = 0; step < 3000; step++) {
+    executed += scheduler.advance (chip, engine, std::chrono::nanoseconds (333334));
+  }
+
+  EXPECT_EQ(executed, 1000);
+  EXPECT_EQ(chip.delay_timer_, 255 - TIMER_FREQUENCY);
+  EXPECT_EQ(scheduler.cycles_until_tick (), 17);
+}
@@ -0,0 +1,131 @@
+//
+// Created by timo on 24.09.22.
+//
+
+#include "chip8.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "programs.h"
+
+TEST(StateTest, RestoresTheSameMachine) {
+  for (auto seed = 0u; seed < 20; seed++) {
+    // The random numbers are part of the state, so they repeat after restoring.
+    Chip8 chip;
+    chip.initialize ();
+    chip.load_game (random_program (seed, 64));
+    chip.press_key (seed % KEYPAD_SIZE);
+    for (auto cycle = 0; cycle < 500; cycle++) {
+      chip.cycle ();
+    }
+
+    SaveState state;
+    chip.save_state (state);
+    auto saved = chip;
+
+    for (auto cycle = 0; cycle < 500; cycle++) {
+      chip.cycle ();
+    }
+
+    chip.tick_timers ();
+    chip.release_key (seed % KEYPAD_SIZE);
+    auto expected = chip;
+    chip.take_dirty_rows ();
+
+    ASSERT_TRUE(chip.load_state (state));
+    EXPECT_TRUE(chip == saved) << "seed " << seed;
+
+    // Exactly the rows which differ from the restored display have to be drawn again.
+    uint32_t changed_rows = 0;
+    for (auto y = 0u; y < SCREEN_HEIGHT; y++) {
+      changed_rows |= (uint32_t)(saved.display_[y] != expected.display_[y]) << y;
+    }
+
+    EXPECT_EQ(chip.dirty_rows_, changed_rows) << "seed " << seed;
+
+    for (auto cycle = 0; cycle < 500; cycle++) {
+      chip.cycle ();
+    }
+
+    chip.tick_timers ();
+    chip.release_key (seed % KEYPAD_SIZE);
+    EXPECT_TRUE(chip == expected) << "seed " << seed;
+  }
+}
+
+TEST(StateTest, DecodesRestoredCodeAgain) {
+  const std::vector<uint8_t> program = {
+      0x6A, 0x07, // VA = 7
+      0x60, 0x6A, // V0 = 0x6A
+      0x61, 0x09, // V1 = 0x09
+      0xA2, 0x00, // I = 0x200
+      0xF1, 0x55, // store V0 and V1 at 0x200, which becomes VA = 9
+      0x12, 0x00, // jump 0x200
+  };
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (program);
+
+  SaveState state;
+  chip.save_state (state);
+
+  for (auto cycle = 0; cycle < 7; cycle++) {
+    chip.cycle ();
+  }
+
+  ASSERT_EQ(chip.V_[0xA], 9);
+
+  // The instruction at 0x200 was decoded as VA = 9, the restored one has to be executed instead.
+  ASSERT_TRUE(chip.load_state (state));
+  chip.cycle ();
+  EXPECT_EQ(chip.V_[0xA], 7);
+}
+
+TEST(StateTest, RejectsOtherVersions) {
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (std::vector<uint8_t>{0x6A, 0x07});
+
+  SaveState state;
+  chip.save_state (state);
+  chip.cycle ();
+  auto expected = chip;
+
+  state.version++;
+  EXPECT_FALSE(chip.load_state (state));
+
+  state.version--;
+  state.magic = 0;
+  EXPECT_FALSE(chip.load_state (state));
+
+  state.magic = SAVE_STATE_MAGIC;
+  state.stack_pointer = STACK_SIZE + 1;
+  EXPECT_FALSE(chip.load_state (state));
+
+  EXPECT_TRUE(chip == expected);
+}
+
+TEST(StateTest, RoundTripsThroughAFile) {
+  auto path = ::testing::TempDir () + "chip8_state_test.state";
+
+  Chip8 chip;
+  chip.initialize ();
+  chip.load_game (std::vector<uint8_t>{0x6A, 0x07, 0xA2, 0x34, 0x22, 0x00});
+  for (auto cycle = 0; cycle < 5; cycle++) {
+    chip.cycle ();
+  }
+
+  ASSERT_TRUE(chip.save_state_file (path));
+
+  Chip8 restored;
+  restored.initialize ();
+  ASSERT_TRUE(restored.load_state_file (path));
+  EXPECT_TRUE(restored == chip);
+
+  std::remove (path.c_str ());
+  EXPECT_FALSE(restored.load_state_file (path));
+}